@@ -0,0 +1,299 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "patlak/keywords.c"
+#include "prelude/buffer.c"
+#include "prelude/expect.c"
+#include "prelude/file.c"
+#include "prelude/scalar.c"
+#include "prelude/string.c"
+#include "prelude/writer.c"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Version of the compiler. Outputs of other versions are not used. The build
+ * defines it from the hash of the sources; otherwise, each compilation of the
+ * compiler is a different version. */
+#ifndef CT_CACHE_VERSION
+#    define CT_CACHE_VERSION "thrice-" __DATE__ " " __TIME__
+#endif
+
+/* Default limit to the total size of the cached outputs in bytes. */
+#define CT_CACHE_LIMIT (64 << 20)
+
+/* Outputs of earlier compilations that are kept in a directory. */
+typedef struct {
+    /* Path to the directory. Null if there is no cache. */
+    char const* directory;
+    /* Version of the compiler the outputs are keyed with. */
+    char const* version;
+    /* Limit to the total size of the outputs in bytes. */
+    CTIndex limit;
+    /* Total size of the outputs in bytes as of the last scan of the directory
+     * and the outputs stored since then. */
+    CTIndex size;
+} CTCache;
+
+/* Cached output that is a candidate for eviction. */
+typedef struct {
+    /* Name of the output in the directory. */
+    char name[32];
+    /* Size of the output in bytes. */
+    CTIndex size;
+    /* Last time the output was used. */
+    struct timespec used;
+} CTCacheEntry;
+
+/* Total size of the outputs in the directory. Collects the outputs to the
+ * entries and counts them in the amount when the entries are given. */
+CTIndex ct_cache_scan(
+    DIR*           directory,
+    CTCacheEntry** entries,
+    CTIndex*       amount)
+{
+    int     descriptor = dirfd(directory);
+    CTIndex allocated  = 0;
+    CTIndex total      = 0;
+    for (struct dirent* i = readdir(directory); i != NULL;
+         i                = readdir(directory)) {
+        struct stat status;
+        if (strlen(i->d_name) != 16 ||
+            fstatat(descriptor, i->d_name, &status, 0) != 0 ||
+            !S_ISREG(status.st_mode)) {
+            continue;
+        }
+        total += status.st_size;
+        if (entries == NULL) {
+            continue;
+        }
+        if (*amount == allocated) {
+            allocated = allocated == 0 ? 16 : allocated * 2;
+            *entries = reallocarray(*entries, allocated, sizeof(CTCacheEntry));
+            ct_expect(*entries != NULL, "Could not allocate!");
+        }
+        strcpy((*entries)[*amount].name, i->d_name);
+        (*entries)[*amount].size = status.st_size;
+        (*entries)[*amount].used = status.st_mtim;
+        (*amount)++;
+    }
+    return total;
+}
+
+/* Cache in the directory. Creates the directory if it does not exist. */
+CTCache ct_cache(char const* directory, CTIndex limit)
+{
+    ct_expect(
+        mkdir(directory, 0755) == 0 || errno == EEXIST,
+        "Could not create the cache directory!");
+    DIR* opened = opendir(directory);
+    ct_expect(opened != NULL, "Could not open the cache directory!");
+    CTIndex size = ct_cache_scan(opened, NULL, NULL);
+    ct_expect(closedir(opened) == 0, "Could not close the cache directory!");
+    return (CTCache){
+        .directory = directory,
+        .version   = CT_CACHE_VERSION,
+        .limit     = limit,
+        .size      = size};
+}
+
+/* Whether there is a cache. */
+bool ct_cache_enabled(CTCache const* cache)
+{
+    return cache->directory != NULL;
+}
+
+/* Mix the bits of the hash. */
+uint64_t ct_cache_mix(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/* Hash the string starting from the seed. Reads 8 characters at a time. */
+uint64_t ct_cache_hash_string(uint64_t seed, CTString const* string)
+{
+    uint64_t    hash = seed ^ (uint64_t)ct_string_size(string);
+    char const* i    = string->first;
+    for (; string->last - i >= 8; i += 8) {
+        uint64_t word = 0;
+        memcpy(&word, i, 8);
+        hash = (hash ^ ct_cache_mix(word)) * 0x9E3779B97F4A7C15ULL;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, i, string->last - i);
+    return ct_cache_mix(hash ^ tail);
+}
+
+/* Key of the output of the file with the contents. Covers the version of the
+ * cache, the kind of the output, which is C for sources and tokens for the
+ * others, and the keyword table the file is lexed with if there is one; so,
+ * outputs of different versions, kinds or keywords do not mix. */
+uint64_t ct_cache_key(
+    CTCache const*          cache,
+    CTString const*         contents,
+    bool                    source,
+    CTPatlakKeywords const* keywords)
+{
+    CTString version = ct_string_terminated(cache->version);
+    CTString kind    = ct_string_terminated(source ? "c" : "tokens");
+    uint64_t hash    = ct_cache_hash_string(0, &version);
+    hash             = ct_cache_hash_string(hash, &kind);
+    if (keywords != NULL) {
+        for (CTIndex i = 0; i < keywords->size; i++) {
+            hash = ct_cache_hash_string(hash, keywords->spellings + i);
+        }
+    }
+    return ct_cache_hash_string(hash, contents);
+}
+
+/* Path of the cached output with the key. When there is a suffix, it is
+ * appended to the path. */
+void ct_cache_path(
+    CTCache const* cache,
+    uint64_t       key,
+    char const*    suffix,
+    CTBuffer*      path)
+{
+    ct_buffer_clear(path);
+    int size = snprintf(
+        NULL,
+        0,
+        "%s/%016llx%s",
+        cache->directory,
+        (unsigned long long)key,
+        suffix);
+    ct_buffer_reserve(path, size + 1);
+    snprintf(
+        path->last,
+        size + 1,
+        "%s/%016llx%s",
+        cache->directory,
+        (unsigned long long)key,
+        suffix);
+    path->last += size + 1;
+}
+
+/* Write the cached output with the key. Returns whether there was one. Marks
+ * the output as used, so it is evicted last. An output that is evicted by
+ * another compilation after it is opened is still read whole. */
+bool ct_cache_load(CTCache const* cache, uint64_t key, CTWriter* writer)
+{
+    CTBuffer path = {0};
+    ct_cache_path(cache, key, "", &path);
+    int descriptor = open(path.first, O_RDONLY);
+    ct_buffer_free(&path);
+    if (descriptor < 0) {
+        return false;
+    }
+
+    CTBuffer contents = {0};
+    ssize_t  chunk    = 0;
+    do {
+        ct_buffer_reserve(&contents, CT_FILE_CHUNK);
+        chunk = read(descriptor, contents.last, CT_FILE_CHUNK);
+        ct_expect(chunk >= 0, "Could not read the cached output!");
+        contents.last += chunk;
+    } while (chunk > 0);
+    futimens(descriptor, NULL);
+    ct_expect(close(descriptor) == 0, "Could not close the cached output!");
+
+    CTString output = ct_buffer_view(&contents);
+    ct_writer_string(writer, &output);
+    ct_buffer_free(&contents);
+    return true;
+}
+
+/* Start storing the output with the key. Everything written until the end
+ * is also written to the cache. */
+void ct_cache_begin(CTCache const* cache, uint64_t key, CTWriter* writer)
+{
+    CTBuffer path = {0};
+    ct_cache_path(cache, key, ".part", &path);
+    ct_writer_flush(writer);
+    writer->copy = open(path.first, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ct_expect(writer->copy >= 0, "Could not create the cached output!");
+    ct_buffer_free(&path);
+}
+
+/* Order of the entries from the least recently used. */
+int ct_cache_entry_compare(void const* left, void const* right)
+{
+    struct timespec const* a = &((CTCacheEntry const*)left)->used;
+    struct timespec const* b = &((CTCacheEntry const*)right)->used;
+    if (a->tv_sec != b->tv_sec) {
+        return a->tv_sec < b->tv_sec ? -1 : 1;
+    }
+    if (a->tv_nsec != b->tv_nsec) {
+        return a->tv_nsec < b->tv_nsec ? -1 : 1;
+    }
+    return 0;
+}
+
+/* Remove the least recently used outputs until the total size is in the
+ * limit. Scans the directory again, which also counts the outputs stored by
+ * other compilations. */
+void ct_cache_evict(CTCache* cache)
+{
+    DIR* directory = opendir(cache->directory);
+    ct_expect(directory != NULL, "Could not open the cache directory!");
+
+    CTCacheEntry* entries = NULL;
+    CTIndex       amount  = 0;
+    CTIndex       total   = ct_cache_scan(directory, &entries, &amount);
+    if (total > cache->limit) {
+        qsort(entries, amount, sizeof(CTCacheEntry), ct_cache_entry_compare);
+        for (CTIndex i = 0; i < amount && total > cache->limit; i++) {
+            if (unlinkat(dirfd(directory), entries[i].name, 0) == 0) {
+                total -= entries[i].size;
+            }
+        }
+    }
+    cache->size = total;
+
+    free(entries);
+    ct_expect(closedir(directory) == 0, "Could not close the cache directory!");
+}
+
+/* Finish storing the output with the key. The output is only visible to
+ * other compilations after it is complete. Evicts only when the tracked size
+ * goes over the limit. */
+void ct_cache_end(CTCache* cache, uint64_t key, CTWriter* writer)
+{
+    ct_writer_flush(writer);
+    struct stat status;
+    ct_expect(
+        fstat(writer->copy, &status) == 0,
+        "Could not measure the cached output!");
+    ct_expect(close(writer->copy) == 0, "Could not close the cached output!");
+    writer->copy = -1;
+
+    CTBuffer part = {0};
+    CTBuffer path = {0};
+    ct_cache_path(cache, key, ".part", &part);
+    ct_cache_path(cache, key, "", &path);
+    ct_expect(
+        rename(part.first, path.first) == 0,
+        "Could not store the cached output!");
+    ct_buffer_free(&path);
+    ct_buffer_free(&part);
+
+    cache->size += status.st_size;
+    if (cache->size > cache->limit) {
+        ct_cache_evict(cache);
+    }
+}
@@ -1,59 +1,51 @@
 // SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
 // SPDX-License-Identifier: GPL-3.0-or-later
 
-#include "patlak/lexer.c"
-#include "patlak/printer.c"
-#include "patlak/token.c"
-#include "prelude/buffer.c"
-#include "prelude/expect.c"
-#include "prelude/file.c"
-#include "prelude/split.c"
-#include "prelude/string.c"
+#include "server.c"
+#include "session.c"
 
 #include <stdio.h>
-
-/* Compile the source file at the path. */
-void ct_compile(char const* path)
-{
-    printf("Compiling %s...\n", path);
-    CTBuffer buffer = {0};
-    CTString file   = ct_file_load(&buffer, path);
-
-    CTPatlakTokens tokens = {0};
-
-    while (ct_string_finite(&file)) {
-        CTSplit  split = ct_split_first(&file, '\n');
-        CTString line  = split.before;
-        file.first     = split.after.first + 1;
-
-        if (ct_string_size(&line) >= 2 && ct_string_at(&line, 0) == '/' &&
-            ct_string_at(&line, 1) == '/') {
-            continue;
-        }
-
-        ct_patlak_tokens_clear(&tokens);
-        ct_patlak_lexer(&tokens, line);
-        ct_patlak_printer_tokens(&tokens);
-    }
-
-    ct_patlak_tokens_free(&tokens);
-    ct_buffer_free(&buffer);
-}
-
-/* Entry to the compiler. */
+#include <string.h>
+#include <unistd.h>
+
+/* Entry to the compiler. Running with "--serve <socket> [token file]" keeps
+ * the compiler and the compiled patterns of the token file resident, and
+ * running with "--client <socket> <arguments>..." forwards the other arguments
+ * to it. Running with "--generate <token file> [prefix]" writes C code that
+ * matches the patterns in the token file. Otherwise, the files are compiled;
+ * "--cache <directory>" among them reuses the outputs of the files that were
+ * compiled before, and "--mem-report" prints the memory that was used by each
+ * kind of container after compiling. */
 int main(int argument_count, char const* const* arguments)
 {
-    printf("Thrice C Transpiler\n");
-    printf("Running with arguments:\n");
-    for (int i = 0; i < argument_count; i++) {
-        printf("[%d] {%s}\n", i, arguments[i]);
+    if (argument_count >= 3 && strcmp(arguments[1], "--serve") == 0) {
+        ct_server_serve(
+            arguments[2],
+            argument_count >= 4 ? arguments[3] : NULL);
+        return 0;
+    }
+    if (argument_count >= 3 && strcmp(arguments[1], "--client") == 0) {
+        return ct_server_forward(
+            arguments[2],
+            argument_count - 3,
+            arguments + 3);
     }
-    printf("\n");
 
-    ct_expect(argument_count >= 2, "Provide a thrice file!");
-    for (int i = 1; i < argument_count; i++) {
-        ct_compile(arguments[i]);
+    if (argument_count < 2 || strcmp(arguments[1], "--generate") != 0) {
+        printf("Thrice C Transpiler\n");
+        printf("Running with arguments:\n");
+        for (int i = 0; i < argument_count; i++) {
+            printf("[%d] {%s}\n", i, arguments[i]);
+        }
+        printf("\n");
+        fflush(stdout);
     }
 
-    return 0;
+    CTSession session = ct_session(STDOUT_FILENO);
+    int       status  = ct_session_run(
+        &session,
+        argument_count - 1,
+        arguments + 1);
+    ct_session_free(&session);
+    return status;
 }
@@ -0,0 +1,46 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "prelude/expect.c"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Options of a compilation, which can be anywhere among the files. */
+typedef struct {
+    /* Whether the memory report is printed after compiling. */
+    bool report;
+    /* Directory of the cache given with "--cache", or null. */
+    char const* cache;
+    /* Arguments that are not options, in order. */
+    char const** files;
+    /* Amount of files. */
+    int count;
+} CTOptions;
+
+/* Parse the arguments to the options and the files. */
+CTOptions ct_options(int count, char const* const* arguments)
+{
+    CTOptions options = {.files = malloc(sizeof(char const*) * (count + 1))};
+    ct_expect(options.files != NULL, "Could not allocate!");
+    for (int i = 0; i < count; i++) {
+        if (strcmp(arguments[i], "--mem-report") == 0) {
+            options.report = true;
+        } else if (strcmp(arguments[i], "--cache") == 0) {
+            ct_expect(i + 1 < count, "Provide a cache directory!");
+            options.cache = arguments[++i];
+        } else {
+            options.files[options.count++] = arguments[i];
+        }
+    }
+    return options;
+}
+
+/* Deallocate memory. */
+void ct_options_free(CTOptions* options)
+{
+    free(options->files);
+}
@@ -0,0 +1,401 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "patlak/code.c"
+#include "patlak/pattern.c"
+#include "patlak/set.c"
+#include "prelude/expect.c"
+#include "prelude/scalar.c"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+/* Amount of characters that stands for no limit while analyzing. */
+#define CT_PATLAK_ANALYSIS_UNBOUNDED -1
+
+/* Codes that are analyzed together. Going to the end finishes a path. */
+typedef struct {
+    /* Compiled pattern code. */
+    CTPatlakCodes const* codes;
+    /* Pattern informations for the references. */
+    CTPatlakPatterns const* patterns;
+    /* Index of the first code. */
+    CTIndex first;
+    /* Index after the last code. */
+    CTIndex last;
+    /* Index of the code that is the end. TERMINAL codes are also the end. */
+    CTIndex end;
+} CTPatlakRegion;
+
+/* Sum of the amounts, where either of them might be unbounded. */
+CTIndex ct_patlak_analysis_add(CTIndex lhs, CTIndex rhs)
+{
+    if (lhs == CT_PATLAK_ANALYSIS_UNBOUNDED ||
+        rhs == CT_PATLAK_ANALYSIS_UNBOUNDED) {
+        return CT_PATLAK_ANALYSIS_UNBOUNDED;
+    }
+    return lhs + rhs;
+}
+
+/* Whether the lhs amount is more than the rhs one, where either of them might
+ * be unbounded. */
+bool ct_patlak_analysis_more(CTIndex lhs, CTIndex rhs)
+{
+    if (rhs == CT_PATLAK_ANALYSIS_UNBOUNDED) {
+        return false;
+    }
+    return lhs == CT_PATLAK_ANALYSIS_UNBOUNDED || lhs > rhs;
+}
+
+/* Analysis of the reffered pattern. Patterns that are not analyzed yet, which
+ * are the ones that reference themselves, are taken as matching anything. */
+CTPatlakAnalysis
+ct_patlak_analysis_reference(CTPatlakRegion const* region, CTIndex reffered)
+{
+    CTPatlakPattern const* pattern =
+        ct_patlak_patterns_starting(region->patterns, reffered);
+    if (pattern != NULL && pattern->analyzed) {
+        return pattern->analysis;
+    }
+    CTPatlakAnalysis result = {
+        .minimum = 1,
+        .maximum = CT_PATLAK_ANALYSIS_UNBOUNDED};
+    ct_patlak_set_fill(&result.first);
+    return result;
+}
+
+// Prototype for call before definition.
+CTPatlakAnalysis ct_patlak_analysis_region(CTPatlakRegion const* region);
+
+/* Analysis of the code that is repeated by the REPEAT code at the index. */
+CTPatlakAnalysis
+ct_patlak_analysis_body(CTPatlakRegion const* region, CTIndex repeat)
+{
+    CTPatlakRegion body = {
+        .codes    = region->codes,
+        .patterns = region->patterns,
+        .first    = repeat + 1,
+        .last     = repeat + ct_patlak_codes_get(region->codes, repeat)->movement,
+        .end      = repeat};
+    return ct_patlak_analysis_region(&body);
+}
+
+/* Find the first characters starting from the code at the index, and whether
+ * the end can be reached without consuming any. */
+void ct_patlak_analysis_first(
+    CTPatlakRegion const* region,
+    CTPatlakAnalysis*     result,
+    bool*                 visited,
+    CTIndex               index)
+{
+    if (index == region->end) {
+        result->nullable = true;
+        return;
+    }
+    ct_expect(
+        index >= region->first && index < region->last,
+        "Code out of the region!");
+    if (visited[index - region->first]) {
+        return;
+    }
+    visited[index - region->first] = true;
+
+    CTPatlakCode const* code = ct_patlak_codes_get(region->codes, index);
+    switch (code->type) {
+        case CT_PATLAK_CODE_EMPTY:
+        case CT_PATLAK_CODE_TAG:
+            ct_patlak_analysis_first(
+                region,
+                result,
+                visited,
+                index + code->movement);
+            break;
+        case CT_PATLAK_CODE_LITERAL:
+            ct_patlak_set_add(&result->first, code->literal);
+            break;
+        case CT_PATLAK_CODE_RANGE:
+            ct_patlak_set_add_range(&result->first, code->first, code->last);
+            break;
+        case CT_PATLAK_CODE_SET:
+            ct_patlak_set_join(
+                &result->first,
+                ct_patlak_codes_set(region->codes, code));
+            break;
+        case CT_PATLAK_CODE_STRING:
+            ct_patlak_set_add(
+                &result->first,
+                *ct_patlak_codes_string(region->codes, code).first);
+            break;
+        case CT_PATLAK_CODE_REFERANCE: {
+            // Empty reference matches are dead ends; so, never go after it.
+            CTPatlakAnalysis reffered =
+                ct_patlak_analysis_reference(region, code->reffered);
+            ct_patlak_set_join(&result->first, &reffered.first);
+        } break;
+        case CT_PATLAK_CODE_BRANCH:
+            for (CTIndex i = 1; i <= code->branches; i++) {
+                ct_patlak_analysis_first(region, result, visited, index + i);
+            }
+            break;
+        case CT_PATLAK_CODE_COUNT:
+            ct_patlak_analysis_first(region, result, visited, index + 1);
+            break;
+        case CT_PATLAK_CODE_REPEAT: {
+            CTPatlakAnalysis body = ct_patlak_analysis_body(region, index);
+            if (code->maximum != 0) {
+                ct_patlak_set_join(&result->first, &body.first);
+            }
+            if (code->minimum == 0 || body.nullable) {
+                ct_patlak_analysis_first(
+                    region,
+                    result,
+                    visited,
+                    index + code->movement);
+            }
+        } break;
+        case CT_PATLAK_CODE_TERMINAL:
+            result->nullable = true;
+            break;
+        default:
+            ct_expect(false, "Unkown type!");
+    }
+}
+
+/* Amounts of characters consumed to reach somewhere. */
+typedef struct {
+    /* Least amount. Negative means not reached. */
+    CTIndex minimum;
+    /* Most amount. */
+    CTIndex maximum;
+} CTPatlakAnalysisDistance;
+
+/* Relax the distance to the target code or the end using the distance to the
+ * source and the amounts consumed on the way. Returns whether the distance
+ * changed. */
+bool ct_patlak_analysis_relax(
+    CTPatlakRegion const*     region,
+    CTPatlakAnalysisDistance* distances,
+    CTPatlakAnalysisDistance* end,
+    CTPatlakAnalysisDistance  source,
+    CTIndex                   target,
+    CTIndex                   minimum,
+    CTIndex                   maximum)
+{
+    CTPatlakAnalysisDistance* distance = end;
+    if (target != region->end &&
+        ct_patlak_codes_get(region->codes, target)->type !=
+            CT_PATLAK_CODE_TERMINAL) {
+        distance = distances + target - region->first;
+    }
+
+    bool    changed  = false;
+    CTIndex reaching = source.minimum + minimum;
+    if (distance->minimum < 0 || reaching < distance->minimum) {
+        distance->minimum = reaching;
+        changed           = true;
+    }
+    reaching = ct_patlak_analysis_add(source.maximum, maximum);
+    if (ct_patlak_analysis_more(reaching, distance->maximum)) {
+        distance->maximum = reaching;
+        changed           = true;
+    }
+    return changed;
+}
+
+/* Find the least and the most amount of characters consumed before reaching
+ * the end. Paths are relaxed until nothing changes; if the most amount still
+ * grows after a relaxation for each code, there is a loop that consumes. */
+void ct_patlak_analysis_lengths(
+    CTPatlakRegion const*     region,
+    CTPatlakAnalysis*         result,
+    CTPatlakAnalysisDistance* distances)
+{
+    CTIndex size = region->last - region->first;
+    for (CTIndex i = 0; i < size; i++) {
+        distances[i] = (CTPatlakAnalysisDistance){.minimum = -1};
+    }
+    distances[0].minimum = 0;
+
+    CTPatlakAnalysisDistance end     = {.minimum = -1};
+    bool                     changed = true;
+    for (CTIndex pass = 0; changed; pass++) {
+        if (pass > size) {
+            end.maximum = CT_PATLAK_ANALYSIS_UNBOUNDED;
+            break;
+        }
+        changed = false;
+
+        for (CTIndex i = 0; i < size; i++) {
+            CTPatlakAnalysisDistance source = distances[i];
+            if (source.minimum < 0) {
+                continue;
+            }
+            CTIndex             index = region->first + i;
+            CTPatlakCode const* code =
+                ct_patlak_codes_get(region->codes, index);
+            CTIndex target = index + code->movement;
+
+            switch (code->type) {
+                case CT_PATLAK_CODE_EMPTY:
+                case CT_PATLAK_CODE_TAG:
+                    changed |= ct_patlak_analysis_relax(
+                        region,
+                        distances,
+                        &end,
+                        source,
+                        target,
+                        0,
+                        0);
+                    break;
+                case CT_PATLAK_CODE_LITERAL:
+                case CT_PATLAK_CODE_RANGE:
+                case CT_PATLAK_CODE_SET:
+                    changed |= ct_patlak_analysis_relax(
+                        region,
+                        distances,
+                        &end,
+                        source,
+                        target,
+                        1,
+                        1);
+                    break;
+                case CT_PATLAK_CODE_STRING:
+                    changed |= ct_patlak_analysis_relax(
+                        region,
+                        distances,
+                        &end,
+                        source,
+                        target,
+                        code->length,
+                        code->length);
+                    break;
+                case CT_PATLAK_CODE_REFERANCE: {
+                    CTPatlakAnalysis reffered =
+                        ct_patlak_analysis_reference(region, code->reffered);
+                    changed |= ct_patlak_analysis_relax(
+                        region,
+                        distances,
+                        &end,
+                        source,
+                        target,
+                        reffered.minimum > 1 ? reffered.minimum : 1,
+                        reffered.maximum);
+                } break;
+                case CT_PATLAK_CODE_BRANCH:
+                    for (CTIndex j = 1; j <= code->branches; j++) {
+                        changed |= ct_patlak_analysis_relax(
+                            region,
+                            distances,
+                            &end,
+                            source,
+                            index + j,
+                            0,
+                            0);
+                    }
+                    break;
+                case CT_PATLAK_CODE_COUNT:
+                    changed |= ct_patlak_analysis_relax(
+                        region,
+                        distances,
+                        &end,
+                        source,
+                        index + 1,
+                        0,
+                        0);
+                    break;
+                case CT_PATLAK_CODE_REPEAT: {
+                    // Jump over the body, consuming it for each repeat.
+                    CTPatlakAnalysis body =
+                        ct_patlak_analysis_body(region, index);
+                    CTIndex maximum = 0;
+                    if (body.maximum == CT_PATLAK_ANALYSIS_UNBOUNDED ||
+                        (code->maximum < 0 && body.maximum > 0)) {
+                        maximum = CT_PATLAK_ANALYSIS_UNBOUNDED;
+                    } else if (code->maximum > 0) {
+                        maximum = code->maximum * body.maximum;
+                    }
+                    changed |= ct_patlak_analysis_relax(
+                        region,
+                        distances,
+                        &end,
+                        source,
+                        target,
+                        code->minimum * body.minimum,
+                        maximum);
+                } break;
+                case CT_PATLAK_CODE_TERMINAL:
+                    break;
+                default:
+                    ct_expect(false, "Unkown type!");
+            }
+        }
+    }
+
+    result->minimum = end.minimum;
+    result->maximum = end.maximum;
+}
+
+/* Analyze the paths from the first code of the region to its end. */
+CTPatlakAnalysis ct_patlak_analysis_region(CTPatlakRegion const* region)
+{
+    CTIndex size = region->last - region->first;
+    ct_expect(size > 0, "Analyzing an empty region!");
+
+    CTPatlakAnalysis result  = {0};
+    bool*            visited = calloc(size, sizeof(bool));
+    ct_expect(visited != NULL, "Could not allocate!");
+    ct_patlak_analysis_first(region, &result, visited, region->first);
+    free(visited);
+
+    CTPatlakAnalysisDistance* distances =
+        calloc(size, sizeof(CTPatlakAnalysisDistance));
+    ct_expect(distances != NULL, "Could not allocate!");
+    ct_patlak_analysis_lengths(region, &result, distances);
+    free(distances);
+
+    ct_expect(result.minimum >= 0, "Pattern cannot reach its end!");
+    return result;
+}
+
+/* Analyze the pattern, whose codes end before the index. */
+void ct_patlak_analyze_until(
+    CTPatlakCodes const*    codes,
+    CTPatlakPatterns const* patterns,
+    CTPatlakPattern*        pattern,
+    CTIndex                 last)
+{
+    CTPatlakRegion region = {
+        .codes    = codes,
+        .patterns = patterns,
+        .first    = pattern->start,
+        .last     = last,
+        .end      = -1};
+    pattern->analysis = ct_patlak_analysis_region(&region);
+    pattern->analyzed = true;
+}
+
+/* Analyze the pattern, whose codes must be the last ones. */
+void ct_patlak_analyze(
+    CTPatlakCodes const*    codes,
+    CTPatlakPatterns const* patterns,
+    CTPatlakPattern*        pattern)
+{
+    ct_patlak_analyze_until(
+        codes,
+        patterns,
+        pattern,
+        ct_patlak_codes_size(codes));
+}
+
+/* Whether the pattern might match a nonempty initial portion of the input.
+ * Takes constant time. */
+bool ct_patlak_analysis_admits(
+    CTPatlakAnalysis const* analysis,
+    CTString const*         input)
+{
+    return ct_string_finite(input) &&
+           ct_patlak_set_has(&analysis->first, *input->first) &&
+           analysis->minimum <= ct_string_size(input);
+}
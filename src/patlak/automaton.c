@@ -0,0 +1,770 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "patlak/code.c"
+#include "patlak/state.c"
+#include "prelude/expect.c"
+#include "prelude/memory.c"
+#include "prelude/scalar.c"
+#include "prelude/string.c"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Most amount of states the deterministic automaton can have before it is
+ * minimized. Patterns that need more are decoded instead. */
+#define CT_PATLAK_AUTOMATON_STATES (1 << 12)
+
+/* Deterministic finite automaton that matches an ordered set of patterns at
+ * once. Characters that none of the patterns tell apart are in the same
+ * class, and each state has a transition for each class. */
+typedef struct {
+    /* Class of each character. */
+    unsigned char classes[256];
+    /* Amount of classes. */
+    CTIndex class_count;
+    /* Next state of each state and class, state after state. */
+    int32_t* transitions;
+    /* Index in the order of the pattern whose match ends at each state, or
+     * negative if none does. */
+    int32_t* accepts;
+    /* Amount of states. */
+    CTIndex size;
+    /* State before the first character. */
+    int32_t start;
+    /* State that cannot reach a better match, where matching stops. */
+    int32_t dead;
+} CTPatlakAutomaton;
+
+/* Position of a pattern in the nondeterministic automaton, which is a state
+ * without its input. */
+typedef struct {
+    /* Index of the pattern in the order. */
+    CTIndex pattern;
+    /* Index of the code. */
+    CTIndex code;
+    /* Amount of characters of the string code that were matched. */
+    CTIndex offset;
+    /* Amount of repeats done by the counted repeats. */
+    CTIndex counters[CT_PATLAK_STATE_COUNTERS];
+} CTPatlakAutomatonItem;
+
+/* Information while building the deterministic automaton by subset
+ * construction. Each state is the set of the items that wait for a
+ * character. */
+typedef struct {
+    /* Codes of the patterns. */
+    CTPatlakCodes const* codes;
+    /* Amount of patterns in the order. */
+    CTIndex order;
+    /* First character of each class. */
+    unsigned char representatives[256];
+    /* Amount of classes. */
+    CTIndex class_count;
+
+    /* Items of the states, the ones of each state after the other. */
+    CTPatlakAutomatonItem* items;
+    /* Amount of items. */
+    CTIndex item_count;
+    /* Amount of allocated items. */
+    CTIndex item_capacity;
+    /* Border before the items of each state, and after the last one. */
+    CTIndex* bounds;
+    /* Accepted pattern of each state, or negative. */
+    int32_t* accepts;
+    /* Next state of each state and class. */
+    int32_t* transitions;
+    /* Amount of states. */
+    CTIndex size;
+    /* States by the hash of their items. Negative means an empty slot. */
+    CTIndex* table;
+
+    /* Items that are reached by following empty moves. */
+    CTPatlakAutomatonItem* reached;
+    /* Amount of reached items. */
+    CTIndex reached_count;
+    /* Amount of allocated reached items. */
+    CTIndex reached_capacity;
+    /* Reached items by their hash. Negative means an empty slot. */
+    CTIndex* seen;
+    /* Amount of slots of the seen items, which is a power of two. */
+    CTIndex seen_capacity;
+    /* Lowest index in the order of the reached patterns that matched. */
+    CTIndex lowest;
+} CTPatlakAutomatonBuilder;
+
+/* Make sure the amount of elements of the width fit to the memory. Grows by
+ * at least the half of the capacity if necessary. */
+void* ct_patlak_automaton_grow(
+    void*    memory,
+    CTIndex* capacity,
+    CTIndex  amount,
+    CTIndex  width)
+{
+    if (amount <= *capacity) {
+        return memory;
+    }
+    CTIndex new_capacity = *capacity + (*capacity >> 1);
+    if (new_capacity < amount) {
+        new_capacity = amount;
+    }
+    memory = reallocarray(memory, new_capacity, width);
+    ct_expect(memory != NULL, "Could not allocate!");
+    *capacity = new_capacity;
+    return memory;
+}
+
+/* Hash of the items. */
+uint64_t ct_patlak_automaton_hash(
+    CTPatlakAutomatonItem const* items,
+    CTIndex                      amount)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (CTIndex i = 0; i < amount; i++) {
+        hash = (hash ^ (uint64_t)items[i].pattern) * 0x100000001B3ULL;
+        hash = (hash ^ (uint64_t)items[i].code) * 0x100000001B3ULL;
+        hash = (hash ^ (uint64_t)items[i].offset) * 0x100000001B3ULL;
+        for (int j = 0; j < CT_PATLAK_STATE_COUNTERS; j++) {
+            hash = (hash ^ (uint64_t)items[i].counters[j]) * 0x100000001B3ULL;
+        }
+    }
+    return hash ^ (hash >> 32);
+}
+
+/* Whether the items are the same. */
+bool ct_patlak_automaton_same(
+    CTPatlakAutomatonItem const* lhs,
+    CTPatlakAutomatonItem const* rhs)
+{
+    return memcmp(lhs, rhs, sizeof(CTPatlakAutomatonItem)) == 0;
+}
+
+/* Order of the items in a state, which only needs to be the same for the
+ * equal sets. */
+int ct_patlak_automaton_compare(void const* lhs, void const* rhs)
+{
+    return memcmp(lhs, rhs, sizeof(CTPatlakAutomatonItem));
+}
+
+/* Put the index of the reached item to the seen slots. */
+void ct_patlak_automaton_see(CTPatlakAutomatonBuilder* builder, CTIndex index)
+{
+    CTIndex mask = builder->seen_capacity - 1;
+    CTIndex slot =
+        (CTIndex)(ct_patlak_automaton_hash(builder->reached + index, 1) & mask);
+    while (builder->seen[slot] >= 0) {
+        slot = (slot + 1) & mask;
+    }
+    builder->seen[slot] = index;
+}
+
+/* Forget the reached items. */
+void ct_patlak_automaton_clear(CTPatlakAutomatonBuilder* builder)
+{
+    builder->reached_count = 0;
+    builder->lowest        = builder->order;
+    memset(builder->seen, 0xFF, builder->seen_capacity * sizeof(CTIndex));
+}
+
+/* Add the item to the reached items unless it was already reached. */
+void ct_patlak_automaton_reach(
+    CTPatlakAutomatonBuilder* builder,
+    CTPatlakAutomatonItem     item)
+{
+    CTIndex mask = builder->seen_capacity - 1;
+    CTIndex slot = (CTIndex)(ct_patlak_automaton_hash(&item, 1) & mask);
+    for (; builder->seen[slot] >= 0; slot = (slot + 1) & mask) {
+        if (ct_patlak_automaton_same(
+                builder->reached + builder->seen[slot],
+                &item)) {
+            return;
+        }
+    }
+
+    builder->reached = ct_patlak_automaton_grow(
+        builder->reached,
+        &builder->reached_capacity,
+        builder->reached_count + 1,
+        sizeof(CTPatlakAutomatonItem));
+    builder->reached[builder->reached_count++] = item;
+
+    // Keep at least half of the slots empty, so the probes stay short.
+    if (2 * builder->reached_count < builder->seen_capacity) {
+        builder->seen[slot] = builder->reached_count - 1;
+        return;
+    }
+    builder->seen_capacity *= 2;
+    free(builder->seen);
+    builder->seen = calloc(builder->seen_capacity, sizeof(CTIndex));
+    ct_expect(builder->seen != NULL, "Could not allocate!");
+    memset(builder->seen, 0xFF, builder->seen_capacity * sizeof(CTIndex));
+    for (CTIndex i = 0; i < builder->reached_count; i++) {
+        ct_patlak_automaton_see(builder, i);
+    }
+}
+
+/* Follow the empty moves of the reached items, the same way as decoding
+ * them, until all of them wait for a character or matched. Returns false if
+ * a reference was reached, which cannot be followed without decoding. */
+bool ct_patlak_automaton_follow(CTPatlakAutomatonBuilder* builder)
+{
+    // Reached items are added to the end, so this visits them all.
+    for (CTIndex i = 0; i < builder->reached_count; i++) {
+        CTPatlakAutomatonItem item = builder->reached[i];
+        CTPatlakCode const*   code =
+            ct_patlak_codes_get(builder->codes, item.code);
+        switch (code->type) {
+            case CT_PATLAK_CODE_LITERAL:
+            case CT_PATLAK_CODE_RANGE:
+            case CT_PATLAK_CODE_SET:
+            case CT_PATLAK_CODE_STRING:
+                continue;
+            case CT_PATLAK_CODE_REFERANCE:
+                return false;
+            case CT_PATLAK_CODE_TERMINAL:
+                if (item.pattern < builder->lowest) {
+                    builder->lowest = item.pattern;
+                }
+                continue;
+            case CT_PATLAK_CODE_BRANCH:
+                for (CTIndex j = 0; j < code->branches; j++) {
+                    item.code++;
+                    ct_patlak_automaton_reach(builder, item);
+                }
+                continue;
+            case CT_PATLAK_CODE_COUNT:
+                item.counters[code->counter] = 0;
+                break;
+            case CT_PATLAK_CODE_REPEAT: {
+                CTIndex count = item.counters[code->counter];
+                if (code->maximum < 0 || count < code->maximum) {
+                    CTPatlakAutomatonItem repeat = item;
+                    if (code->maximum >= 0 || count < code->minimum) {
+                        repeat.counters[code->counter]++;
+                    }
+                    repeat.code++;
+                    ct_patlak_automaton_reach(builder, repeat);
+                }
+                if (count < code->minimum) {
+                    continue;
+                }
+            } break;
+            default:
+                break;
+        }
+        item.code += code->movement;
+        ct_patlak_automaton_reach(builder, item);
+    }
+    return true;
+}
+
+/* Make the state of the reached items that wait for a character, or find the
+ * equal state. Only the patterns before the lowest one that matched can still
+ * give a better match; so, the others are left out. The initial state does
+ * not accept, because empty matches do not count. Returns the index of the
+ * state, or negative if there are too many states. */
+CTIndex
+ct_patlak_automaton_collect(CTPatlakAutomatonBuilder* builder, bool initial)
+{
+    CTIndex accept = initial || builder->lowest == builder->order
+                       ? -1
+                       : builder->lowest;
+    CTIndex limit  = accept < 0 ? builder->order : accept;
+    CTIndex first  = builder->item_count;
+    for (CTIndex i = 0; i < builder->reached_count; i++) {
+        CTPatlakAutomatonItem const* item = builder->reached + i;
+        CTPatlakCode const* code =
+            ct_patlak_codes_get(builder->codes, item->code);
+        if (item->pattern >= limit || (code->type != CT_PATLAK_CODE_LITERAL &&
+                                       code->type != CT_PATLAK_CODE_RANGE &&
+                                       code->type != CT_PATLAK_CODE_SET &&
+                                       code->type != CT_PATLAK_CODE_STRING)) {
+            continue;
+        }
+        builder->items = ct_patlak_automaton_grow(
+            builder->items,
+            &builder->item_capacity,
+            builder->item_count + 1,
+            sizeof(CTPatlakAutomatonItem));
+        builder->items[builder->item_count++] = *item;
+    }
+    CTPatlakAutomatonItem* items  = builder->items + first;
+    CTIndex                amount = builder->item_count - first;
+    qsort(
+        items,
+        amount,
+        sizeof(CTPatlakAutomatonItem),
+        &ct_patlak_automaton_compare);
+
+    // Find the equal state. The initial state is never looked up, because
+    // it accepts differently than a state with the same items.
+    CTIndex mask = 2 * CT_PATLAK_AUTOMATON_STATES - 1;
+    CTIndex slot = (CTIndex)(ct_patlak_automaton_hash(items, amount) & mask);
+    for (; !initial && builder->table[slot] >= 0; slot = (slot + 1) & mask) {
+        CTIndex state = builder->table[slot];
+        CTIndex other = builder->bounds[state];
+        if (builder->accepts[state] == accept &&
+            builder->bounds[state + 1] - other == amount &&
+            memcmp(
+                builder->items + other,
+                items,
+                amount * sizeof(CTPatlakAutomatonItem)) == 0) {
+            builder->item_count = first;
+            return state;
+        }
+    }
+    if (builder->size == CT_PATLAK_AUTOMATON_STATES) {
+        return -1;
+    }
+
+    CTIndex state = builder->size++;
+    if (!initial) {
+        builder->table[slot] = state;
+    }
+    builder->bounds[state + 1] = builder->item_count;
+    builder->accepts[state]    = (int32_t)accept;
+    return state;
+}
+
+/* Whether the code of the codes moves with the character, when the amount of
+ * characters of the string code are matched. */
+bool ct_patlak_automaton_moves(
+    CTPatlakCodes const* codes,
+    CTPatlakCode const*  code,
+    CTIndex              offset,
+    unsigned char        character)
+{
+    if (code->type == CT_PATLAK_CODE_LITERAL) {
+        return character == (unsigned char)code->literal;
+    }
+    if (code->type == CT_PATLAK_CODE_STRING) {
+        return character ==
+               (unsigned char)ct_patlak_codes_string(codes, code).first[offset];
+    }
+    if (code->type == CT_PATLAK_CODE_SET) {
+        return ct_patlak_set_has(
+            ct_patlak_codes_set(codes, code),
+            (char)character);
+    }
+    return character >= (unsigned char)code->first &&
+           character <= (unsigned char)code->last;
+}
+
+/* Split the characters to the classes that the codes do not tell apart. */
+void ct_patlak_automaton_classes(
+    CTPatlakAutomatonBuilder* builder,
+    CTPatlakAutomaton*        automaton)
+{
+    // Mark the characters that start a new class.
+    bool starts[257] = {[0] = true};
+    for (CTPatlakCode const* i = builder->codes->first;
+         i < builder->codes->last;
+         i++) {
+        if (i->type == CT_PATLAK_CODE_LITERAL) {
+            starts[(unsigned char)i->literal]     = true;
+            starts[(unsigned char)i->literal + 1] = true;
+        } else if (i->type == CT_PATLAK_CODE_RANGE) {
+            starts[(unsigned char)i->first]    = true;
+            starts[(unsigned char)i->last + 1] = true;
+        } else if (i->type == CT_PATLAK_CODE_STRING) {
+            CTString string = ct_patlak_codes_string(builder->codes, i);
+            for (char const* j = string.first; j < string.last; j++) {
+                starts[(unsigned char)*j]     = true;
+                starts[(unsigned char)*j + 1] = true;
+            }
+        } else if (i->type == CT_PATLAK_CODE_SET) {
+            CTPatlakSet const* set = ct_patlak_codes_set(builder->codes, i);
+            for (int j = 1; j < 256; j++) {
+                starts[j] |= ct_patlak_set_has(set, (char)j) !=
+                             ct_patlak_set_has(set, (char)(j - 1));
+            }
+        }
+    }
+    for (int i = 0; i < 256; i++) {
+        if (starts[i]) {
+            builder->representatives[builder->class_count++] = (unsigned char)i;
+        }
+        automaton->classes[i] = (unsigned char)(builder->class_count - 1);
+    }
+    automaton->class_count = builder->class_count;
+}
+
+/* Build the states and their transitions from the starts of the patterns in
+ * the order. The state at index zero is the dead one, and the next one is the
+ * initial one. Returns false if the patterns cannot be built. */
+bool ct_patlak_automaton_build(
+    CTPatlakAutomatonBuilder* builder,
+    CTIndex const*            starts)
+{
+    ct_patlak_automaton_clear(builder);
+    ct_patlak_automaton_collect(builder, false);
+    for (CTIndex i = 0; i < builder->order; i++) {
+        CTPatlakAutomatonItem item = {.pattern = i, .code = starts[i]};
+        ct_patlak_automaton_reach(builder, item);
+    }
+    if (!ct_patlak_automaton_follow(builder)) {
+        return false;
+    }
+    ct_patlak_automaton_collect(builder, true);
+
+    CTIndex classes = builder->class_count;
+    CTIndex allocated = 0;
+    for (CTIndex state = 0; state < builder->size; state++) {
+        builder->transitions = ct_patlak_automaton_grow(
+            builder->transitions,
+            &allocated,
+            (state + 1) * classes,
+            sizeof(int32_t));
+        for (CTIndex k = 0; k < classes; k++) {
+            ct_patlak_automaton_clear(builder);
+            unsigned char character = builder->representatives[k];
+            for (CTIndex i = builder->bounds[state];
+                 i < builder->bounds[state + 1];
+                 i++) {
+                CTPatlakAutomatonItem item = builder->items[i];
+                CTPatlakCode const*   code =
+                    ct_patlak_codes_get(builder->codes, item.code);
+                if (!ct_patlak_automaton_moves(
+                        builder->codes,
+                        code,
+                        item.offset,
+                        character)) {
+                    continue;
+                }
+
+                // Stay in the string code until all of it is matched.
+                item.offset++;
+                if (code->type != CT_PATLAK_CODE_STRING ||
+                    item.offset == code->length) {
+                    item.code += code->movement;
+                    item.offset = 0;
+                }
+                ct_patlak_automaton_reach(builder, item);
+            }
+            if (!ct_patlak_automaton_follow(builder)) {
+                return false;
+            }
+            CTIndex next = ct_patlak_automaton_collect(builder, false);
+            if (next < 0) {
+                return false;
+            }
+            builder->transitions[state * classes + k] = (int32_t)next;
+        }
+    }
+    return true;
+}
+
+/* Partition of the states to the blocks of equivalent states, which is
+ * refined by Hopcroft's algorithm. */
+typedef struct {
+    /* States, the ones of each block after the other. */
+    CTIndex* elements;
+    /* Index of each state in the elements. */
+    CTIndex* positions;
+    /* Block of each state. */
+    CTIndex* blocks;
+    /* Border before the states of each block in the elements. */
+    CTIndex* firsts;
+    /* Border after the states of each block in the elements. */
+    CTIndex* lasts;
+    /* Amount of marked states at the start of each block. */
+    CTIndex* marked;
+    /* Blocks that were marked by the current splitter. */
+    CTIndex* touched;
+    /* Amount of touched blocks. */
+    CTIndex touched_count;
+    /* Blocks that wait to split the others. */
+    CTIndex* waiting;
+    /* Amount of waiting blocks. */
+    CTIndex waiting_count;
+    /* Whether each block is waiting. */
+    bool* queued;
+    /* Amount of blocks. */
+    CTIndex count;
+} CTPatlakAutomatonPartition;
+
+/* Mark the state in its block by moving it to the marked ones at the start of
+ * the block. */
+void ct_patlak_automaton_mark(
+    CTPatlakAutomatonPartition* partition,
+    CTIndex                     state)
+{
+    CTIndex block    = partition->blocks[state];
+    CTIndex position = partition->positions[state];
+    CTIndex border   = partition->firsts[block] + partition->marked[block];
+    if (position < border) {
+        return;
+    }
+    CTIndex other                    = partition->elements[border];
+    partition->elements[border]      = state;
+    partition->elements[position]    = other;
+    partition->positions[state]      = border;
+    partition->positions[other]      = position;
+    if (partition->marked[block]++ == 0) {
+        partition->touched[partition->touched_count++] = block;
+    }
+}
+
+/* Add the block to the waiting ones. */
+void ct_patlak_automaton_wait(
+    CTPatlakAutomatonPartition* partition,
+    CTIndex                     block)
+{
+    partition->queued[block]                       = true;
+    partition->waiting[partition->waiting_count++] = block;
+}
+
+/* Split the touched blocks to their marked and unmarked states. The smaller
+ * part becomes a new block that waits, which is enough even if the block was
+ * not waiting, because splitting with the block and one part is the same as
+ * splitting with both parts. */
+void ct_patlak_automaton_split(CTPatlakAutomatonPartition* partition)
+{
+    for (CTIndex i = 0; i < partition->touched_count; i++) {
+        CTIndex block  = partition->touched[i];
+        CTIndex first  = partition->firsts[block];
+        CTIndex last   = partition->lasts[block];
+        CTIndex border = first + partition->marked[block];
+        partition->marked[block] = 0;
+        if (border == last) {
+            continue;
+        }
+
+        CTIndex part = partition->count++;
+        if (border - first <= last - border) {
+            partition->firsts[part] = first;
+            partition->lasts[part]  = border;
+            partition->firsts[block] = border;
+        } else {
+            partition->firsts[part] = border;
+            partition->lasts[part]  = last;
+            partition->lasts[block] = border;
+        }
+        partition->marked[part] = 0;
+        partition->queued[part] = false;
+        for (CTIndex j = partition->firsts[part]; j < partition->lasts[part];
+             j++) {
+            partition->blocks[partition->elements[j]] = part;
+        }
+        ct_patlak_automaton_wait(partition, part);
+    }
+    partition->touched_count = 0;
+}
+
+/* Merge the equivalent states of the built automaton to the automaton. The
+ * states start partitioned by the pattern they accept, so a match of a
+ * pattern is never merged with a match of another one, which keeps the
+ * priorities of the order. */
+void ct_patlak_automaton_minimize(
+    CTPatlakAutomatonBuilder const* builder,
+    CTPatlakAutomaton*              automaton)
+{
+    CTIndex size    = builder->size;
+    CTIndex classes = builder->class_count;
+
+    // Predecessors of each state through each class, grouped by the class
+    // and the state.
+    CTIndex* bounds = calloc(classes * size + 1, sizeof(CTIndex));
+    CTIndex* sources = calloc(classes * size, sizeof(CTIndex));
+    ct_expect(bounds != NULL && sources != NULL, "Could not allocate!");
+    for (CTIndex state = 0; state < size; state++) {
+        for (CTIndex k = 0; k < classes; k++) {
+            bounds[k * size + builder->transitions[state * classes + k] + 1]++;
+        }
+    }
+    for (CTIndex i = 0; i < classes * size; i++) {
+        bounds[i + 1] += bounds[i];
+    }
+    CTIndex* filled = calloc(classes * size, sizeof(CTIndex));
+    ct_expect(filled != NULL, "Could not allocate!");
+    for (CTIndex state = 0; state < size; state++) {
+        for (CTIndex k = 0; k < classes; k++) {
+            CTIndex group =
+                k * size + builder->transitions[state * classes + k];
+            sources[bounds[group] + filled[group]++] = state;
+        }
+    }
+    free(filled);
+
+    CTIndex* memory = calloc(8 * size, sizeof(CTIndex));
+    bool*    queued = calloc(size, sizeof(bool));
+    ct_expect(memory != NULL && queued != NULL, "Could not allocate!");
+    CTPatlakAutomatonPartition partition = {
+        .elements  = memory,
+        .positions = memory + size,
+        .blocks    = memory + 2 * size,
+        .firsts    = memory + 3 * size,
+        .lasts     = memory + 4 * size,
+        .marked    = memory + 5 * size,
+        .touched   = memory + 6 * size,
+        .waiting   = memory + 7 * size,
+        .queued    = queued};
+
+    // Start with a block for each accepted pattern and one for the others.
+    CTIndex* splitter = calloc(size, sizeof(CTIndex));
+    ct_expect(splitter != NULL, "Could not allocate!");
+    for (CTIndex accept = -1, placed = 0; placed < size; accept++) {
+        CTIndex first = placed;
+        for (CTIndex state = 0; state < size; state++) {
+            if (builder->accepts[state] == accept) {
+                partition.positions[state]   = placed;
+                partition.blocks[state]      = partition.count;
+                partition.elements[placed++] = state;
+            }
+        }
+        if (placed > first) {
+            partition.firsts[partition.count] = first;
+            partition.lasts[partition.count]  = placed;
+            ct_patlak_automaton_wait(&partition, partition.count++);
+        }
+    }
+
+    while (partition.waiting_count > 0) {
+        CTIndex block = partition.waiting[--partition.waiting_count];
+        partition.queued[block] = false;
+
+        // Copy the splitter, as it might split itself.
+        CTIndex amount = partition.lasts[block] - partition.firsts[block];
+        memcpy(
+            splitter,
+            partition.elements + partition.firsts[block],
+            amount * sizeof(CTIndex));
+        for (CTIndex k = 0; k < classes; k++) {
+            for (CTIndex i = 0; i < amount; i++) {
+                CTIndex group = k * size + splitter[i];
+                for (CTIndex j = bounds[group]; j < bounds[group + 1]; j++) {
+                    ct_patlak_automaton_mark(&partition, sources[j]);
+                }
+            }
+            ct_patlak_automaton_split(&partition);
+        }
+    }
+
+    // Each block is a state that behaves as any of the states in it.
+    automaton->size        = partition.count;
+    automaton->transitions = calloc(partition.count * classes, sizeof(int32_t));
+    automaton->accepts     = calloc(partition.count, sizeof(int32_t));
+    ct_expect(
+        automaton->transitions != NULL && automaton->accepts != NULL,
+        "Could not allocate!");
+    ct_memory_account(
+        CT_MEMORY_AUTOMATA,
+        0,
+        partition.count * (classes + 1) * (CTIndex)sizeof(int32_t));
+    for (CTIndex block = 0; block < partition.count; block++) {
+        CTIndex state = partition.elements[partition.firsts[block]];
+        automaton->accepts[block] = builder->accepts[state];
+        for (CTIndex k = 0; k < classes; k++) {
+            automaton->transitions[block * classes + k] = (int32_t)
+                partition.blocks[builder->transitions[state * classes + k]];
+        }
+    }
+    automaton->dead  = (int32_t)partition.blocks[0];
+    automaton->start = (int32_t)partition.blocks[1];
+
+    free(splitter);
+    free(memory);
+    free(queued);
+    free(bounds);
+    free(sources);
+}
+
+/* Build the minimal automaton of the patterns that start at the codes, which
+ * are in the order of their priority. Returns false and leaves the automaton
+ * empty if the patterns have references or need too many states, which should
+ * be decoded instead. */
+bool ct_patlak_automaton(
+    CTPatlakAutomaton*   automaton,
+    CTPatlakCodes const* codes,
+    CTIndex const*       starts,
+    CTIndex              order)
+{
+    *automaton                       = (CTPatlakAutomaton){0};
+    CTIndex                  states  = CT_PATLAK_AUTOMATON_STATES;
+    CTPatlakAutomatonBuilder builder = {
+        .codes         = codes,
+        .order         = order,
+        .items         = calloc(16, sizeof(CTPatlakAutomatonItem)),
+        .item_capacity = 16,
+        .bounds        = calloc(states + 1, sizeof(CTIndex)),
+        .accepts       = calloc(states, sizeof(int32_t)),
+        .table         = calloc(2 * states, sizeof(CTIndex)),
+        .seen          = calloc(16, sizeof(CTIndex)),
+        .seen_capacity = 16};
+    ct_expect(
+        builder.items != NULL && builder.bounds != NULL &&
+            builder.accepts != NULL && builder.table != NULL &&
+            builder.seen != NULL,
+        "Could not allocate!");
+    memset(
+        builder.table,
+        0xFF,
+        2 * CT_PATLAK_AUTOMATON_STATES * sizeof(CTIndex));
+
+    ct_patlak_automaton_classes(&builder, automaton);
+    bool built = ct_patlak_automaton_build(&builder, starts);
+    if (built) {
+        ct_patlak_automaton_minimize(&builder, automaton);
+    } else {
+        *automaton = (CTPatlakAutomaton){0};
+    }
+
+    free(builder.items);
+    free(builder.bounds);
+    free(builder.accepts);
+    free(builder.transitions);
+    free(builder.table);
+    free(builder.reached);
+    free(builder.seen);
+    return built;
+}
+
+/* Match the patterns of the automaton to the input. Returns the shortest match
+ * of the first pattern in the order that matches, and sets the index of the
+ * pattern in the order. Empty match means none of them matched, and the index
+ * is not set then. */
+CTString ct_patlak_automaton_match(
+    CTPatlakAutomaton const* automaton,
+    CTString const*          input,
+    CTIndex*                 matched)
+{
+    int32_t     state = automaton->start;
+    char const* last  = NULL;
+    for (char const* i = input->first; i < input->last; i++) {
+        state = automaton->transitions
+                    [state * automaton->class_count +
+                     automaton->classes[(unsigned char)*i]];
+        if (state == automaton->dead) {
+            break;
+        }
+
+        // Later matches are always of a pattern that comes before.
+        if (automaton->accepts[state] >= 0) {
+            *matched = automaton->accepts[state];
+            last     = i + 1;
+        }
+    }
+    return last == NULL ? (CTString){0}
+                        : (CTString){.first = input->first, .last = last};
+}
+
+/* Deallocate memory. */
+void ct_patlak_automaton_free(CTPatlakAutomaton* automaton)
+{
+    if (automaton->transitions != NULL) {
+        ct_memory_account(
+            CT_MEMORY_AUTOMATA,
+            automaton->size * (automaton->class_count + 1) *
+                (CTIndex)sizeof(int32_t),
+            0);
+    }
+    free(automaton->transitions);
+    free(automaton->accepts);
+    automaton->transitions = NULL;
+    automaton->accepts     = NULL;
+    automaton->size        = 0;
+}
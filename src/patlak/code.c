@@ -3,10 +3,23 @@
 
 #pragma once
 
+#include "patlak/set.c"
 #include "prelude/expect.c"
+#include "prelude/memory.c"
 #include "prelude/scalar.c"
+#include "prelude/string.c"
 
 #include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#    include <emmintrin.h>
+#endif
+
+/* Most amount of characters a string code holds, so the string is compared in
+ * at most two blocks of 16 characters. Longer strings are split to consecutive
+ * string codes. */
+#define CT_PATLAK_CODE_CHARACTERS 31
 
 /* Compiled pattern information. These are the transitions in the
  * nondeterministic finite automaton with empty moves. */
@@ -22,10 +35,25 @@ typedef struct {
         CT_PATLAK_CODE_LITERAL,
         /* Move if the character is in the range. */
         CT_PATLAK_CODE_RANGE,
+        /* Move if the character is in the set. */
+        CT_PATLAK_CODE_SET,
+        /* Move if the input starts with the string, consuming all of it in
+         * one step. */
+        CT_PATLAK_CODE_STRING,
         /* Move if the reffered pattern matches. */
         CT_PATLAK_CODE_REFERANCE,
         /* Divergence of alternative transition states. */
         CT_PATLAK_CODE_BRANCH,
+        /* Reset the counter and move regardless without consuming a
+         * character. */
+        CT_PATLAK_CODE_COUNT,
+        /* Divergence to the repeated code that comes after it if the counter
+         * is below the maximum, and to the movement if the counter is at least
+         * the minimum. */
+        CT_PATLAK_CODE_REPEAT,
+        /* Record the position of the input to the tag and move regardless
+         * without consuming a character. */
+        CT_PATLAK_CODE_TAG,
         /* End of a pattern, meaning a match. */
         CT_PATLAK_CODE_TERMINAL
     } type;
@@ -43,15 +71,43 @@ typedef struct {
             char last;
         };
 
+        /* Data of SET type. Index of the set of the characters to match in
+         * the sets of the codes, which are kept aside so the other codes are
+         * not as big as a set. */
+        CTIndex set;
+
+        /* Data of STRING type. */
+        struct {
+            /* Index of the first character to match in the characters of the
+             * codes. */
+            CTIndex string;
+            /* Amount of characters, which is at least two. */
+            CTIndex length;
+        };
+
         /* Data of REFERANCE type. Index of the reffered pattern. */
         CTIndex reffered;
 
         /* Data of BRANCH type. Amount of branches. */
         CTIndex branches;
+
+        /* Data of COUNT and REPEAT types. */
+        struct {
+            /* Index of the counter in the state. */
+            int counter;
+            /* Least amount of repeats. */
+            int minimum;
+            /* Most amount of repeats. Negative means there is no limit. */
+            int maximum;
+        };
+
+        /* Data of TAG type. Index of the tag in the state. */
+        int tag;
     };
 } CTPatlakCode;
 
-/* Dynamic array of codes. */
+/* Dynamic array of codes, with the sets and the strings the codes point to
+ * next to them. */
 typedef struct {
     /* Border before the first code. */
     CTPatlakCode* first;
@@ -59,6 +115,18 @@ typedef struct {
     CTPatlakCode* last;
     /* Border after the last allocated code. */
     CTPatlakCode* allocated;
+    /* Sets of the set codes. */
+    CTPatlakSet* sets;
+    /* Amount of sets. */
+    CTIndex set_count;
+    /* Amount of allocated sets. */
+    CTIndex set_capacity;
+    /* Characters of the string codes, one string after the other. */
+    char* characters;
+    /* Amount of characters. */
+    CTIndex character_count;
+    /* Amount of allocated characters. */
+    CTIndex character_capacity;
 } CTPatlakCodes;
 
 /* Amount of codes. */
@@ -112,17 +180,175 @@ void ct_patlak_codes_reserve(CTPatlakCodes* codes, CTIndex amount)
     CTPatlakCode* memory =
         reallocarray(codes->first, new_capacity, sizeof(CTPatlakCode));
     ct_expect(memory != NULL, "Could not allocate!");
+    ct_memory_account(
+        CT_MEMORY_CODES,
+        capacity * (CTIndex)sizeof(CTPatlakCode),
+        new_capacity * (CTIndex)sizeof(CTPatlakCode));
 
     codes->last      = memory + ct_patlak_codes_size(codes);
     codes->first     = memory;
     codes->allocated = memory + new_capacity;
 }
 
+/* Add to the end of codes. */
+void ct_patlak_codes_add(CTPatlakCodes* codes, CTPatlakCode code)
+{
+    ct_patlak_codes_reserve(codes, 1);
+    *codes->last++ = code;
+}
+
+/* Open space for the amount of codes before the index by moving the codes
+ * after it. The opened codes are left as they were. */
+void ct_patlak_codes_open(CTPatlakCodes* codes, CTIndex index, CTIndex amount)
+{
+    ct_expect(
+        index >= 0 && index <= ct_patlak_codes_size(codes),
+        "Index out of bounds!");
+    ct_patlak_codes_reserve(codes, amount);
+    CTPatlakCode* position = codes->first + index;
+    memmove(
+        position + amount,
+        position,
+        (codes->last - position) * sizeof(CTPatlakCode));
+    codes->last += amount;
+}
+
+/* Make sure the amount of elements of the width fit to the table of the
+ * codes. Grows by at least the half of the capacity if necessary. */
+void* ct_patlak_codes_grow(
+    void*    table,
+    CTIndex* capacity,
+    CTIndex  amount,
+    CTIndex  width)
+{
+    if (amount <= *capacity) {
+        return table;
+    }
+    CTIndex new_capacity = *capacity + (*capacity >> 1);
+    if (new_capacity < amount) {
+        new_capacity = amount;
+    }
+    table = reallocarray(table, new_capacity, width);
+    ct_expect(table != NULL, "Could not allocate!");
+    ct_memory_account(
+        CT_MEMORY_CODES,
+        *capacity * width,
+        new_capacity * width);
+    *capacity = new_capacity;
+    return table;
+}
+
+/* Add the set to the sets of the codes. Returns its index. */
+CTIndex ct_patlak_codes_add_set(CTPatlakCodes* codes, CTPatlakSet const* set)
+{
+    codes->sets = ct_patlak_codes_grow(
+        codes->sets,
+        &codes->set_capacity,
+        codes->set_count + 1,
+        sizeof(CTPatlakSet));
+    codes->sets[codes->set_count] = *set;
+    return codes->set_count++;
+}
+
+/* Set of the set code. */
+CTPatlakSet const*
+ct_patlak_codes_set(CTPatlakCodes const* codes, CTPatlakCode const* code)
+{
+    ct_expect(
+        code->set >= 0 && code->set < codes->set_count,
+        "Set out of bounds!");
+    return codes->sets + code->set;
+}
+
+/* Add the characters of the string to the characters of the codes. Returns
+ * the index of the first one. */
+CTIndex
+ct_patlak_codes_add_string(CTPatlakCodes* codes, CTString const* string)
+{
+    CTIndex size       = ct_string_size(string);
+    codes->characters = ct_patlak_codes_grow(
+        codes->characters,
+        &codes->character_capacity,
+        codes->character_count + size,
+        sizeof(char));
+    memcpy(codes->characters + codes->character_count, string->first, size);
+    codes->character_count += size;
+    return codes->character_count - size;
+}
+
+/* Characters of the string code. */
+CTString
+ct_patlak_codes_string(CTPatlakCodes const* codes, CTPatlakCode const* code)
+{
+    ct_expect(
+        code->string >= 0 &&
+            code->string + code->length <= codes->character_count,
+        "String out of bounds!");
+    char const* first = codes->characters + code->string;
+    return (CTString){.first = first, .last = first + code->length};
+}
+
+/* Whether the input starts with the string of the code. Strings of at least
+ * 16 characters are compared as two blocks of 16 characters that overlap
+ * when vector instructions are available. */
+bool ct_patlak_codes_starts(
+    CTPatlakCodes const* codes,
+    CTPatlakCode const*  code,
+    CTString const*      input)
+{
+    char const* string = ct_patlak_codes_string(codes, code).first;
+    CTIndex     length = code->length;
+    if (input->last - input->first < length) {
+        return false;
+    }
+#if defined(__SSE2__)
+    if (length >= 16) {
+        char const* tail   = string + length - 16;
+        __m128i     head   = _mm_cmpeq_epi8(
+            _mm_loadu_si128((__m128i const*)string),
+            _mm_loadu_si128((__m128i const*)input->first));
+        __m128i     ending = _mm_cmpeq_epi8(
+            _mm_loadu_si128((__m128i const*)tail),
+            _mm_loadu_si128((__m128i const*)(input->first + length - 16)));
+        return _mm_movemask_epi8(_mm_and_si128(head, ending)) == 0xFFFF;
+    }
+#endif
+    return memcmp(string, input->first, length) == 0;
+}
+
+/* Take the sets and the characters of the other codes, which are left without
+ * them. Codes that are moved from the other codes keep pointing to the same
+ * ones. */
+void ct_patlak_codes_take(CTPatlakCodes* codes, CTPatlakCodes* other)
+{
+    codes->sets               = other->sets;
+    codes->set_count          = other->set_count;
+    codes->set_capacity       = other->set_capacity;
+    codes->characters         = other->characters;
+    codes->character_count    = other->character_count;
+    codes->character_capacity = other->character_capacity;
+    other->sets               = NULL;
+    other->set_count          = 0;
+    other->set_capacity       = 0;
+    other->characters         = NULL;
+    other->character_count    = 0;
+    other->character_capacity = 0;
+}
+
 /* Deallocate memory. */
 void ct_patlak_codes_free(CTPatlakCodes* codes)
 {
+    ct_memory_account(
+        CT_MEMORY_CODES,
+        ct_patlak_codes_capacity(codes) * (CTIndex)sizeof(CTPatlakCode),
+        0);
+    ct_memory_account(
+        CT_MEMORY_CODES,
+        codes->set_capacity * (CTIndex)sizeof(CTPatlakSet) +
+            codes->character_capacity,
+        0);
     free(codes->first);
-    codes->first     = NULL;
-    codes->last      = NULL;
-    codes->allocated = NULL;
+    free(codes->sets);
+    free(codes->characters);
+    *codes = (CTPatlakCodes){0};
 }
@@ -0,0 +1,180 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "patlak/token.c"
+#include "prelude/expect.c"
+#include "prelude/memory.c"
+#include "prelude/scalar.c"
+#include "prelude/string.c"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Amount of bytes a compact token takes from each of the arrays. */
+#define CT_PATLAK_COMPACT_WIDTH \
+    (CTIndex)(sizeof(signed char) + 2 * sizeof(uint32_t))
+
+/* Dynamic array of tokens that keeps each part of the tokens in a separate
+ * array. Token strings are kept as 32-bit offsets and sizes from the start of
+ * the source, which takes 9 bytes for a token instead of 24. */
+typedef struct {
+    /* Start of the source that is lexed. */
+    char const* base;
+    /* Amount of tokens. */
+    CTIndex size;
+    /* Amount of allocated tokens. */
+    CTIndex capacity;
+    /* Types of the tokens. */
+    signed char* types;
+    /* Amount of characters before the tokens in the source. */
+    uint32_t* offsets;
+    /* Amount of characters in the tokens. */
+    uint32_t* sizes;
+} CTPatlakCompactTokens;
+
+/* Compact tokens of the source that starts at the base. */
+CTPatlakCompactTokens ct_patlak_compact(char const* base)
+{
+    return (CTPatlakCompactTokens){.base = base};
+}
+
+/* Whether the index is valid. */
+bool ct_patlak_compact_valid(
+    CTPatlakCompactTokens const* tokens,
+    CTIndex                      index)
+{
+    return index >= 0 && index < tokens->size;
+}
+
+/* Type of the token at the index. */
+CTPatlakTokenType
+ct_patlak_compact_type(CTPatlakCompactTokens const* tokens, CTIndex index)
+{
+    ct_expect(ct_patlak_compact_valid(tokens, index), "Index out of bounds!");
+    return tokens->types[index];
+}
+
+/* String of the token at the index. */
+CTString
+ct_patlak_compact_value(CTPatlakCompactTokens const* tokens, CTIndex index)
+{
+    ct_expect(ct_patlak_compact_valid(tokens, index), "Index out of bounds!");
+    char const* first = tokens->base + tokens->offsets[index];
+    return (CTString){.first = first, .last = first + tokens->sizes[index]};
+}
+
+/* Token at the index. */
+CTPatlakToken
+ct_patlak_compact_get(CTPatlakCompactTokens const* tokens, CTIndex index)
+{
+    return (CTPatlakToken){
+        .type  = ct_patlak_compact_type(tokens, index),
+        .value = ct_patlak_compact_value(tokens, index)};
+}
+
+/* Index of the first token of the type at or after the index. Looks only at
+ * the types. Returns the amount of tokens if there is none. */
+CTIndex ct_patlak_compact_find(
+    CTPatlakCompactTokens const* tokens,
+    CTIndex                      index,
+    CTPatlakTokenType            type)
+{
+    ct_expect(index >= 0 && index <= tokens->size, "Index out of bounds!");
+    signed char const* found =
+        memchr(tokens->types + index, (signed char)type, tokens->size - index);
+    if (found == NULL) {
+        return tokens->size;
+    }
+    return found - tokens->types;
+}
+
+/* Make sure the amount of tokens will fit. Grows by at least the half of
+ * the current capacity if necessary. */
+void ct_patlak_compact_reserve(CTPatlakCompactTokens* tokens, CTIndex amount)
+{
+    ct_expect(amount >= 0, "Reserving negative amount!");
+    CTIndex growth = amount - (tokens->capacity - tokens->size);
+    if (growth <= 0) {
+        return;
+    }
+
+    CTIndex half_capacity = tokens->capacity >> 1;
+    if (growth < half_capacity) {
+        growth = half_capacity;
+    }
+
+    CTIndex      new_capacity = tokens->capacity + growth;
+    signed char* types =
+        reallocarray(tokens->types, new_capacity, sizeof(signed char));
+    ct_expect(types != NULL, "Could not allocate!");
+    tokens->types = types;
+    uint32_t* offsets =
+        reallocarray(tokens->offsets, new_capacity, sizeof(uint32_t));
+    ct_expect(offsets != NULL, "Could not allocate!");
+    tokens->offsets = offsets;
+    uint32_t* sizes =
+        reallocarray(tokens->sizes, new_capacity, sizeof(uint32_t));
+    ct_expect(sizes != NULL, "Could not allocate!");
+    tokens->sizes = sizes;
+    ct_memory_account(
+        CT_MEMORY_TOKENS,
+        tokens->capacity * CT_PATLAK_COMPACT_WIDTH,
+        new_capacity * CT_PATLAK_COMPACT_WIDTH);
+
+    tokens->capacity = new_capacity;
+}
+
+/* Add to the end of tokens. The token must be in the source. */
+void ct_patlak_compact_add(CTPatlakCompactTokens* tokens, CTPatlakToken token)
+{
+    CTIndex offset = token.value.first - tokens->base;
+    CTIndex size   = ct_string_size(&token.value);
+    ct_expect(
+        offset >= 0 && offset <= UINT32_MAX && size <= UINT32_MAX,
+        "Token does not fit!");
+
+    ct_patlak_compact_reserve(tokens, 1);
+    tokens->types[tokens->size]   = (signed char)token.type;
+    tokens->offsets[tokens->size] = (uint32_t)offset;
+    tokens->sizes[tokens->size]   = (uint32_t)size;
+    tokens->size++;
+}
+
+/* Add all the tokens in the list to the end of tokens. */
+void ct_patlak_compact_add_all(
+    CTPatlakCompactTokens* tokens,
+    CTPatlakTokens const*  list)
+{
+    ct_patlak_compact_reserve(tokens, ct_patlak_tokens_size(list));
+    for (CTPatlakToken const* i = list->first; i < list->last; i++) {
+        ct_patlak_compact_add(tokens, *i);
+    }
+}
+
+/* Remove the tokens, and take the tokens of the source that starts at the
+ * base after them. Keeps the memory. */
+void ct_patlak_compact_clear(CTPatlakCompactTokens* tokens, char const* base)
+{
+    tokens->base = base;
+    tokens->size = 0;
+}
+
+/* Deallocate memory. */
+void ct_patlak_compact_free(CTPatlakCompactTokens* tokens)
+{
+    ct_memory_account(
+        CT_MEMORY_TOKENS,
+        tokens->capacity * CT_PATLAK_COMPACT_WIDTH,
+        0);
+    free(tokens->types);
+    free(tokens->offsets);
+    free(tokens->sizes);
+    tokens->size     = 0;
+    tokens->capacity = 0;
+    tokens->types    = NULL;
+    tokens->offsets  = NULL;
+    tokens->sizes    = NULL;
+}
@@ -0,0 +1,811 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "patlak/code.c"
+#include "patlak/lexer.c"
+#include "patlak/pattern.c"
+#include "patlak/set.c"
+#include "patlak/state.c"
+#include "patlak/token.c"
+#include "prelude/expect.c"
+#include "prelude/scalar.c"
+#include "prelude/string.c"
+#include "prelude/utf8.c"
+
+#include <limits.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* Information while compiling a pattern. */
+typedef struct {
+    /* Border before the next token. */
+    CTPatlakToken const* current;
+    /* Border after the last token. */
+    CTPatlakToken const* last;
+    /* Codes that are compiled to. */
+    CTPatlakCodes* codes;
+    /* Patterns that can be referenced. */
+    CTPatlakPatterns const* patterns;
+    /* Amount of counted repeats that are compiled into each other. */
+    int counters;
+    /* Names of the captures of the pattern. */
+    CTString captures[CT_PATLAK_PATTERN_CAPTURES];
+    /* Amount of captures of the pattern. */
+    int capture_count;
+} CTPatlakCompiler;
+
+/* Whether there are tokens left. */
+bool ct_patlak_compiler_finite(CTPatlakCompiler const* compiler)
+{
+    return compiler->current < compiler->last;
+}
+
+/* Whether the next token is of the type. */
+bool ct_patlak_compiler_peek(
+    CTPatlakCompiler const* compiler,
+    CTPatlakTokenType       type)
+{
+    return ct_patlak_compiler_finite(compiler) &&
+           compiler->current->type == type;
+}
+
+/* Consume the next token, which must be of the type. */
+CTPatlakToken const*
+ct_patlak_compiler_take(CTPatlakCompiler* compiler, CTPatlakTokenType type)
+{
+    ct_expect(ct_patlak_compiler_peek(compiler, type), "Unexpected token!");
+    return compiler->current++;
+}
+
+/* Index of the code that will be emitted next. */
+CTIndex ct_patlak_compiler_here(CTPatlakCompiler const* compiler)
+{
+    return ct_patlak_codes_size(compiler->codes);
+}
+
+/* Add the code to the end. Returns its index. */
+CTIndex ct_patlak_compiler_emit(CTPatlakCompiler* compiler, CTPatlakCode code)
+{
+    CTIndex index = ct_patlak_compiler_here(compiler);
+    ct_patlak_codes_add(compiler->codes, code);
+    return index;
+}
+
+/* Set the movement of the code at the index to reach the target index. */
+void ct_patlak_compiler_patch(
+    CTPatlakCompiler* compiler,
+    CTIndex           index,
+    CTIndex           target)
+{
+    ct_patlak_codes_get(compiler->codes, index)->movement = target - index;
+}
+
+/* Value of an uppercase hexadecimal digit. */
+int ct_patlak_compiler_hex(char character)
+{
+    if (character >= '0' && character <= '9') {
+        return character - '0';
+    }
+    ct_expect(
+        character >= 'A' && character <= 'F',
+        "Not an uppercase hexadecimal digit!");
+    return character - 'A' + 10;
+}
+
+/* Decode the possibly escaped character at the start of the string and
+ * consume it. */
+char ct_patlak_compiler_character(CTString* string)
+{
+    ct_expect(ct_string_finite(string), "Expected a character!");
+    char character = *string->first++;
+    if (character != '\\') {
+        return character;
+    }
+
+    ct_expect(ct_string_finite(string), "Incomplete escape sequence!");
+    character = *string->first++;
+    switch (character) {
+        case 'n':
+            return '\n';
+        case 't':
+            return '\t';
+        case '\\':
+        case '\'':
+        case '~':
+            return character;
+        default: {
+            ct_expect(ct_string_finite(string), "Incomplete escape sequence!");
+            int high = ct_patlak_compiler_hex(character);
+            int low  = ct_patlak_compiler_hex(*string->first++);
+            return (char)(high << 4 | low);
+        }
+    }
+}
+
+/* Decode the character or the code point at the start of the string and
+ * consume it. Code points are written as UTF-8 or as "\u{HEX}", and set the
+ * flag; other characters are bytes. */
+CTIndex ct_patlak_compiler_code_point(CTString* string, bool* unicode)
+{
+    ct_expect(ct_string_finite(string), "Expected a character!");
+    if (ct_string_size(string) >= 2 && string->first[0] == '\\' &&
+        string->first[1] == 'u') {
+        string->first += 2;
+        ct_expect(
+            ct_string_starts(string, '{'),
+            "Expected a curly bracket after the escape!");
+        string->first++;
+        CTIndex code_point = 0;
+        while (!ct_string_starts(string, '}')) {
+            ct_expect(ct_string_finite(string), "Incomplete escape sequence!");
+            ct_expect(code_point <= CT_UTF8_LAST, "Code point is too big!");
+            code_point = code_point << 4 | ct_patlak_compiler_hex(*string->first++);
+        }
+        string->first++;
+        ct_utf8_size(code_point);
+        *unicode = true;
+        return code_point;
+    }
+
+    // Bytes that are not valid UTF-8 stay as they are.
+    CTIndex code_point = 0;
+    int     size       = ct_utf8_decode(string, &code_point);
+    if (size > 1) {
+        string->first += size;
+        *unicode = true;
+        return code_point;
+    }
+    return (unsigned char)ct_patlak_compiler_character(string);
+}
+
+/* Compile the byte range, which is a literal if it has a single byte. */
+void ct_patlak_compiler_bytes(
+    CTPatlakCompiler* compiler,
+    unsigned char     first,
+    unsigned char     last)
+{
+    if (first == last) {
+        ct_patlak_compiler_emit(
+            compiler,
+            (CTPatlakCode){
+                .movement = 1,
+                .type     = CT_PATLAK_CODE_LITERAL,
+                .literal  = (char)first});
+        return;
+    }
+    ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){
+            .movement = 1,
+            .type     = CT_PATLAK_CODE_RANGE,
+            .first    = (char)first,
+            .last     = (char)last});
+}
+
+/* Most amount of byte sequences a code point range is split into. */
+#define CT_PATLAK_COMPILER_SEQUENCES 32
+
+/* Byte ranges of code point ranges whose encodings are the same size and
+ * differ only in the bytes that each cover a whole range. */
+typedef struct {
+    /* First bytes of the ranges of each sequence. */
+    unsigned char firsts[CT_PATLAK_COMPILER_SEQUENCES][4];
+    /* Last bytes of the ranges of each sequence. */
+    unsigned char lasts[CT_PATLAK_COMPILER_SEQUENCES][4];
+    /* Amount of bytes of each sequence. */
+    int sizes[CT_PATLAK_COMPILER_SEQUENCES];
+    /* Amount of sequences. */
+    int count;
+} CTPatlakCompilerSequences;
+
+/* Split the code point range until each part is a sequence of byte ranges.
+ * Surrogates are left out, and parts are cut where the size of the encoding
+ * changes and then where a continuation byte does not cover all of its
+ * values. */
+void ct_patlak_compiler_split(
+    CTPatlakCompilerSequences* sequences,
+    CTIndex                    first,
+    CTIndex                    last)
+{
+    if (first > last) {
+        return;
+    }
+    if (first <= CT_UTF8_SURROGATE_LAST && last >= CT_UTF8_SURROGATE_FIRST) {
+        ct_patlak_compiler_split(sequences, first, CT_UTF8_SURROGATE_FIRST - 1);
+        ct_patlak_compiler_split(sequences, CT_UTF8_SURROGATE_LAST + 1, last);
+        return;
+    }
+
+    CTIndex const sizes[3] = {0x7F, 0x7FF, 0xFFFF};
+    for (int i = 0; i < 3; i++) {
+        if (first <= sizes[i] && last > sizes[i]) {
+            ct_patlak_compiler_split(sequences, first, sizes[i]);
+            ct_patlak_compiler_split(sequences, sizes[i] + 1, last);
+            return;
+        }
+    }
+
+    for (int i = 1; i < 4; i++) {
+        CTIndex mask = ((CTIndex)1 << (6 * i)) - 1;
+        if ((first & ~mask) == (last & ~mask)) {
+            continue;
+        }
+        if ((first & mask) != 0) {
+            ct_patlak_compiler_split(sequences, first, first | mask);
+            ct_patlak_compiler_split(sequences, (first | mask) + 1, last);
+            return;
+        }
+        if ((last & mask) != mask) {
+            ct_patlak_compiler_split(sequences, first, (last & ~mask) - 1);
+            ct_patlak_compiler_split(sequences, last & ~mask, last);
+            return;
+        }
+    }
+
+    ct_expect(
+        sequences->count < CT_PATLAK_COMPILER_SEQUENCES,
+        "Too many byte sequences!");
+    int index = sequences->count++;
+    ct_utf8_encode(first, sequences->firsts[index]);
+    sequences->sizes[index] = ct_utf8_encode(last, sequences->lasts[index]);
+}
+
+/* Compile the code point range as the alternatives of the byte sequences of
+ * its encodings. Encodings of different code points never start the same;
+ * so, at most one of the alternatives matches and their order does not
+ * matter. */
+void ct_patlak_compiler_code_points(
+    CTPatlakCompiler* compiler,
+    CTIndex           first,
+    CTIndex           last)
+{
+    CTPatlakCompilerSequences sequences = {0};
+    ct_patlak_compiler_split(&sequences, first, last);
+    ct_expect(sequences.count > 0, "Range only has surrogates!");
+
+    CTIndex arms = 0;
+    if (sequences.count > 1) {
+        ct_patlak_compiler_emit(
+            compiler,
+            (CTPatlakCode){
+                .type     = CT_PATLAK_CODE_BRANCH,
+                .branches = sequences.count});
+        arms = ct_patlak_compiler_here(compiler);
+        for (int i = 0; i < sequences.count; i++) {
+            ct_patlak_compiler_emit(
+                compiler,
+                (CTPatlakCode){.type = CT_PATLAK_CODE_EMPTY});
+        }
+    }
+
+    // Each sequence skips to the end, other than the last one.
+    CTIndex skips[CT_PATLAK_COMPILER_SEQUENCES];
+    for (int i = 0; i < sequences.count; i++) {
+        if (sequences.count > 1) {
+            ct_patlak_compiler_patch(
+                compiler,
+                arms + i,
+                ct_patlak_compiler_here(compiler));
+        }
+        for (int j = 0; j < sequences.sizes[i]; j++) {
+            ct_patlak_compiler_bytes(
+                compiler,
+                sequences.firsts[i][j],
+                sequences.lasts[i][j]);
+        }
+        if (i + 1 < sequences.count) {
+            skips[i] = ct_patlak_compiler_emit(
+                compiler,
+                (CTPatlakCode){.type = CT_PATLAK_CODE_EMPTY});
+        }
+    }
+    for (int i = 0; i + 1 < sequences.count; i++) {
+        ct_patlak_compiler_patch(
+            compiler,
+            skips[i],
+            ct_patlak_compiler_here(compiler));
+    }
+}
+
+/* Characters of a string literal that are not compiled yet. */
+typedef struct {
+    /* Bytes, with space for an encoding after a string code worth of them. */
+    unsigned char bytes[CT_PATLAK_CODE_CHARACTERS + 4];
+    /* Amount of bytes. */
+    int size;
+} CTPatlakCompilerRun;
+
+/* Compile the amount of bytes from the start of the run and remove them. A
+ * single byte is a literal, and more are a string code. */
+void ct_patlak_compiler_flush(
+    CTPatlakCompiler*    compiler,
+    CTPatlakCompilerRun* run,
+    int                  amount)
+{
+    if (amount == 1) {
+        ct_patlak_compiler_bytes(compiler, run->bytes[0], run->bytes[0]);
+    } else if (amount > 1) {
+        CTString string = {
+            .first = (char const*)run->bytes,
+            .last  = (char const*)run->bytes + amount};
+        CTPatlakCode code = {
+            .movement = 1,
+            .type     = CT_PATLAK_CODE_STRING,
+            .string   = ct_patlak_codes_add_string(compiler->codes, &string),
+            .length   = amount};
+        ct_patlak_compiler_emit(compiler, code);
+    }
+    run->size -= amount;
+    memmove(run->bytes, run->bytes + amount, run->size);
+}
+
+/* Add the character to the run, which is each byte of the encoding if it is a
+ * code point. Compiles a string code once the run fills it. */
+void ct_patlak_compiler_literal(
+    CTPatlakCompiler*    compiler,
+    CTPatlakCompilerRun* run,
+    CTIndex              character,
+    bool                 unicode)
+{
+    unsigned char* bytes = run->bytes + run->size;
+    bytes[0]             = (unsigned char)character;
+    run->size += unicode ? ct_utf8_encode(character, bytes) : 1;
+    if (run->size >= CT_PATLAK_CODE_CHARACTERS) {
+        ct_patlak_compiler_flush(compiler, run, CT_PATLAK_CODE_CHARACTERS);
+    }
+}
+
+/* Compile a character, string or character range literal. A range with a
+ * code point at either end is a code point range, where the bytes at the
+ * other end are taken as code points; it is compiled to the byte ranges of
+ * the encodings, so the input is never decoded while matching. */
+void ct_patlak_compiler_quote(CTPatlakCompiler* compiler)
+{
+    CTString value =
+        ct_patlak_compiler_take(compiler, CT_PATLAK_TOKEN_QUOTE)->value;
+    // Remove the quotation marks.
+    value.first++;
+    value.last--;
+
+    bool    unicode = false;
+    CTIndex first   = ct_patlak_compiler_code_point(&value, &unicode);
+    if (ct_string_finite(&value) && ct_string_starts(&value, '~')) {
+        value.first++;
+        bool    first_unicode = unicode;
+        CTIndex last          = ct_patlak_compiler_code_point(&value, &unicode);
+        ct_expect(!ct_string_finite(&value), "Range is too long!");
+        ct_expect(first <= last, "Range is reversed!");
+        if (unicode || first_unicode) {
+            ct_patlak_compiler_code_points(compiler, first, last);
+        } else {
+            ct_patlak_compiler_bytes(
+                compiler,
+                (unsigned char)first,
+                (unsigned char)last);
+        }
+        return;
+    }
+
+    // A string is matched a string code at a time, so its characters are
+    // checked together in a single step.
+    CTPatlakCompilerRun run = {0};
+    ct_patlak_compiler_literal(compiler, &run, first, unicode);
+    while (ct_string_finite(&value)) {
+        unicode           = false;
+        CTIndex character = ct_patlak_compiler_code_point(&value, &unicode);
+        ct_patlak_compiler_literal(compiler, &run, character, unicode);
+    }
+    ct_patlak_compiler_flush(compiler, &run, run.size);
+}
+
+/* Compile a wildcard literal. */
+void ct_patlak_compiler_wildcard(CTPatlakCompiler* compiler)
+{
+    ct_patlak_compiler_take(compiler, CT_PATLAK_TOKEN_DOT);
+    ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){
+            .movement = 1,
+            .type     = CT_PATLAK_CODE_RANGE,
+            .first    = '\x00',
+            .last     = '\xFF'});
+}
+
+/* Compile a reference literal. */
+void ct_patlak_compiler_reference(CTPatlakCompiler* compiler)
+{
+    CTString name =
+        ct_patlak_compiler_take(compiler, CT_PATLAK_TOKEN_IDENTIFIER)->value;
+    ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){
+            .movement = 1,
+            .type     = CT_PATLAK_CODE_REFERANCE,
+            .reffered = *ct_patlak_patterns_get(compiler->patterns, &name)});
+}
+
+/* Whether the next token is a name that is followed by a colon, which starts
+ * a capture. Colons are unknown tokens. */
+bool ct_patlak_compiler_peek_capture(CTPatlakCompiler const* compiler)
+{
+    CTPatlakToken const* colon = compiler->current + 1;
+    return ct_patlak_compiler_peek(compiler, CT_PATLAK_TOKEN_IDENTIFIER) &&
+           colon < compiler->last && colon->type != CT_PATLAK_TOKEN_QUOTE &&
+           ct_string_size(&colon->value) == 1 && *colon->value.first == ':';
+}
+
+// Prototype for call before definition.
+void ct_patlak_compiler_unit(CTPatlakCompiler* compiler);
+
+/* Compile a capture, which is the name, the colon and the captured unit. The
+ * borders of the unit are recorded to the tags of the capture. Captures with
+ * the same name are the same capture. */
+void ct_patlak_compiler_capture(CTPatlakCompiler* compiler)
+{
+    CTString name =
+        ct_patlak_compiler_take(compiler, CT_PATLAK_TOKEN_IDENTIFIER)->value;
+    compiler->current++;
+
+    int capture = 0;
+    while (capture < compiler->capture_count &&
+           !ct_string_equal(compiler->captures + capture, &name)) {
+        capture++;
+    }
+    if (capture == compiler->capture_count) {
+        ct_expect(
+            compiler->capture_count < CT_PATLAK_PATTERN_CAPTURES,
+            "Too many captures!");
+        compiler->captures[compiler->capture_count++] = name;
+    }
+
+    ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){
+            .movement = 1,
+            .type     = CT_PATLAK_CODE_TAG,
+            .tag      = 2 * capture});
+    ct_patlak_compiler_unit(compiler);
+    ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){
+            .movement = 1,
+            .type     = CT_PATLAK_CODE_TAG,
+            .tag      = 2 * capture + 1});
+}
+
+/* Consume a number token and convert it. */
+int ct_patlak_compiler_number(CTPatlakCompiler* compiler)
+{
+    CTString value =
+        ct_patlak_compiler_take(compiler, CT_PATLAK_TOKEN_NUMBER)->value;
+    int number = 0;
+    for (char const* i = value.first; i < value.last; i++) {
+        ct_expect(number <= (INT_MAX - 9) / 10, "Number is too big!");
+        number = number * 10 + *i - '0';
+    }
+    return number;
+}
+
+/* Compile the next unit as optional. */
+void ct_patlak_compiler_optional(CTPatlakCompiler* compiler)
+{
+    ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){.type = CT_PATLAK_CODE_BRANCH, .branches = 2});
+    ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){.movement = 2, .type = CT_PATLAK_CODE_EMPTY});
+    CTIndex skip = ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){.type = CT_PATLAK_CODE_EMPTY});
+    ct_patlak_compiler_unit(compiler);
+    ct_patlak_compiler_patch(compiler, skip, ct_patlak_compiler_here(compiler));
+}
+
+/* Compile the next unit as repeated zero or more times. */
+void ct_patlak_compiler_zero_or_more(CTPatlakCompiler* compiler)
+{
+    CTIndex branch = ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){.type = CT_PATLAK_CODE_BRANCH, .branches = 2});
+    ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){.movement = 2, .type = CT_PATLAK_CODE_EMPTY});
+    CTIndex skip = ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){.type = CT_PATLAK_CODE_EMPTY});
+    ct_patlak_compiler_unit(compiler);
+    CTIndex loop = ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){.type = CT_PATLAK_CODE_EMPTY});
+    ct_patlak_compiler_patch(compiler, loop, branch);
+    ct_patlak_compiler_patch(compiler, skip, ct_patlak_compiler_here(compiler));
+}
+
+/* Compile the next unit as repeated one or more times. */
+void ct_patlak_compiler_one_or_more(CTPatlakCompiler* compiler)
+{
+    CTIndex start = ct_patlak_compiler_here(compiler);
+    ct_patlak_compiler_unit(compiler);
+    ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){.type = CT_PATLAK_CODE_BRANCH, .branches = 2});
+    CTIndex loop = ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){.type = CT_PATLAK_CODE_EMPTY});
+    ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){.movement = 1, .type = CT_PATLAK_CODE_EMPTY});
+    ct_patlak_compiler_patch(compiler, loop, start);
+}
+
+/* Compile the next unit as repeated using a counter. The size of the code does
+ * not depend on the bounds. */
+void ct_patlak_compiler_counted(
+    CTPatlakCompiler* compiler,
+    int               minimum,
+    int               maximum)
+{
+    ct_expect(
+        compiler->counters < CT_PATLAK_STATE_COUNTERS,
+        "Too many nested counted repeats!");
+    int counter = compiler->counters++;
+
+    ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){
+            .movement = 1,
+            .type     = CT_PATLAK_CODE_COUNT,
+            .counter  = counter});
+    CTIndex repeat = ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){
+            .type    = CT_PATLAK_CODE_REPEAT,
+            .counter = counter,
+            .minimum = minimum,
+            .maximum = maximum});
+    ct_patlak_compiler_unit(compiler);
+    CTIndex loop = ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){.type = CT_PATLAK_CODE_EMPTY});
+    ct_patlak_compiler_patch(compiler, loop, repeat);
+    ct_patlak_compiler_patch(
+        compiler,
+        repeat,
+        ct_patlak_compiler_here(compiler));
+
+    compiler->counters--;
+}
+
+/* Compile the next unit as repeated between the bounds. Negative maximum means
+ * there is no upper bound. */
+void ct_patlak_compiler_repeat(
+    CTPatlakCompiler* compiler,
+    int               minimum,
+    int               maximum)
+{
+    ct_expect(
+        maximum < 0 || (maximum > 0 && maximum >= minimum),
+        "Upper bound is smaller than the lower bound!");
+
+    // Use the forms that do not need a counter when possible.
+    if (minimum == 1 && maximum == 1) {
+        ct_patlak_compiler_unit(compiler);
+    } else if (minimum == 0 && maximum == 1) {
+        ct_patlak_compiler_optional(compiler);
+    } else if (minimum == 0 && maximum < 0) {
+        ct_patlak_compiler_zero_or_more(compiler);
+    } else if (minimum == 1 && maximum < 0) {
+        ct_patlak_compiler_one_or_more(compiler);
+    } else {
+        ct_patlak_compiler_counted(compiler, minimum, maximum);
+    }
+}
+
+/* Compile the repeat inside the square brackets and the unit after it. */
+void ct_patlak_compiler_bracket(CTPatlakCompiler* compiler)
+{
+    ct_patlak_compiler_take(compiler, CT_PATLAK_TOKEN_OPENING_SQUARE_BRACKET);
+    int minimum = 0;
+    int maximum = 0;
+
+    if (ct_patlak_compiler_peek(compiler, CT_PATLAK_TOKEN_QUESTION_MARK)) {
+        compiler->current++;
+        maximum = 1;
+    } else if (ct_patlak_compiler_peek(compiler, CT_PATLAK_TOKEN_STAR)) {
+        compiler->current++;
+        maximum = -1;
+    } else if (ct_patlak_compiler_peek(compiler, CT_PATLAK_TOKEN_PLUS)) {
+        compiler->current++;
+        minimum = 1;
+        maximum = -1;
+    } else {
+        if (ct_patlak_compiler_peek(compiler, CT_PATLAK_TOKEN_NUMBER)) {
+            minimum = ct_patlak_compiler_number(compiler);
+            maximum = minimum;
+        }
+        if (ct_patlak_compiler_peek(compiler, CT_PATLAK_TOKEN_COMMA)) {
+            compiler->current++;
+            maximum = -1;
+            if (ct_patlak_compiler_peek(compiler, CT_PATLAK_TOKEN_NUMBER)) {
+                maximum = ct_patlak_compiler_number(compiler);
+            }
+        } else {
+            // Only the bounds of the ranges can be zero.
+            ct_expect(minimum > 0, "Fixed repeat is not positive!");
+        }
+    }
+
+    ct_patlak_compiler_take(compiler, CT_PATLAK_TOKEN_CLOSING_SQUARE_BRACKET);
+    ct_patlak_compiler_repeat(compiler, minimum, maximum);
+}
+
+/* Put the characters the code moves with to the set. Returns false if the
+ * code is not a single character that moves to the next code. */
+bool ct_patlak_compiler_characters(
+    CTPatlakCompiler*   compiler,
+    CTPatlakSet*        set,
+    CTPatlakCode const* code)
+{
+    if (code->movement != 1) {
+        return false;
+    }
+    switch (code->type) {
+        case CT_PATLAK_CODE_LITERAL:
+            ct_patlak_set_add(set, code->literal);
+            return true;
+        case CT_PATLAK_CODE_RANGE:
+            ct_patlak_set_add_range(set, code->first, code->last);
+            return true;
+        case CT_PATLAK_CODE_SET:
+            ct_patlak_set_join(set, ct_patlak_codes_set(compiler->codes, code));
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Fold the alternation that starts at the index to a set if both of its sides
+ * are a single character, so decoding tests the character once instead of
+ * diverging to a state for each side. The alternation was just compiled and
+ * nothing points into it; so, its codes are replaced. Chains of alternations
+ * fold from the left, one side at a time. */
+void ct_patlak_compiler_fold(CTPatlakCompiler* compiler, CTIndex start)
+{
+    // Branch, two empty moves, left hand side, skip and right hand side.
+    if (ct_patlak_compiler_here(compiler) - start != 6) {
+        return;
+    }
+    CTPatlakSet         set  = {0};
+    CTPatlakCode const* left = ct_patlak_codes_get(compiler->codes, start + 3);
+    if (!ct_patlak_compiler_characters(compiler, &set, left) ||
+        !ct_patlak_compiler_characters(
+            compiler,
+            &set,
+            ct_patlak_codes_get(compiler->codes, start + 5))) {
+        return;
+    }
+
+    // Only the left hand side points to its set; so, a folded chain keeps
+    // growing the same set.
+    CTIndex index = 0;
+    if (left->type == CT_PATLAK_CODE_SET) {
+        index                         = left->set;
+        compiler->codes->sets[index] = set;
+    } else {
+        index = ct_patlak_codes_add_set(compiler->codes, &set);
+    }
+    compiler->codes->last = compiler->codes->first + start;
+    ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){
+            .movement = 1,
+            .type     = CT_PATLAK_CODE_SET,
+            .set      = index});
+}
+
+/* Compile the units until the end of the tokens or a closing curly bracket. */
+void ct_patlak_compiler_units(CTPatlakCompiler* compiler)
+{
+    CTIndex start = ct_patlak_compiler_here(compiler);
+    ct_patlak_compiler_unit(compiler);
+
+    // Units are taken from left to right; thus, the left hand side of an or is
+    // all the units that came before it.
+    while (ct_patlak_compiler_finite(compiler) &&
+           !ct_patlak_compiler_peek(
+               compiler,
+               CT_PATLAK_TOKEN_CLOSING_CURLY_BRACKET)) {
+        if (!ct_patlak_compiler_peek(compiler, CT_PATLAK_TOKEN_PIPE)) {
+            ct_patlak_compiler_unit(compiler);
+            continue;
+        }
+        compiler->current++;
+
+        // Put a branch before the left hand side. Movements are relative and
+        // the codes before only point to the start; so, nothing breaks.
+        CTIndex end = ct_patlak_compiler_here(compiler);
+        ct_patlak_codes_open(compiler->codes, start, 3);
+        end += 3;
+        *ct_patlak_codes_get(compiler->codes, start) =
+            (CTPatlakCode){.type = CT_PATLAK_CODE_BRANCH, .branches = 2};
+        *ct_patlak_codes_get(compiler->codes, start + 1) =
+            (CTPatlakCode){.movement = 2, .type = CT_PATLAK_CODE_EMPTY};
+        *ct_patlak_codes_get(compiler->codes, start + 2) =
+            (CTPatlakCode){.movement = end + 1 - start - 2,
+                           .type     = CT_PATLAK_CODE_EMPTY};
+
+        // Skip the right hand side after the left hand side matches.
+        CTIndex skip = ct_patlak_compiler_emit(
+            compiler,
+            (CTPatlakCode){.type = CT_PATLAK_CODE_EMPTY});
+        ct_patlak_compiler_unit(compiler);
+        ct_patlak_compiler_patch(
+            compiler,
+            skip,
+            ct_patlak_compiler_here(compiler));
+        ct_patlak_compiler_fold(compiler, start);
+    }
+}
+
+/* Compile the next unit. */
+void ct_patlak_compiler_unit(CTPatlakCompiler* compiler)
+{
+    ct_expect(ct_patlak_compiler_finite(compiler), "Expected a unit!");
+    switch (compiler->current->type) {
+        case CT_PATLAK_TOKEN_QUOTE:
+            ct_patlak_compiler_quote(compiler);
+            break;
+        case CT_PATLAK_TOKEN_DOT:
+            ct_patlak_compiler_wildcard(compiler);
+            break;
+        case CT_PATLAK_TOKEN_IDENTIFIER:
+            if (ct_patlak_compiler_peek_capture(compiler)) {
+                ct_patlak_compiler_capture(compiler);
+            } else {
+                ct_patlak_compiler_reference(compiler);
+            }
+            break;
+        case CT_PATLAK_TOKEN_OPENING_CURLY_BRACKET:
+            compiler->current++;
+            ct_patlak_compiler_units(compiler);
+            ct_patlak_compiler_take(
+                compiler,
+                CT_PATLAK_TOKEN_CLOSING_CURLY_BRACKET);
+            break;
+        case CT_PATLAK_TOKEN_OPENING_SQUARE_BRACKET:
+            ct_patlak_compiler_bracket(compiler);
+            break;
+        case CT_PATLAK_TOKEN_NUMBER: {
+            int times = ct_patlak_compiler_number(compiler);
+            ct_expect(times > 0, "Fixed repeat is not positive!");
+            ct_patlak_compiler_repeat(compiler, times, times);
+        } break;
+        case CT_PATLAK_TOKEN_QUESTION_MARK:
+            compiler->current++;
+            ct_patlak_compiler_repeat(compiler, 0, 1);
+            break;
+        case CT_PATLAK_TOKEN_STAR:
+            compiler->current++;
+            ct_patlak_compiler_repeat(compiler, 0, -1);
+            break;
+        case CT_PATLAK_TOKEN_PLUS:
+            compiler->current++;
+            ct_patlak_compiler_repeat(compiler, 1, -1);
+            break;
+        default:
+            ct_expect(false, "Unexpected token!");
+    }
+}
+
+/* Compile the units of the definition after the name and the equal sign. */
+void ct_patlak_compiler_definition(CTPatlakCompiler* compiler)
+{
+    ct_patlak_compiler_units(compiler);
+    ct_expect(!ct_patlak_compiler_finite(compiler), "Unexpected token!");
+    ct_patlak_compiler_emit(
+        compiler,
+        (CTPatlakCode){.type = CT_PATLAK_CODE_TERMINAL});
+}
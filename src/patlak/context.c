@@ -3,10 +3,18 @@
 
 #pragma once
 
+#include "patlak/analysis.c"
+#include "patlak/automaton.c"
 #include "patlak/code.c"
+#include "patlak/compiler.c"
 #include "patlak/decode.c"
+#include "patlak/inliner.c"
+#include "patlak/jit.c"
+#include "patlak/lexer.c"
+#include "patlak/matcher.c"
 #include "patlak/pattern.c"
 #include "patlak/state.c"
+#include "patlak/token.c"
 #include "prelude/scalar.c"
 #include "prelude/string.c"
 
@@ -18,20 +26,344 @@ typedef struct {
     CTPatlakPatterns patterns;
 } CTPatlakContext;
 
-/* Compile the pattern by searching for references in the context. */
-void ct_patlak_compile(CTPatlakContext* context, CTString const* pattern) {}
+/* Compile the pattern by searching for references in the context. The pattern
+ * is a definition, which gives the name and the units. The pattern string
+ * should live as long as the context, which keeps a view to the name. */
+void ct_patlak_compile(CTPatlakContext* context, CTString const* pattern)
+{
+    CTPatlakTokens tokens = {0};
+    ct_patlak_lexer(&tokens, *pattern);
+
+    CTPatlakCompiler compiler = {
+        .current  = tokens.first,
+        .last     = tokens.last,
+        .codes    = &context->codes,
+        .patterns = &context->patterns};
+    CTString name =
+        ct_patlak_compiler_take(&compiler, CT_PATLAK_TOKEN_IDENTIFIER)->value;
+    ct_patlak_compiler_take(&compiler, CT_PATLAK_TOKEN_EQUAL);
 
-/* Match the pattern with the name to the input. Returns the initial portion of
- * the input that matched. Matches are checked from the begining. Empty match
- * means it did not match or the pattern was not found. */
+    // Add the pattern before compiling, so it can reference itself.
+    ct_patlak_patterns_add(
+        &context->patterns,
+        &name,
+        ct_patlak_codes_size(&context->codes));
+    ct_patlak_compiler_definition(&compiler);
+    CTPatlakPattern* information =
+        ct_patlak_patterns_information(&context->patterns, &name);
+    for (int i = 0; i < compiler.capture_count; i++) {
+        information->captures[i] = compiler.captures[i];
+    }
+    information->capture_count = compiler.capture_count;
+    ct_patlak_analyze(&context->codes, &context->patterns, information);
+
+    ct_patlak_tokens_free(&tokens);
+}
+
+/* Optimize the compiled patterns. Should be called after compiling all the
+ * patterns, because it moves their code. Patterns that do not have references
+ * are compiled to machine code once they are matched enough times, as their
+ * code does not move after this. */
+void ct_patlak_optimize(CTPatlakContext* context)
+{
+    ct_patlak_inline(&context->codes, &context->patterns);
+    for (CTPatlakPattern* i = context->patterns.information.first;
+         i < context->patterns.information.last;
+         i++) {
+        ct_patlak_jit_free(&i->jit);
+        atomic_store(&i->jit.remaining, CT_PATLAK_JIT_THRESHOLD);
+    }
+}
+
+/* Order of the patterns by their starts. */
+int ct_patlak_context_compare(void const* lhs, void const* rhs)
+{
+    CTIndex lhs_start = (*(CTPatlakPattern const* const*)lhs)->start;
+    CTIndex rhs_start = (*(CTPatlakPattern const* const*)rhs)->start;
+    return (lhs_start > rhs_start) - (lhs_start < rhs_start);
+}
+
+/* Most amount of references in the references that start from the pattern at
+ * the index of the sorted patterns, whose code is until the start of the next
+ * one. A reference back to a pattern that is being followed counts once.
+ * Depths are kept in the depths, where negative means not found yet. */
+CTIndex ct_patlak_context_depth(
+    CTPatlakContext const*        context,
+    CTPatlakPattern const* const* sorted,
+    CTIndex                       count,
+    CTIndex*                      depths,
+    CTIndex                       index)
+{
+    if (depths[index] >= 0) {
+        return depths[index];
+    }
+    depths[index] = 1;
+    CTIndex first = sorted[index]->start;
+    CTIndex last  = index + 1 < count ? sorted[index + 1]->start
+                                      : ct_patlak_codes_size(&context->codes);
+    CTIndex depth = 0;
+    for (CTIndex i = first; i < last; i++) {
+        CTPatlakCode const* code = ct_patlak_codes_get(&context->codes, i);
+        if (code->type != CT_PATLAK_CODE_REFERANCE) {
+            continue;
+        }
+        for (CTIndex j = 0; j < count; j++) {
+            if (sorted[j]->start != code->reffered) {
+                continue;
+            }
+            CTIndex reffered =
+                1 + ct_patlak_context_depth(context, sorted, count, depths, j);
+            if (depth < reffered) {
+                depth = reffered;
+            }
+        }
+    }
+    depths[index] = depth;
+    return depth;
+}
+
+/* Matcher for the patterns of the context. Each thread that matches with the
+ * same context should have its own. Reserves all the memory matching needs up
+ * front, including the matchers of the references, except for the patterns
+ * that refer back to themselves and the ones whose counters tell apart too
+ * many states. */
+CTPatlakMatcher ct_patlak_context_matcher(CTPatlakContext const* context)
+{
+    CTIndex count = ct_patlak_patterns_information_size(&context->patterns);
+    CTPatlakPattern const** sorted =
+        calloc(count > 0 ? count : 1, sizeof(CTPatlakPattern const*));
+    CTIndex* depths = calloc(count > 0 ? count : 1, sizeof(CTIndex));
+    ct_expect(sorted != NULL && depths != NULL, "Could not allocate!");
+    for (CTIndex i = 0; i < count; i++) {
+        sorted[i] = context->patterns.information.first + i;
+        depths[i] = -1;
+    }
+    qsort(sorted, count, sizeof(*sorted), &ct_patlak_context_compare);
+
+    CTIndex depth = 0;
+    for (CTIndex i = 0; i < count; i++) {
+        CTIndex found =
+            ct_patlak_context_depth(context, sorted, count, depths, i);
+        if (depth < found) {
+            depth = found;
+        }
+    }
+    free(sorted);
+    free(depths);
+    return ct_patlak_matcher(&context->codes, depth);
+}
+
+/* Match the pattern to the input using the memory of the matcher. Skips
+ * decoding when the analysis of the pattern shows the input cannot match, and
+ * runs the machine code instead if the pattern is compiled. Counts the match
+ * towards compiling the pattern otherwise. */
+CTString ct_patlak_match_pattern(
+    CTPatlakContext const* context,
+    CTPatlakMatcher*       matcher,
+    CTPatlakPattern const* pattern,
+    CTString const*        input)
+{
+    if (!ct_patlak_analysis_admits(&pattern->analysis, input)) {
+        return (CTString){0};
+    }
+    CTPatlakJitted function =
+        atomic_load_explicit(&pattern->jit.function, memory_order_acquire);
+    if (function != NULL) {
+        char const* last = function(input->first, input->last);
+        return last == NULL ? (CTString){0}
+                            : (CTString){.first = input->first, .last = last};
+    }
+    ct_patlak_jit_count(&pattern->jit, &context->codes, pattern->start);
+    CTPatlakState initial = {.input = *input, .code = pattern->start};
+    return ct_patlak_decode_match(matcher, &context->codes, initial);
+}
+
+/* Match the pattern with the name to the input using the memory of the
+ * matcher. Returns the initial portion of the input that matched. Matches are
+ * checked from the begining. Empty match means it did not match or the
+ * pattern was not found. Does not allocate with a matcher of the context;
+ * so, the context can be shared by threads that have their own matchers. */
 CTString ct_patlak_match(
     CTPatlakContext const* context,
+    CTPatlakMatcher*       matcher,
     CTString const*        name,
     CTString const*        input)
 {
-    CTIndex*      start   = ct_patlak_patterns_get(&context->patterns, name);
-    CTPatlakState initial = {.input = *input, .code = *start, .dead = false};
-    return ct_patlak_decode_test(&context->codes, initial);
+    CTPatlakPattern const* pattern =
+        ct_patlak_patterns_information(&context->patterns, name);
+    return ct_patlak_match_pattern(context, matcher, pattern, input);
+}
+
+/* Match the pattern with the name to the input using the memory of the
+ * matcher, and put what each capture of the pattern matched to the captures
+ * at the index of the capture. Captures that did not take part in the match
+ * are empty. Always decodes, because the machine code does not record the
+ * tags. */
+CTString ct_patlak_match_captures(
+    CTPatlakContext const* context,
+    CTPatlakMatcher*       matcher,
+    CTString const*        name,
+    CTString const*        input,
+    CTString*              captures)
+{
+    CTPatlakPattern const* pattern =
+        ct_patlak_patterns_information(&context->patterns, name);
+    for (int i = 0; i < pattern->capture_count; i++) {
+        captures[i] = (CTString){0};
+    }
+    if (!ct_patlak_analysis_admits(&pattern->analysis, input)) {
+        return (CTString){0};
+    }
+
+    CTPatlakState initial = {.input = *input, .code = pattern->start};
+    CTString match = ct_patlak_decode_match(matcher, &context->codes, initial);
+    if (!ct_string_finite(&match)) {
+        return match;
+    }
+
+    // A capture in a repeat keeps the borders of its last repeat.
+    char const* const* tags = ct_patlak_tags_get(&matcher->tags, matcher->matched);
+    for (int i = 0; tags != NULL && i < pattern->capture_count; i++) {
+        char const* first = tags[2 * i];
+        char const* last  = tags[2 * i + 1];
+        if (first != NULL && last != NULL) {
+            captures[i] = (CTString){.first = first, .last = last};
+        }
+    }
+    return match;
+}
+
+/* Match the first pattern in the order that matches to the input. Returns the
+ * initial portion of the input that matched, and sets the index of the pattern
+ * in the order. Empty match means none of them matched, and the index is not
+ * set then. This is the tokenizer step of an ordered token set. */
+CTString ct_patlak_match_first(
+    CTPatlakContext const* context,
+    CTPatlakMatcher*       matcher,
+    CTString const*        names,
+    CTIndex                order,
+    CTString const*        input,
+    CTIndex*               matched)
+{
+    for (CTIndex i = 0; i < order; i++) {
+        CTString match = ct_patlak_match(context, matcher, names + i, input);
+        if (ct_string_finite(&match)) {
+            *matched = i;
+            return match;
+        }
+    }
+    return (CTString){0};
+}
+
+/* Build the automaton of the patterns with the names, which are in the order
+ * of their priority. Should be called after optimizing, because the references
+ * that are not inlined cannot be built. Returns false if the automaton could
+ * not be built, and the patterns should be matched one by one then. */
+bool ct_patlak_automate(
+    CTPatlakContext const* context,
+    CTString const*        names,
+    CTIndex                order,
+    CTPatlakAutomaton*     automaton)
+{
+    CTIndex* starts = calloc(order > 0 ? order : 1, sizeof(CTIndex));
+    ct_expect(starts != NULL, "Could not allocate!");
+    for (CTIndex i = 0; i < order; i++) {
+        starts[i] =
+            ct_patlak_patterns_information(&context->patterns, names + i)->start;
+    }
+    bool built = ct_patlak_automaton(automaton, &context->codes, starts, order);
+    free(starts);
+    return built;
+}
+
+/* Most amount of matches that are decoded together by a batch. */
+#define CT_PATLAK_BATCH_LANES 16
+
+/* Start decoding the next input that the pattern might match in the lane
+ * using the matcher. Results of the inputs that are skipped are set to empty.
+ * Returns the index of the input, or negative if there are no inputs left. */
+CTIndex ct_patlak_batch_load(
+    CTPatlakPattern const* pattern,
+    CTPatlakMatcher*       matcher,
+    CTString const*        inputs,
+    CTString*              results,
+    CTIndex                amount,
+    CTIndex*               loaded)
+{
+    for (; *loaded < amount; (*loaded)++) {
+        CTIndex index = *loaded;
+        if (!ct_patlak_analysis_admits(&pattern->analysis, inputs + index)) {
+            results[index] = (CTString){0};
+            continue;
+        }
+        CTPatlakState initial = {
+            .input = inputs[index],
+            .code  = pattern->start};
+        ct_patlak_decode_start(matcher, initial);
+        (*loaded)++;
+        return index;
+    }
+    return -1;
+}
+
+/* Match the pattern with the name to each of the inputs, and put the matches
+ * to the results at the same index. Finds the pattern once, and steps as many
+ * matches as there are matchers in turn, so waiting for the memory of one
+ * match overlaps with the work of the others. */
+void ct_patlak_match_batch(
+    CTPatlakContext const* context,
+    CTPatlakMatcher*       matchers,
+    CTIndex                lanes,
+    CTString const*        name,
+    CTString const*        inputs,
+    CTString*              results,
+    CTIndex                amount)
+{
+    ct_expect(
+        lanes > 0 && lanes <= CT_PATLAK_BATCH_LANES,
+        "Lane amount out of bounds!");
+    CTPatlakPattern const* pattern =
+        ct_patlak_patterns_information(&context->patterns, name);
+
+    CTIndex working[CT_PATLAK_BATCH_LANES];
+    CTIndex loaded = 0;
+    CTIndex busy   = 0;
+    for (CTIndex lane = 0; lane < lanes; lane++) {
+        working[lane] = ct_patlak_batch_load(
+            pattern,
+            matchers + lane,
+            inputs,
+            results,
+            amount,
+            &loaded);
+        busy += working[lane] >= 0;
+    }
+
+    while (busy > 0) {
+        for (CTIndex lane = 0; lane < lanes; lane++) {
+            CTIndex  index = working[lane];
+            CTString match = {0};
+            if (index < 0 ||
+                !ct_patlak_decode_step(
+                    matchers + lane,
+                    &context->codes,
+                    inputs[index].first,
+                    &match)) {
+                continue;
+            }
+
+            // Give the lane the next input when it finishes.
+            results[index] = match;
+            working[lane]  = ct_patlak_batch_load(
+                pattern,
+                matchers + lane,
+                inputs,
+                results,
+                amount,
+                &loaded);
+            busy -= working[lane] < 0;
+        }
+    }
 }
 
 /* Deallocate the memory. */
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "patlak/code.c"
+#include "patlak/matcher.c"
 #include "patlak/state.c"
 #include "prelude/expect.c"
 #include "prelude/scalar.c"
@@ -12,116 +13,287 @@
 #include <stdbool.h>
 
 // Prototype for call before definition.
-CTString
-ct_patlak_decode_test(CTPatlakCodes const* codes, CTPatlakState initial);
+CTString ct_patlak_decode_match(
+    CTPatlakMatcher*     matcher,
+    CTPatlakCodes const* codes,
+    CTPatlakState        initial);
+
+/* Add the state after the code to the states. */
+void ct_patlak_decode_move(
+    CTPatlakCodes const* codes,
+    CTPatlakStates*      states,
+    CTPatlakCode const*  code,
+    CTPatlakState        state)
+{
+    state.code += code->movement;
+    ct_expect(
+        ct_patlak_codes_valid(codes, state.code),
+        "Movement out of bounds!");
+    ct_patlak_states_add(states, state);
+}
 
-/* Decode the state using the codes and add the states come after it to
- * the next states. */
+/* Decode the state using the codes. States that come after it at the same
+ * position are pushed to the stack of the matcher, the ones that consumed a
+ * character are added to the next states, and the ones that matched a string
+ * or a reference are added to the pending states. Returns whether the state
+ * matched. References are decoded with the deeper matcher. */
 bool ct_patlak_decode(
+    CTPatlakMatcher*     matcher,
     CTPatlakCodes const* codes,
-    CTPatlakStates*      next,
     CTPatlakState        state)
 {
-    ct_expect(!state.dead, "Decoding a dead state!");
-    CTPatlakCode const* code = ct_patlak_codes_get(codes, state.code);
+    CTPatlakCode const* code  = ct_patlak_codes_get(codes, state.code);
+    CTPatlakStates*     stack = &matcher->stack;
 
     switch (code->type) {
         case CT_PATLAK_CODE_EMPTY:
             break;
         case CT_PATLAK_CODE_LITERAL:
             // Check the next input and consume it.
-            state.dead = !ct_string_finite(&state.input) ||
-                       *state.input.first++ != code->literal;
-            break;
-        case CT_PATLAK_CODE_RANGE:
+            if (ct_string_finite(&state.input) &&
+                *state.input.first == code->literal) {
+                state.input.first++;
+                ct_patlak_decode_move(codes, &matcher->next, code, state);
+            }
+            return false;
+        case CT_PATLAK_CODE_RANGE: {
+            // Check the next input and consume it. Compare as unsigned to
+            // let the range cover the characters after '\7F'.
+            if (!ct_string_finite(&state.input)) {
+                return false;
+            }
+            unsigned char character = *state.input.first++;
+            if (character >= (unsigned char)code->first &&
+                character <= (unsigned char)code->last) {
+                ct_patlak_decode_move(codes, &matcher->next, code, state);
+            }
+            return false;
+        }
+        case CT_PATLAK_CODE_SET:
             // Check the next input and consume it.
-            state.dead = !ct_string_finite(&state.input) ||
-                       *state.input.first++ < code->first ||
-                       *state.input.first > code->last;
-            break;
+            if (ct_string_finite(&state.input) &&
+                ct_patlak_set_has(
+                    ct_patlak_codes_set(codes, code),
+                    *state.input.first)) {
+                state.input.first++;
+                ct_patlak_decode_move(codes, &matcher->next, code, state);
+            }
+            return false;
+        case CT_PATLAK_CODE_STRING:
+            // Check the next inputs and consume all of them in one step. The
+            // state waits in the pending states until the other states reach
+            // the position after the string, so the matches are still found
+            // from the shortest.
+            if (ct_patlak_codes_starts(codes, code, &state.input)) {
+                state.input.first += code->length;
+                ct_patlak_decode_move(codes, &matcher->pending, code, state);
+            }
+            return false;
         case CT_PATLAK_CODE_REFERANCE: {
             // Check the reffered pattern.
-            CTPatlakState ref = {
-                .input = state.input,
-                .code  = code->reffered,
-                .dead  = false};
-            CTString match = ct_patlak_decode_test(codes, ref);
-            // Consume the input.
-            state.input.first = match.last;
-            state.dead        = !ct_string_finite(&match);
-        } break;
+            CTPatlakState ref = {.input = state.input, .code = code->reffered};
+            CTString match = ct_patlak_decode_match(
+                ct_patlak_matcher_deeper(matcher),
+                codes,
+                ref);
+
+            // Consume the input, which is never empty.
+            if (ct_string_finite(&match)) {
+                state.input.first = match.last;
+                ct_patlak_decode_move(codes, &matcher->pending, code, state);
+            }
+            return false;
+        }
         case CT_PATLAK_CODE_BRANCH:
             ct_expect(code->branches > 0, "Nonpositive branch amount!");
             ct_expect(
                 ct_patlak_codes_valid(codes, state.code + code->branches),
                 "Branching out of bounds!");
-            // Add all diverging states to the next states.
-            for (CTIndex j = 0; j < code->branches; j++) {
+            // Push the branches from the last, so the first one is decoded
+            // first.
+            for (CTIndex j = code->branches; j > 0; j--) {
+                CTPatlakState branch = state;
+                branch.code += j;
+                ct_patlak_states_add(stack, branch);
+            }
+            return false;
+        case CT_PATLAK_CODE_COUNT:
+            ct_expect(
+                code->counter >= 0 && code->counter < CT_PATLAK_STATE_COUNTERS,
+                "Counter out of bounds!");
+            state.counters[code->counter] = 0;
+            break;
+        case CT_PATLAK_CODE_REPEAT: {
+            ct_expect(
+                code->counter >= 0 && code->counter < CT_PATLAK_STATE_COUNTERS,
+                "Counter out of bounds!");
+            CTIndex count = state.counters[code->counter];
+
+            // Leave if the minimum is reached. Pushed first, so repeating is
+            // decoded before leaving.
+            if (count >= code->minimum) {
+                ct_patlak_decode_move(codes, stack, code, state);
+            }
+
+            // Repeat once more if the maximum is not reached. When there is
+            // no maximum, stop counting after the minimum so the states that
+            // repeated more do not look different.
+            if (code->maximum < 0 || count < code->maximum) {
+                if (code->maximum >= 0 || count < code->minimum) {
+                    state.counters[code->counter]++;
+                }
                 state.code++;
-                ct_patlak_states_add(next, state);
+                ct_patlak_states_add(stack, state);
             }
-            goto end;
+            return false;
+        }
+        case CT_PATLAK_CODE_TAG:
+            state.tags = ct_patlak_tags_record(
+                &matcher->tags,
+                state.tags,
+                code->tag,
+                state.input.first);
+            break;
         case CT_PATLAK_CODE_TERMINAL:
             return true;
         default:
             ct_expect(false, "Unkown type!");
     }
 
-    // Add the target state to the next states.
-    state.code += code->movement;
-    ct_expect(
-        ct_patlak_codes_valid(codes, state.code),
-        "Movement out of bounds!");
-    ct_patlak_states_add(next, state);
-
-end:
+    // Go on with the target state at the same position.
+    ct_patlak_decode_move(codes, stack, code, state);
     return false;
 }
 
-/* Decode until the end starting from the initial state. Returns the
- * initial portion of the input that was accepted by the
- * nondeterministic finite automaton first. Empty match means none of
- * the states were accepted before all states died. */
-CTString
-ct_patlak_decode_test(CTPatlakCodes const* codes, CTPatlakState initial)
+/* Start decoding from the initial state using the memory of the matcher. */
+void ct_patlak_decode_start(CTPatlakMatcher* matcher, CTPatlakState initial)
 {
-    CTString       match  = {0};
-    CTPatlakStates active = {0};
-    CTPatlakStates next   = {0};
-
-    // Put the initial state.
-    ct_expect(!initial.dead, "Initial state is dead!");
-    ct_patlak_states_add(&active, initial);
-
-    // Until all states die.
-    while (ct_patlak_states_finite(&active)) {
-        // Step all the active states and collect all the next states.
-        ct_patlak_states_clear(&next);
-        for (const CTPatlakState* i = active.first; i < active.last; i++) {
-            bool matched = ct_patlak_decode(codes, &next, *i);
-
-            // Return early if matched.
-            if (matched) {
-                match.first = initial.input.first;
-                match.last  = i->input.first;
-                ct_expect(
-                    ct_string_finite(&match),
-                    "Did not consume anything!");
-                goto end;
+    ct_patlak_tags_clear(&matcher->tags);
+    ct_patlak_states_clear(&matcher->active);
+    ct_patlak_states_clear(&matcher->pending);
+    ct_patlak_states_clear(&matcher->stack);
+    ct_patlak_states_add(&matcher->active, initial);
+}
+
+/* Step the matcher over the next position of the input, where all the active
+ * states are. Follows the moves that do not consume input from each active
+ * state in the order of their priority, and decodes each code and counters
+ * once, so the work of a position is bound by the size of the codes. Returns
+ * whether decoding finished, and sets the match then, which is the shortest
+ * one. The start is where the input of the initial state started. Keeps the
+ * tags of the state that matched in the matcher. */
+bool ct_patlak_decode_step(
+    CTPatlakMatcher*     matcher,
+    CTPatlakCodes const* codes,
+    char const*          start,
+    CTString*            match)
+{
+    CTPatlakStates* active  = &matcher->active;
+    CTPatlakStates* next    = &matcher->next;
+    CTPatlakStates* pending = &matcher->pending;
+    CTPatlakStates* stack   = &matcher->stack;
+
+    // Jump to the nearest pending state when there are no active ones. Then,
+    // take the pending states at the position in the order they were added.
+    char const* position = NULL;
+    if (ct_patlak_states_finite(active)) {
+        position = active->first->input.first;
+    } else {
+        position = pending->first->input.first;
+        for (CTPatlakState const* i = pending->first; i < pending->last; i++) {
+            if (i->input.first < position) {
+                position = i->input.first;
             }
         }
+    }
+    CTPatlakState* kept = pending->first;
+    for (CTPatlakState const* i = pending->first; i < pending->last; i++) {
+        if (i->input.first == position) {
+            ct_patlak_states_add(active, *i);
+        } else {
+            *kept++ = *i;
+        }
+    }
+    pending->last = kept;
 
-        // Take all the nondead next states to the active states.
-        ct_patlak_states_clear(&active);
-        for (const CTPatlakState* i = next.first; i < next.last; i++) {
-            if (!i->dead) {
-                ct_patlak_states_add(&active, *i);
+    // Keep only the records of the tags that the states point to, so they do
+    // not pile up over the input.
+    if (matcher->tags.last != matcher->tags.first) {
+        CTPatlakTags previous = matcher->tags;
+        matcher->tags         = matcher->previous;
+        matcher->previous     = previous;
+        ct_patlak_tags_clear(&matcher->tags);
+        for (CTPatlakState* i = active->first; i < active->last; i++) {
+            if (i->tags != 0) {
+                i->tags =
+                    ct_patlak_tags_copy(&matcher->tags, &previous, i->tags);
+            }
+        }
+        for (CTPatlakState* i = pending->first; i < pending->last; i++) {
+            if (i->tags != 0) {
+                i->tags =
+                    ct_patlak_tags_copy(&matcher->tags, &previous, i->tags);
             }
         }
     }
 
-end:
-    ct_patlak_states_free(&active);
-    ct_patlak_states_free(&next);
+    // Decode all the states at the position, and collect the next states.
+    ct_patlak_visits_next(&matcher->visits);
+    ct_patlak_states_clear(next);
+    for (CTPatlakState const* i = active->first; i < active->last; i++) {
+        ct_patlak_states_add(stack, *i);
+        while (ct_patlak_states_finite(stack)) {
+            CTPatlakState state = *--stack->last;
+            if (!ct_patlak_visits_add(&matcher->visits, &state)) {
+                continue;
+            }
+
+            // Return early if matched. Empty matches do not count.
+            if (ct_patlak_decode(matcher, codes, state) && position != start) {
+                *match           = (CTString){.first = start, .last = position};
+                matcher->matched = state.tags;
+                ct_patlak_states_clear(stack);
+                return true;
+            }
+        }
+    }
+
+    // Take the next states to the active states.
+    CTPatlakStates stepped = *active;
+    *active                = *next;
+    *next                  = stepped;
+
+    // Finish without a match when all states died.
+    if (!ct_patlak_states_finite(active) && !ct_patlak_states_finite(pending)) {
+        *match = (CTString){0};
+        return true;
+    }
+    return false;
+}
+
+/* Decode until the end starting from the initial state using the memory of
+ * the matcher. Returns the shortest initial portion of the input that was
+ * accepted by the nondeterministic finite automaton. Empty match means none of
+ * the states were accepted before all states died. */
+CTString ct_patlak_decode_match(
+    CTPatlakMatcher*     matcher,
+    CTPatlakCodes const* codes,
+    CTPatlakState        initial)
+{
+    CTString match = {0};
+    ct_patlak_decode_start(matcher, initial);
+    while (!ct_patlak_decode_step(matcher, codes, initial.input.first, &match)) {
+    }
+    return match;
+}
+
+/* Decode until the end starting from the initial state. Allocates the memory
+ * for decoding; see the matcher for reusing it. */
+CTString
+ct_patlak_decode_test(CTPatlakCodes const* codes, CTPatlakState initial)
+{
+    CTPatlakMatcher matcher = {0};
+    CTString        match   = ct_patlak_decode_match(&matcher, codes, initial);
+    ct_patlak_matcher_free(&matcher);
     return match;
 }
@@ -0,0 +1,416 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "patlak/automaton.c"
+#include "patlak/context.c"
+#include "patlak/loader.c"
+#include "patlak/pattern.c"
+#include "prelude/expect.c"
+#include "prelude/scalar.c"
+#include "prelude/string.c"
+#include "prelude/writer.c"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Information while generating the C code of a token set. */
+typedef struct {
+    /* Written C code. */
+    CTWriter* writer;
+    /* Token set that is generated. */
+    CTPatlakTokenSet const* set;
+    /* Prefix of the generated names. */
+    char const* prefix;
+} CTPatlakGenerator;
+
+/* Write the text, where dollar signs are replaced by the prefix. */
+void ct_patlak_generator_text(
+    CTPatlakGenerator const* generator,
+    char const*              text)
+{
+    for (char const* i = text; *i != '\0'; i++) {
+        if (*i == '$') {
+            ct_writer_terminated(generator->writer, generator->prefix);
+        } else {
+            ct_writer_character(generator->writer, *i);
+        }
+    }
+}
+
+/* Write the integer. */
+void ct_patlak_generator_integer(
+    CTPatlakGenerator const* generator,
+    CTIndex                  integer)
+{
+    ct_writer_integer(generator->writer, integer, 0, false);
+}
+
+/* Write the name of the pattern's function. */
+void ct_patlak_generator_name(
+    CTPatlakGenerator const* generator,
+    CTPatlakPattern const*   pattern)
+{
+    ct_patlak_generator_text(generator, "$_");
+    ct_writer_string(generator->writer, &pattern->name);
+}
+
+/* Write the word as a hexadecimal literal, which is never negative unlike the
+ * written integers. */
+void ct_patlak_generator_word(
+    CTPatlakGenerator const* generator,
+    uint64_t                 word)
+{
+    char digits[] = "0x0000000000000000ULL";
+    for (int i = 0; i < 16; i++) {
+        digits[17 - i] = "0123456789ABCDEF"[word >> (4 * i) & 0xF];
+    }
+    ct_writer_terminated(generator->writer, digits);
+}
+
+/* Next state of the state of the automaton with the character. */
+int32_t ct_patlak_generator_next(
+    CTPatlakAutomaton const* automaton,
+    CTIndex                  state,
+    unsigned                 character)
+{
+    return automaton->transitions
+        [state * automaton->class_count + automaton->classes[character]];
+}
+
+/* Whether the characters that go from the state to the target are a single
+ * range, whose borders are put to the first and the last then. */
+bool ct_patlak_generator_range(
+    CTPatlakAutomaton const* automaton,
+    CTIndex                  state,
+    int32_t                  target,
+    unsigned*                first,
+    unsigned*                last)
+{
+    unsigned i = 0;
+    while (ct_patlak_generator_next(automaton, state, i) != target) {
+        i++;
+    }
+    *first = i;
+    while (i < 256 && ct_patlak_generator_next(automaton, state, i) == target) {
+        i++;
+    }
+    *last = i - 1;
+    while (i < 256 && ct_patlak_generator_next(automaton, state, i) != target) {
+        i++;
+    }
+    return i == 256;
+}
+
+/* Whether the target is a state the state goes to, which is not the dead
+ * state and was not gone to with a smaller character. The character is the
+ * smallest one that goes to the target. */
+bool ct_patlak_generator_first(
+    CTPatlakAutomaton const* automaton,
+    CTIndex                  state,
+    unsigned                 character)
+{
+    int32_t target = ct_patlak_generator_next(automaton, state, character);
+    if (target == automaton->dead) {
+        return false;
+    }
+    for (unsigned i = 0; i < character; i++) {
+        if (ct_patlak_generator_next(automaton, state, i) == target) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Write the name of the bitmap of the characters that go from the state to
+ * the target. */
+void ct_patlak_generator_bitmap(
+    CTPatlakGenerator const* generator,
+    CTIndex                  state,
+    int32_t                  target)
+{
+    ct_patlak_generator_text(generator, "set");
+    ct_patlak_generator_integer(generator, state);
+    ct_patlak_generator_text(generator, "_");
+    ct_patlak_generator_integer(generator, target);
+}
+
+/* Write the bitmaps of the characters that go from each state to each target,
+ * which are not a single range, as constant arrays. */
+void ct_patlak_generator_bitmaps(
+    CTPatlakGenerator const* generator,
+    CTPatlakAutomaton const* automaton)
+{
+    for (CTIndex state = 0; state < automaton->size; state++) {
+        for (unsigned i = 0; i < 256; i++) {
+            unsigned first = 0;
+            unsigned last  = 0;
+            int32_t  target = ct_patlak_generator_next(automaton, state, i);
+            if (!ct_patlak_generator_first(automaton, state, i) ||
+                ct_patlak_generator_range(
+                    automaton,
+                    state,
+                    target,
+                    &first,
+                    &last)) {
+                continue;
+            }
+            uint64_t words[4] = {0};
+            for (unsigned j = i; j < 256; j++) {
+                if (ct_patlak_generator_next(automaton, state, j) == target) {
+                    words[j / 64] |= (uint64_t)1 << (j % 64);
+                }
+            }
+            ct_patlak_generator_text(
+                generator,
+                "    static unsigned long long const ");
+            ct_patlak_generator_bitmap(generator, state, target);
+            ct_patlak_generator_text(generator, "[4] = {");
+            for (int j = 0; j < 4; j++) {
+                ct_patlak_generator_text(generator, j == 0 ? "\n" : ",\n");
+                ct_patlak_generator_text(generator, "        ");
+                ct_patlak_generator_word(generator, words[j]);
+            }
+            ct_patlak_generator_text(generator, "};\n");
+        }
+    }
+}
+
+/* Write the jump to the target if the character is in the range. */
+void ct_patlak_generator_jump_range(
+    CTPatlakGenerator const* generator,
+    unsigned                 first,
+    unsigned                 last,
+    int32_t                  target)
+{
+    if (first == 0 && last == 255) {
+        ct_patlak_generator_text(generator, "    goto s");
+        ct_patlak_generator_integer(generator, target);
+        ct_patlak_generator_text(generator, ";\n");
+        return;
+    }
+    if (first == last) {
+        ct_patlak_generator_text(generator, "    if (c == ");
+        ct_patlak_generator_integer(generator, first);
+    } else {
+        ct_patlak_generator_text(generator, "    if (c - ");
+        ct_patlak_generator_integer(generator, first);
+        ct_patlak_generator_text(generator, "u <= ");
+        ct_patlak_generator_integer(generator, last - first);
+        ct_patlak_generator_text(generator, "u");
+    }
+    ct_patlak_generator_text(generator, ") {\n        goto s");
+    ct_patlak_generator_integer(generator, target);
+    ct_patlak_generator_text(generator, ";\n    }\n");
+}
+
+/* Write the state of the automaton, which is labeled if it is gone to. Keeps
+ * the match if the state accepts, and consumes the next character to go to
+ * the next state; or returns the kept match if it cannot. */
+void ct_patlak_generator_state(
+    CTPatlakGenerator const* generator,
+    CTPatlakAutomaton const* automaton,
+    bool const*              labeled,
+    CTIndex                  state,
+    bool                     tokens)
+{
+    if (labeled[state]) {
+        ct_patlak_generator_text(generator, "s");
+        ct_patlak_generator_integer(generator, state);
+        ct_patlak_generator_text(generator, ":\n");
+    }
+    if (automaton->accepts[state] >= 0) {
+        ct_patlak_generator_text(
+            generator,
+            "    length = (size_t)(i - first);\n");
+        if (tokens) {
+            ct_patlak_generator_text(generator, "    *token  = ");
+            ct_patlak_generator_integer(generator, automaton->accepts[state]);
+            ct_patlak_generator_text(generator, ";\n");
+        }
+    }
+
+    bool moves = false;
+    for (unsigned i = 0; i < 256; i++) {
+        moves |=
+            ct_patlak_generator_next(automaton, state, i) != automaton->dead;
+    }
+    if (moves) {
+        ct_patlak_generator_text(
+            generator,
+            "    if (i == last) {\n"
+            "        return length;\n"
+            "    }\n"
+            "    c = (unsigned char)*i++;\n");
+    }
+    for (unsigned i = 0; i < 256; i++) {
+        if (!ct_patlak_generator_first(automaton, state, i)) {
+            continue;
+        }
+        unsigned first  = 0;
+        unsigned last   = 0;
+        int32_t  target = ct_patlak_generator_next(automaton, state, i);
+        if (ct_patlak_generator_range(
+                automaton,
+                state,
+                target,
+                &first,
+                &last)) {
+            ct_patlak_generator_jump_range(generator, first, last, target);
+            continue;
+        }
+        ct_patlak_generator_text(generator, "    if (");
+        ct_patlak_generator_bitmap(generator, state, target);
+        ct_patlak_generator_text(
+            generator,
+            "[c / 64] >> (c % 64) & 1) {\n"
+            "        goto s");
+        ct_patlak_generator_integer(generator, target);
+        ct_patlak_generator_text(generator, ";\n    }\n");
+    }
+    ct_patlak_generator_text(generator, "    return length;\n");
+}
+
+/* Write the body of a function that runs the automaton from the start of the
+ * input between the first and the last, with a label for each state that is
+ * gone to. Returns the length of the longest match that was kept, which is
+ * the shortest match of the first pattern in the order; and sets the index of
+ * the pattern in the order to the token if the tokens are written. */
+void ct_patlak_generator_automaton(
+    CTPatlakGenerator const* generator,
+    CTPatlakAutomaton const* automaton,
+    bool                     tokens)
+{
+    bool* labeled = calloc(automaton->size, sizeof(bool));
+    ct_expect(labeled != NULL, "Could not allocate!");
+    for (CTIndex state = 0; state < automaton->size; state++) {
+        for (unsigned i = 0; i < 256; i++) {
+            labeled[ct_patlak_generator_next(automaton, state, i)] = true;
+        }
+    }
+
+    ct_patlak_generator_text(generator, "{\n");
+    ct_patlak_generator_bitmaps(generator, automaton);
+    ct_patlak_generator_text(
+        generator,
+        "    char const* i      = first;\n"
+        "    size_t      length = 0;\n"
+        "    unsigned    c;\n"
+        "    (void)c;\n");
+    if (tokens) {
+        ct_patlak_generator_text(generator, "    *token = -1;\n");
+    }
+
+    // Start with the start state, so it does not need a jump.
+    ct_patlak_generator_state(
+        generator,
+        automaton,
+        labeled,
+        automaton->start,
+        tokens);
+    for (CTIndex state = 0; state < automaton->size; state++) {
+        if (state != automaton->start && state != automaton->dead) {
+            ct_patlak_generator_state(
+                generator,
+                automaton,
+                labeled,
+                state,
+                tokens);
+        }
+    }
+    ct_patlak_generator_text(generator, "}\n\n");
+    free(labeled);
+}
+
+/* Build the automaton of the patterns with the names in the order. Terminates
+ * if it cannot be built, because the generated code has no decoder to fall
+ * back to. */
+void ct_patlak_generator_automate(
+    CTPatlakGenerator const* generator,
+    CTString const*          names,
+    CTIndex                  order,
+    CTPatlakAutomaton*       automaton)
+{
+    ct_expect(
+        ct_patlak_automate(&generator->set->context, names, order, automaton),
+        "Patterns with recursive references cannot be generated!");
+}
+
+/* Write the function that matches the pattern. */
+void ct_patlak_generator_pattern(
+    CTPatlakGenerator const* generator,
+    CTPatlakPattern const*   pattern)
+{
+    CTPatlakAutomaton automaton = {0};
+    ct_patlak_generator_automate(generator, &pattern->name, 1, &automaton);
+    ct_patlak_generator_text(generator, "size_t ");
+    ct_patlak_generator_name(generator, pattern);
+    ct_patlak_generator_text(
+        generator,
+        "(char const* first, char const* last)\n");
+    ct_patlak_generator_automaton(generator, &automaton, false);
+    ct_patlak_automaton_free(&automaton);
+}
+
+/* Write the names of the tokens and the function that finds the next token
+ * in the order, which runs the automaton of all the patterns in the order at
+ * once. */
+void ct_patlak_generator_order(CTPatlakGenerator const* generator)
+{
+    CTPatlakTokenSet const* set = generator->set;
+
+    ct_patlak_generator_text(generator, "char const* const $_tokens[] = {");
+    for (CTIndex i = 0; i < set->order_size; i++) {
+        ct_patlak_generator_text(generator, "\n    \"");
+        ct_writer_string(generator->writer, set->order + i);
+        ct_patlak_generator_text(generator, "\",");
+    }
+    ct_patlak_generator_text(
+        generator,
+        "\n    \"\"};\n"
+        "\n"
+        "size_t $_next(char const* first, char const* last, int* token)\n");
+    CTPatlakAutomaton automaton = {0};
+    ct_patlak_generator_automate(
+        generator,
+        set->order,
+        set->order_size,
+        &automaton);
+    ct_patlak_generator_automaton(generator, &automaton, true);
+    ct_patlak_automaton_free(&automaton);
+}
+
+/* Write standalone C code that matches the patterns of the token set the
+ * same way as decoding them. Each pattern is a function with the prefix that
+ * returns the length of the match at the start of the input, and the order
+ * is tried by the next function of the prefix. Functions are the minimal
+ * automata of the patterns, where each state is a label that checks the next
+ * character and goes to the next label; so, they do not allocate and take
+ * linear time. */
+void ct_patlak_generate(
+    CTWriter*               writer,
+    CTPatlakTokenSet const* set,
+    char const*             prefix)
+{
+    CTPatlakGenerator generator = {
+        .writer = writer,
+        .set    = set,
+        .prefix = prefix};
+
+    ct_patlak_generator_text(
+        &generator,
+        "// Generated by the Thrice C Transpiler. Do not edit.\n"
+        "\n"
+        "#include <stddef.h>\n"
+        "\n");
+
+    CTPatlakPatterns const* patterns = &set->context.patterns;
+    for (CTPatlakPattern const* i = patterns->information.first;
+         i < patterns->information.last;
+         i++) {
+        ct_patlak_generator_pattern(&generator, i);
+    }
+    ct_patlak_generator_order(&generator);
+}
@@ -0,0 +1,364 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "patlak/analysis.c"
+#include "patlak/code.c"
+#include "patlak/pattern.c"
+#include "patlak/state.c"
+#include "prelude/expect.c"
+#include "prelude/scalar.c"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+/* Most amount of codes a reffered pattern can have to be inlined. */
+#define CT_PATLAK_INLINE_LIMIT 256
+
+/* Information while inlining the references. Patterns are kept as their
+ * indices in the pattern informations. */
+typedef struct {
+    /* Codes before inlining. */
+    CTPatlakCodes const* codes;
+    /* Patterns of the codes. */
+    CTPatlakPatterns* patterns;
+    /* Amount of patterns. */
+    CTIndex count;
+    /* Patterns in the order of their code. */
+    CTIndex* sorted;
+    /* Index after the last code of each pattern. */
+    CTIndex* ends;
+    /* Order each pattern is visited in while finding the strongly connected
+     * components, starting from one. Zero means not visited. */
+    CTIndex* visits;
+    /* Least visit order that is reachable from each pattern in its
+     * component. */
+    CTIndex* lows;
+    /* Whether each pattern is in the stack. */
+    bool* stacked;
+    /* Patterns whose components are not finished. */
+    CTIndex* stack;
+    /* Amount of patterns in the stack. */
+    CTIndex stacked_amount;
+    /* Amount of visited patterns. */
+    CTIndex visited;
+    /* Whether each pattern can reach itself through references. */
+    bool* recursive;
+    /* Patterns in the order their components are finished, which puts the
+     * reffered patterns before the ones that refer to them. */
+    CTIndex* order;
+    /* Amount of ordered patterns. */
+    CTIndex ordered;
+    /* Start of the inlined code of each pattern. */
+    CTIndex* starts;
+    /* Amount of inlined codes of each pattern. */
+    CTIndex* sizes;
+    /* Amount of counters the inlined code of each pattern uses. */
+    int* counters;
+} CTPatlakInliner;
+
+/* Allocate the array for the amount of elements. */
+void* ct_patlak_inliner_allocate(CTIndex amount, CTIndex size)
+{
+    void* memory = calloc(amount > 0 ? amount : 1, size);
+    ct_expect(memory != NULL, "Could not allocate!");
+    return memory;
+}
+
+/* Pattern information at the index. */
+CTPatlakPattern*
+ct_patlak_inliner_pattern(CTPatlakInliner const* inliner, CTIndex pattern)
+{
+    return inliner->patterns->information.first + pattern;
+}
+
+/* Index of the pattern whose code starts at the index before inlining. */
+CTIndex ct_patlak_inliner_find(CTPatlakInliner const* inliner, CTIndex start)
+{
+    CTIndex low  = 0;
+    CTIndex high = inliner->count;
+    while (low < high) {
+        CTIndex middle = low + (high - low) / 2;
+        CTIndex found =
+            ct_patlak_inliner_pattern(inliner, inliner->sorted[middle])->start;
+        if (found == start) {
+            return inliner->sorted[middle];
+        }
+        if (found < start) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    ct_expect(false, "Reference to an unknown pattern!");
+    return -1;
+}
+
+/* Sort the patterns by the start of their code, and find their ends. */
+void ct_patlak_inliner_sort(CTPatlakInliner* inliner)
+{
+    for (CTIndex i = 0; i < inliner->count; i++) {
+        CTIndex pattern = i;
+        CTIndex start   = ct_patlak_inliner_pattern(inliner, pattern)->start;
+        CTIndex j       = i;
+        for (; j > 0 &&
+               ct_patlak_inliner_pattern(inliner, inliner->sorted[j - 1])
+                       ->start > start;
+             j--) {
+            inliner->sorted[j] = inliner->sorted[j - 1];
+        }
+        inliner->sorted[j] = pattern;
+    }
+    for (CTIndex i = 0; i < inliner->count; i++) {
+        inliner->ends[inliner->sorted[i]] =
+            i + 1 < inliner->count
+                ? ct_patlak_inliner_pattern(inliner, inliner->sorted[i + 1])
+                      ->start
+                : ct_patlak_codes_size(inliner->codes);
+    }
+}
+
+/* Find the strongly connected component of the pattern in the graph of
+ * references. Patterns in the same component refer to each other. */
+void ct_patlak_inliner_connect(CTPatlakInliner* inliner, CTIndex pattern)
+{
+    inliner->visits[pattern] = ++inliner->visited;
+    inliner->lows[pattern]   = inliner->visits[pattern];
+    inliner->stack[inliner->stacked_amount++] = pattern;
+    inliner->stacked[pattern]                 = true;
+
+    for (CTIndex i = ct_patlak_inliner_pattern(inliner, pattern)->start;
+         i < inliner->ends[pattern];
+         i++) {
+        CTPatlakCode const* code = ct_patlak_codes_get(inliner->codes, i);
+        if (code->type != CT_PATLAK_CODE_REFERANCE) {
+            continue;
+        }
+        CTIndex reffered = ct_patlak_inliner_find(inliner, code->reffered);
+        if (reffered == pattern) {
+            inliner->recursive[pattern] = true;
+        }
+        if (inliner->visits[reffered] == 0) {
+            ct_patlak_inliner_connect(inliner, reffered);
+            if (inliner->lows[reffered] < inliner->lows[pattern]) {
+                inliner->lows[pattern] = inliner->lows[reffered];
+            }
+        } else if (
+            inliner->stacked[reffered] &&
+            inliner->visits[reffered] < inliner->lows[pattern]) {
+            inliner->lows[pattern] = inliner->visits[reffered];
+        }
+    }
+
+    // Pop the component if the pattern is its root. Components with more than
+    // one pattern are cycles.
+    if (inliner->lows[pattern] != inliner->visits[pattern]) {
+        return;
+    }
+    CTIndex first = inliner->stacked_amount;
+    do {
+        first--;
+    } while (inliner->stack[first] != pattern);
+    bool cycle = inliner->stacked_amount - first > 1;
+    for (CTIndex i = first; i < inliner->stacked_amount; i++) {
+        CTIndex member             = inliner->stack[i];
+        inliner->stacked[member]   = false;
+        inliner->recursive[member] = inliner->recursive[member] || cycle;
+        inliner->order[inliner->ordered++] = member;
+    }
+    inliner->stacked_amount = first;
+}
+
+/* Amount of counters the code of the pattern uses before inlining. */
+int ct_patlak_inliner_own_counters(
+    CTPatlakInliner const* inliner,
+    CTIndex                pattern)
+{
+    int counters = 0;
+    for (CTIndex i = ct_patlak_inliner_pattern(inliner, pattern)->start;
+         i < inliner->ends[pattern];
+         i++) {
+        CTPatlakCode const* code = ct_patlak_codes_get(inliner->codes, i);
+        if (code->type == CT_PATLAK_CODE_COUNT && code->counter >= counters) {
+            counters = code->counter + 1;
+        }
+    }
+    return counters;
+}
+
+/* Pattern that is inlined in place of the code. Negative if the code is not
+ * a reference that can be inlined. References to recursive patterns stay,
+ * and so do the ones to patterns that are too long, that can match empty,
+ * or whose counters would not fit. A reference matches only the shortest
+ * match of its pattern, but inlined code can continue from any of them; so,
+ * only the patterns whose matches are all the same length are inlined. */
+CTIndex ct_patlak_inliner_callee(
+    CTPatlakInliner const* inliner,
+    CTPatlakCode const*    code,
+    int                    counters)
+{
+    if (code->type != CT_PATLAK_CODE_REFERANCE) {
+        return -1;
+    }
+    CTIndex                callee =
+        ct_patlak_inliner_find(inliner, code->reffered);
+    CTPatlakPattern const* reffered =
+        ct_patlak_inliner_pattern(inliner, callee);
+    if (inliner->recursive[callee] || !reffered->analyzed ||
+        reffered->analysis.nullable ||
+        reffered->analysis.minimum != reffered->analysis.maximum ||
+        inliner->sizes[callee] > CT_PATLAK_INLINE_LIMIT ||
+        counters + inliner->counters[callee] > CT_PATLAK_STATE_COUNTERS) {
+        return -1;
+    }
+    return callee;
+}
+
+/* Add the code of the pattern to the output with the inlinable references
+ * replaced by the code of the reffered patterns. The reffered patterns must be
+ * added before. References keep the starts from before inlining. */
+void ct_patlak_inliner_emit(
+    CTPatlakInliner* inliner,
+    CTPatlakCodes*   output,
+    CTIndex          pattern)
+{
+    CTIndex start    = ct_patlak_inliner_pattern(inliner, pattern)->start;
+    CTIndex size     = inliner->ends[pattern] - start;
+    int     counters = ct_patlak_inliner_own_counters(inliner, pattern);
+
+    // Find where each code goes after inlining.
+    CTIndex* map = ct_patlak_inliner_allocate(size + 1, sizeof(CTIndex));
+    inliner->counters[pattern] = counters;
+    for (CTIndex i = 0; i < size; i++) {
+        CTIndex callee = ct_patlak_inliner_callee(
+            inliner,
+            ct_patlak_codes_get(inliner->codes, start + i),
+            counters);
+        map[i + 1] = map[i] + (callee < 0 ? 1 : inliner->sizes[callee]);
+        if (callee >= 0 &&
+            counters + inliner->counters[callee] > inliner->counters[pattern]) {
+            inliner->counters[pattern] = counters + inliner->counters[callee];
+        }
+    }
+    inliner->starts[pattern] = ct_patlak_codes_size(output);
+    inliner->sizes[pattern]  = map[size];
+    ct_patlak_codes_reserve(output, map[size]);
+
+    for (CTIndex i = 0; i < size; i++) {
+        CTPatlakCode code = *ct_patlak_codes_get(inliner->codes, start + i);
+        CTIndex      target = i + code.movement;
+        ct_expect(
+            code.type == CT_PATLAK_CODE_BRANCH ||
+                code.type == CT_PATLAK_CODE_TERMINAL ||
+                (target >= 0 && target < size),
+            "Movement out of the pattern!");
+        CTIndex callee = ct_patlak_inliner_callee(inliner, &code, counters);
+
+        if (callee < 0) {
+            if (code.type != CT_PATLAK_CODE_BRANCH &&
+                code.type != CT_PATLAK_CODE_TERMINAL) {
+                code.movement = map[target] - map[i];
+            }
+            ct_patlak_codes_add(output, code);
+            continue;
+        }
+
+        // Counters of the reffered pattern come after the ones of this one,
+        // and its end continues after the reference.
+        for (CTIndex j = 0; j < inliner->sizes[callee]; j++) {
+            CTPatlakCode inlined =
+                *ct_patlak_codes_get(output, inliner->starts[callee] + j);
+            if (inlined.type == CT_PATLAK_CODE_COUNT ||
+                inlined.type == CT_PATLAK_CODE_REPEAT) {
+                inlined.counter += counters;
+            } else if (inlined.type == CT_PATLAK_CODE_TAG) {
+                // Captures belong to the reffered pattern.
+                inlined = (CTPatlakCode){
+                    .movement = inlined.movement,
+                    .type     = CT_PATLAK_CODE_EMPTY};
+            } else if (inlined.type == CT_PATLAK_CODE_TERMINAL) {
+                inlined = (CTPatlakCode){
+                    .movement = map[target] - (map[i] + j),
+                    .type     = CT_PATLAK_CODE_EMPTY};
+            }
+            ct_patlak_codes_add(output, inlined);
+        }
+    }
+
+    free(map);
+}
+
+/* Replace the references to the patterns that do not refer back to
+ * themselves and match a fixed amount of characters with a copy of the code of
+ * the reffered pattern. The other references are left to be decoded
+ * separately. Moves the code of
+ * the patterns, and analyzes them again. */
+void ct_patlak_inline(CTPatlakCodes* codes, CTPatlakPatterns* patterns)
+{
+    CTIndex         count   = ct_patlak_patterns_information_size(patterns);
+    CTPatlakInliner inliner = {
+        .codes     = codes,
+        .patterns  = patterns,
+        .count     = count,
+        .sorted    = ct_patlak_inliner_allocate(count, sizeof(CTIndex)),
+        .ends      = ct_patlak_inliner_allocate(count, sizeof(CTIndex)),
+        .visits    = ct_patlak_inliner_allocate(count, sizeof(CTIndex)),
+        .lows      = ct_patlak_inliner_allocate(count, sizeof(CTIndex)),
+        .stacked   = ct_patlak_inliner_allocate(count, sizeof(bool)),
+        .stack     = ct_patlak_inliner_allocate(count, sizeof(CTIndex)),
+        .recursive = ct_patlak_inliner_allocate(count, sizeof(bool)),
+        .order     = ct_patlak_inliner_allocate(count, sizeof(CTIndex)),
+        .starts    = ct_patlak_inliner_allocate(count, sizeof(CTIndex)),
+        .sizes     = ct_patlak_inliner_allocate(count, sizeof(CTIndex)),
+        .counters  = ct_patlak_inliner_allocate(count, sizeof(int))};
+
+    ct_patlak_inliner_sort(&inliner);
+    for (CTIndex i = 0; i < count; i++) {
+        if (inliner.visits[i] == 0) {
+            ct_patlak_inliner_connect(&inliner, i);
+        }
+    }
+
+    CTPatlakCodes output = {0};
+    ct_patlak_codes_take(&output, codes);
+    for (CTIndex i = 0; i < count; i++) {
+        ct_patlak_inliner_emit(&inliner, &output, inliner.order[i]);
+    }
+
+    // Point the remaining references to the moved code.
+    for (CTPatlakCode* i = output.first; i < output.last; i++) {
+        if (i->type == CT_PATLAK_CODE_REFERANCE) {
+            i->reffered =
+                inliner.starts[ct_patlak_inliner_find(&inliner, i->reffered)];
+        }
+    }
+    ct_patlak_codes_free(codes);
+    *codes = output;
+
+    for (CTIndex i = 0; i < count; i++) {
+        CTPatlakPattern* pattern = ct_patlak_inliner_pattern(&inliner, i);
+        pattern->start           = inliner.starts[i];
+        pattern->analyzed        = false;
+    }
+    for (CTIndex i = 0; i < count; i++) {
+        CTIndex pattern = inliner.order[i];
+        ct_patlak_analyze_until(
+            codes,
+            patterns,
+            ct_patlak_inliner_pattern(&inliner, pattern),
+            inliner.starts[pattern] + inliner.sizes[pattern]);
+    }
+
+    free(inliner.sorted);
+    free(inliner.ends);
+    free(inliner.visits);
+    free(inliner.lows);
+    free(inliner.stacked);
+    free(inliner.stack);
+    free(inliner.recursive);
+    free(inliner.order);
+    free(inliner.starts);
+    free(inliner.sizes);
+    free(inliner.counters);
+}
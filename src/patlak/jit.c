@@ -0,0 +1,347 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "patlak/automaton.c"
+#include "patlak/code.c"
+#include "prelude/expect.c"
+#include "prelude/memory.c"
+#include "prelude/scalar.c"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/* Most amount of states of the automaton of a pattern that is compiled to
+ * machine code. Patterns that need more are decoded. */
+#define CT_PATLAK_JIT_STATES 256
+
+/* Amount of matches of a pattern before it is compiled to machine code.
+ * Compiling a number pattern takes about as long as decoding it 40 times;
+ * thus, the patterns that are matched fewer times are only decoded. */
+#define CT_PATLAK_JIT_THRESHOLD 32
+
+/* Machine code of a pattern. Returns the border after the match, or null if
+ * the input between the borders does not match. */
+typedef char const* (*CTPatlakJitted)(char const* first, char const* last);
+
+/* Machine code of a pattern, which is compiled from the minimal automaton of
+ * the pattern; so, sets, branches and loops are compiled like the characters.
+ * Patterns with references are decoded instead. Patterns are compiled once
+ * they are matched enough times, by the thread that matches them then. */
+typedef struct {
+    /* Machine code, or null if it is not compiled. */
+    _Atomic(CTPatlakJitted) function;
+    /* Amount of mapped bytes of the machine code. */
+    CTIndex length;
+    /* Amount of matches left before compiling, which is zero if the pattern
+     * is not going to be compiled. */
+    _Atomic CTIndex remaining;
+} CTPatlakJit;
+
+/* Jump whose offset is written after the state it goes to is written. */
+typedef struct {
+    /* Position of the offset. */
+    CTIndex position;
+    /* State that is jumped to, or the amount of states for the failure. */
+    CTIndex target;
+} CTPatlakJitJump;
+
+/* Machine code that is being written. */
+typedef struct {
+    /* Bytes. */
+    unsigned char* bytes;
+    /* Amount of written bytes. */
+    CTIndex size;
+    /* Amount of allocated bytes. */
+    CTIndex capacity;
+    /* Jumps to the states and the failure. */
+    CTPatlakJitJump* jumps;
+    /* Amount of jumps. */
+    CTIndex jump_count;
+    /* Amount of allocated jumps. */
+    CTIndex jump_capacity;
+    /* Position of each state, and of the failure after them. */
+    CTIndex* labels;
+    /* Amount of labels. */
+    CTIndex label_count;
+} CTPatlakJitCode;
+
+/* Write the bytes. */
+void ct_patlak_jit_bytes(
+    CTPatlakJitCode*     code,
+    unsigned char const* bytes,
+    CTIndex              amount)
+{
+    if (code->size + amount > code->capacity) {
+        CTIndex capacity = code->capacity + (code->capacity >> 1);
+        if (capacity < code->size + amount) {
+            capacity = code->size + amount;
+        }
+        code->bytes = ct_memory_resize(
+            CT_MEMORY_MACHINE,
+            code->bytes,
+            code->capacity,
+            capacity,
+            1);
+        code->capacity = capacity;
+    }
+    memcpy(code->bytes + code->size, bytes, amount);
+    code->size += amount;
+}
+
+/* Write the 32-bit integer in little-endian order. */
+void ct_patlak_jit_integer(CTPatlakJitCode* code, uint32_t integer)
+{
+    unsigned char bytes[4] = {
+        integer & 0xFF,
+        (integer >> 8) & 0xFF,
+        (integer >> 16) & 0xFF,
+        (integer >> 24) & 0xFF};
+    ct_patlak_jit_bytes(code, bytes, 4);
+}
+
+/* Write the jump with the opcode bytes to the state, whose offset is patched
+ * after all the states are written. */
+void ct_patlak_jit_jump(
+    CTPatlakJitCode*     code,
+    unsigned char const* opcode,
+    CTIndex              amount,
+    CTIndex              target)
+{
+    ct_patlak_jit_bytes(code, opcode, amount);
+    if (code->jump_count == code->jump_capacity) {
+        CTIndex capacity = code->jump_capacity + (code->jump_capacity >> 1);
+        if (capacity < 16) {
+            capacity = 16;
+        }
+        code->jumps = ct_memory_resize(
+            CT_MEMORY_MACHINE,
+            code->jumps,
+            code->jump_capacity,
+            capacity,
+            sizeof(CTPatlakJitJump));
+        code->jump_capacity = capacity;
+    }
+    code->jumps[code->jump_count++] =
+        (CTPatlakJitJump){.position = code->size, .target = target};
+    ct_patlak_jit_integer(code, 0);
+}
+
+/* Write the jump to the state if the character in eax is in the inclusive
+ * range. */
+void ct_patlak_jit_range(
+    CTPatlakJitCode* code,
+    unsigned         first,
+    unsigned         last,
+    CTIndex          target)
+{
+    // jmp target
+    if (first == 0x00 && last == 0xFF) {
+        unsigned char jump[1] = {0xE9};
+        ct_patlak_jit_jump(code, jump, 1, target);
+        return;
+    }
+
+    // cmp eax, first; je target
+    if (first == last) {
+        unsigned char compare = 0x3D;
+        ct_patlak_jit_bytes(code, &compare, 1);
+        ct_patlak_jit_integer(code, first);
+        unsigned char equal[2] = {0x0F, 0x84};
+        ct_patlak_jit_jump(code, equal, 2, target);
+        return;
+    }
+
+    // lea ecx, [rax - first]; cmp ecx, last - first; jbe target
+    unsigned char load[2] = {0x8D, 0x88};
+    ct_patlak_jit_bytes(code, load, 2);
+    ct_patlak_jit_integer(code, -(uint32_t)first);
+    unsigned char compare[2] = {0x81, 0xF9};
+    ct_patlak_jit_bytes(code, compare, 2);
+    ct_patlak_jit_integer(code, last - first);
+    unsigned char below[2] = {0x0F, 0x86};
+    ct_patlak_jit_jump(code, below, 2, target);
+}
+
+/* Write the machine code of the state of the automaton. A state that accepts
+ * returns, because the automaton of a single pattern cannot find a better
+ * match after it. Others consume a character and jump to the next state for
+ * each run of the characters that go to the same state. */
+void ct_patlak_jit_state(
+    CTPatlakJitCode*         code,
+    CTPatlakAutomaton const* automaton,
+    CTIndex                  state)
+{
+    code->labels[state] = code->size;
+    if (automaton->accepts[state] >= 0) {
+        // mov rax, rdi; ret
+        unsigned char match[4] = {0x48, 0x89, 0xF8, 0xC3};
+        ct_patlak_jit_bytes(code, match, 4);
+        return;
+    }
+
+    // cmp rdi, rsi; jae failure
+    unsigned char end[3] = {0x48, 0x39, 0xF7};
+    ct_patlak_jit_bytes(code, end, 3);
+    unsigned char above[2] = {0x0F, 0x83};
+    ct_patlak_jit_jump(code, above, 2, automaton->size);
+
+    // movzx eax, byte [rdi]; inc rdi
+    unsigned char load[6] = {0x0F, 0xB6, 0x07, 0x48, 0xFF, 0xC7};
+    ct_patlak_jit_bytes(code, load, 6);
+
+    int32_t const* transitions =
+        automaton->transitions + state * automaton->class_count;
+    unsigned first = 0;
+    for (unsigned i = 1; i <= 256; i++) {
+        int32_t target = transitions[automaton->classes[first]];
+        if (i < 256 && transitions[automaton->classes[i]] == target) {
+            continue;
+        }
+        if (target != automaton->dead) {
+            ct_patlak_jit_range(code, first, i - 1, target);
+        }
+        first = i;
+    }
+
+    // jmp failure
+    unsigned char jump[1] = {0xE9};
+    ct_patlak_jit_jump(code, jump, 1, automaton->size);
+}
+
+/* Write the machine code of the automaton, starting with its start state so
+ * the function begins there. */
+void ct_patlak_jit_write(
+    CTPatlakJitCode*         code,
+    CTPatlakAutomaton const* automaton)
+{
+    code->label_count = automaton->size + 1;
+    code->labels      = ct_memory_allocate(
+        CT_MEMORY_MACHINE,
+        code->label_count,
+        sizeof(CTIndex));
+    ct_patlak_jit_state(code, automaton, automaton->start);
+    for (CTIndex i = 0; i < automaton->size; i++) {
+        if (i != automaton->start && i != automaton->dead) {
+            ct_patlak_jit_state(code, automaton, i);
+        }
+    }
+
+    // failure: xor eax, eax; ret
+    code->labels[automaton->size] = code->size;
+    unsigned char failure[3]      = {0x31, 0xC0, 0xC3};
+    ct_patlak_jit_bytes(code, failure, 3);
+
+    // Patch the jumps, which are relative to the end of their offset.
+    CTIndex size = code->size;
+    for (CTIndex i = 0; i < code->jump_count; i++) {
+        CTPatlakJitJump jump = code->jumps[i];
+        code->size           = jump.position;
+        ct_patlak_jit_integer(
+            code,
+            (uint32_t)(code->labels[jump.target] - (jump.position + 4)));
+    }
+    code->size = size;
+}
+
+/* Deallocate memory. */
+void ct_patlak_jit_free(CTPatlakJit* jit)
+{
+    CTPatlakJitted function = atomic_load(&jit->function);
+    if (function != NULL) {
+        void* memory = NULL;
+        memcpy(&memory, &function, sizeof(memory));
+        munmap(memory, jit->length);
+        ct_memory_account(CT_MEMORY_MACHINE, jit->length, 0);
+    }
+    *jit = (CTPatlakJit){0};
+}
+
+/* Compile the pattern that starts at the code. Leaves the machine code null if
+ * the pattern has references, its automaton is too big, or executable memory
+ * cannot be mapped. */
+void ct_patlak_jit_compile(
+    CTPatlakJit*         jit,
+    CTPatlakCodes const* codes,
+    CTIndex              start)
+{
+    ct_patlak_jit_free(jit);
+#if defined(__x86_64__) && !defined(_WIN32)
+    CTPatlakAutomaton automaton = {0};
+    if (!ct_patlak_automaton(&automaton, codes, &start, 1)) {
+        return;
+    }
+    if (automaton.size > CT_PATLAK_JIT_STATES) {
+        ct_patlak_automaton_free(&automaton);
+        return;
+    }
+    CTPatlakJitCode code = {0};
+    ct_patlak_jit_write(&code, &automaton);
+    ct_patlak_automaton_free(&automaton);
+
+    void* memory = mmap(
+        NULL,
+        code.size,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1,
+        0);
+    if (memory != MAP_FAILED) {
+        memcpy(memory, code.bytes, code.size);
+        if (mprotect(memory, code.size, PROT_READ | PROT_EXEC) == 0) {
+            // Copy the address, because data and function pointers do not
+            // convert. Publish it after the code, for the other threads.
+            CTPatlakJitted function = NULL;
+            memcpy(&function, &memory, sizeof(memory));
+            jit->length = code.size;
+            ct_memory_account(CT_MEMORY_MACHINE, 0, code.size);
+            atomic_store_explicit(
+                &jit->function,
+                function,
+                memory_order_release);
+        } else {
+            munmap(memory, code.size);
+        }
+    }
+    ct_memory_free(CT_MEMORY_MACHINE, code.bytes, code.capacity, 1);
+    ct_memory_free(
+        CT_MEMORY_MACHINE,
+        code.jumps,
+        code.jump_capacity,
+        sizeof(CTPatlakJitJump));
+    ct_memory_free(
+        CT_MEMORY_MACHINE,
+        code.labels,
+        code.label_count,
+        sizeof(CTIndex));
+#else
+    (void)codes;
+    (void)start;
+#endif
+}
+
+/* Count a match of the pattern that starts at the code, and compile it if it
+ * used up the remaining matches. Matching shares the patterns between the
+ * threads; thus, only the counter and the machine code change, and they are
+ * atomic. */
+void ct_patlak_jit_count(
+    CTPatlakJit const*   jit,
+    CTPatlakCodes const* codes,
+    CTIndex              start)
+{
+    // Patterns are never constant objects, only viewed as constant while
+    // matching.
+    CTPatlakJit* counted = (CTPatlakJit*)jit;
+    if (atomic_load_explicit(&counted->remaining, memory_order_relaxed) > 0 &&
+        atomic_fetch_sub_explicit(
+            &counted->remaining,
+            1,
+            memory_order_relaxed) == 1) {
+        ct_patlak_jit_compile(counted, codes, start);
+    }
+}
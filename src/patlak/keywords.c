@@ -0,0 +1,225 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "prelude/expect.c"
+#include "prelude/memory.c"
+#include "prelude/scalar.c"
+#include "prelude/string.c"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Most amount of seeds that are tried for a bucket before giving up. */
+#define CT_PATLAK_KEYWORDS_SEEDS (1 << 20)
+
+/* Minimal perfect hash of keyword spellings. Spellings are put to buckets by
+ * the hash with seed zero, and each bucket keeps the seed that puts all of its
+ * spellings to different slots, or the slot of its only spelling. Finding a
+ * word is a probe to its bucket and a compare with the spelling at its
+ * slot. */
+typedef struct {
+    /* Spelling at each slot. */
+    CTString* spellings;
+    /* Seed of each bucket when positive, negative of the slot plus one of the
+     * only spelling when negative, and zero when empty. */
+    int32_t* seeds;
+    /* Amount of slots, which is the amount of spellings and buckets. */
+    CTIndex size;
+} CTPatlakKeywords;
+
+/* Hash of the spelling with the seed. */
+uint64_t ct_patlak_keywords_hash(CTString const* spelling, int32_t seed)
+{
+    uint64_t hash =
+        0xCBF29CE484222325ULL ^ (uint64_t)seed * 0x9E3779B97F4A7C15ULL;
+    for (char const* i = spelling->first; i < spelling->last; i++) {
+        hash ^= (unsigned char)*i;
+        hash *= 0x100000001B3ULL;
+    }
+    return hash ^ hash >> 29;
+}
+
+/* Slot of the spelling in the bucket that has the seed. */
+CTIndex ct_patlak_keywords_slot(
+    CTPatlakKeywords const* keywords,
+    CTString const*         spelling,
+    int32_t                 seed)
+{
+    return (CTIndex)(ct_patlak_keywords_hash(spelling, seed) % keywords->size);
+}
+
+/* Bucket of the spelling. */
+CTIndex ct_patlak_keywords_bucket(
+    CTPatlakKeywords const* keywords,
+    CTString const*         spelling)
+{
+    return ct_patlak_keywords_slot(keywords, spelling, 0);
+}
+
+/* Compare for sorting the spellings by their buckets, with the buckets that
+ * have more spellings first. */
+int ct_patlak_keywords_compare(void const* lhs, void const* rhs)
+{
+    CTIndex const* left  = lhs;
+    CTIndex const* right = rhs;
+    if (left[0] != right[0]) {
+        return left[0] > right[0] ? -1 : 1;
+    }
+    return left[1] < right[1] ? -1 : left[1] > right[1];
+}
+
+/* Place the spellings of a bucket by trying seeds until all of them land on
+ * different free slots. */
+void ct_patlak_keywords_place(
+    CTPatlakKeywords* keywords,
+    CTString const*   spellings,
+    CTIndex const*    members,
+    CTIndex           count,
+    bool*             taken)
+{
+    CTIndex bucket =
+        ct_patlak_keywords_bucket(keywords, spellings + members[0]);
+    for (int32_t seed = 1; seed < CT_PATLAK_KEYWORDS_SEEDS; seed++) {
+        CTIndex placed = 0;
+        for (; placed < count; placed++) {
+            CTIndex slot = ct_patlak_keywords_slot(
+                keywords,
+                spellings + members[placed],
+                seed);
+            if (taken[slot]) {
+                break;
+            }
+            taken[slot] = true;
+        }
+        if (placed == count) {
+            for (CTIndex i = 0; i < count; i++) {
+                CTString const* spelling = spellings + members[i];
+                keywords->spellings[ct_patlak_keywords_slot(
+                    keywords,
+                    spelling,
+                    seed)] = *spelling;
+            }
+            keywords->seeds[bucket] = seed;
+            return;
+        }
+
+        // Free the slots this seed took before trying the next one.
+        for (CTIndex i = 0; i < placed; i++) {
+            taken[ct_patlak_keywords_slot(
+                keywords,
+                spellings + members[i],
+                seed)] = false;
+        }
+    }
+    ct_expect(false, "Could not place the keywords!");
+}
+
+/* Keyword table of the spellings, which must be different from each other.
+ * Keeps views to the spellings, so they should live as long as the table. */
+CTPatlakKeywords ct_patlak_keywords(CTString const* spellings, CTIndex count)
+{
+    CTPatlakKeywords keywords = {.size = count};
+    if (count == 0) {
+        return keywords;
+    }
+    keywords.spellings =
+        ct_memory_allocate(CT_MEMORY_KEYWORDS, count, sizeof(CTString));
+    keywords.seeds =
+        ct_memory_allocate(CT_MEMORY_KEYWORDS, count, sizeof(int32_t));
+    CTIndex* pairs =
+        ct_memory_allocate(CT_MEMORY_KEYWORDS, 2 * count, sizeof(CTIndex));
+    CTIndex* sizes =
+        ct_memory_allocate(CT_MEMORY_KEYWORDS, count, sizeof(CTIndex));
+    CTIndex* members =
+        ct_memory_allocate(CT_MEMORY_KEYWORDS, count, sizeof(CTIndex));
+    bool* taken = ct_memory_allocate(CT_MEMORY_KEYWORDS, count, sizeof(bool));
+
+    // Order the spellings by the size of their bucket, then by the bucket.
+    for (CTIndex i = 0; i < count; i++) {
+        sizes[ct_patlak_keywords_bucket(&keywords, spellings + i)]++;
+    }
+    for (CTIndex i = 0; i < count; i++) {
+        CTIndex bucket = ct_patlak_keywords_bucket(&keywords, spellings + i);
+        pairs[2 * i]     = sizes[bucket] * count + bucket;
+        pairs[2 * i + 1] = i;
+    }
+    qsort(pairs, count, 2 * sizeof(CTIndex), &ct_patlak_keywords_compare);
+
+    // Buckets with many spellings are the hardest to place; so, place them
+    // while most slots are free, and put the single ones to the rest.
+    CTIndex free_slot = 0;
+    for (CTIndex i = 0; i < count;) {
+        CTIndex bucket = pairs[2 * i] % count;
+        CTIndex amount = sizes[bucket];
+        for (CTIndex j = 0; j < amount; j++) {
+            members[j] = pairs[2 * (i + j) + 1];
+            for (CTIndex k = 0; k < j; k++) {
+                ct_expect(
+                    !ct_string_equal(
+                        spellings + members[k],
+                        spellings + members[j]),
+                    "Keyword is repeated!");
+            }
+        }
+        if (amount > 1) {
+            ct_patlak_keywords_place(
+                &keywords,
+                spellings,
+                members,
+                amount,
+                taken);
+        } else {
+            while (taken[free_slot]) {
+                free_slot++;
+            }
+            taken[free_slot]              = true;
+            keywords.spellings[free_slot] = spellings[members[0]];
+            keywords.seeds[bucket]        = (int32_t)(-free_slot - 1);
+        }
+        i += amount;
+    }
+
+    ct_memory_free(CT_MEMORY_KEYWORDS, pairs, 2 * count, sizeof(CTIndex));
+    ct_memory_free(CT_MEMORY_KEYWORDS, sizes, count, sizeof(CTIndex));
+    ct_memory_free(CT_MEMORY_KEYWORDS, members, count, sizeof(CTIndex));
+    ct_memory_free(CT_MEMORY_KEYWORDS, taken, count, sizeof(bool));
+    return keywords;
+}
+
+/* Slot of the keyword with the spelling. Returns negative if the word is not
+ * a keyword. */
+CTIndex
+ct_patlak_keywords_find(CTPatlakKeywords const* keywords, CTString const* word)
+{
+    if (keywords->size == 0) {
+        return -1;
+    }
+    int32_t seed = keywords->seeds[ct_patlak_keywords_bucket(keywords, word)];
+    if (seed == 0) {
+        return -1;
+    }
+    CTIndex slot = seed < 0 ? -(CTIndex)seed - 1
+                            : ct_patlak_keywords_slot(keywords, word, seed);
+    return ct_string_equal(keywords->spellings + slot, word) ? slot : -1;
+}
+
+/* Deallocate memory. */
+void ct_patlak_keywords_free(CTPatlakKeywords* keywords)
+{
+    ct_memory_free(
+        CT_MEMORY_KEYWORDS,
+        keywords->spellings,
+        keywords->size,
+        sizeof(CTString));
+    ct_memory_free(
+        CT_MEMORY_KEYWORDS,
+        keywords->seeds,
+        keywords->size,
+        sizeof(int32_t));
+    keywords->spellings = NULL;
+    keywords->seeds     = NULL;
+    keywords->size      = 0;
+}
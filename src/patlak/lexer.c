@@ -3,11 +3,23 @@
 
 #pragma once
 
+#include "patlak/compact.c"
+#include "patlak/keywords.c"
+#include "patlak/structure.c"
 #include "patlak/token.c"
+#include "prelude/buffer.c"
 #include "prelude/expect.c"
+#include "prelude/lines.c"
 #include "prelude/split.c"
 #include "prelude/string.c"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Amount of tokens that are collected before moving them to compact tokens. */
+#define CT_PATLAK_LEXER_BATCH 256
+
 /* Try to lex a punctuation mark. */
 bool ct_patlak_lexer_mark(CTPatlakTokens* tokens, CTString* pattern)
 {
@@ -26,16 +38,18 @@ bool ct_patlak_lexer_mark(CTPatlakTokens* tokens, CTString* pattern)
     return true;
 }
 
-/* Whether the character is not part of a number. */
-bool ct_patlak_lexer_not_number(char character)
-{
-    return character < '0' || character > '9';
-}
-
 /* Try to lex a number. */
-bool ct_patlak_lexer_number(CTPatlakTokens* tokens, CTString* pattern)
+bool ct_patlak_lexer_number(
+    CTPatlakTokens*    tokens,
+    CTString*          pattern,
+    CTPatlakStructure* structure)
 {
-    CTSplit split = ct_split_first_fit(pattern, &ct_patlak_lexer_not_number);
+    CTSplit split = ct_split_position(
+        pattern,
+        ct_patlak_structure_first_not(
+            structure,
+            pattern,
+            CT_PATLAK_CLASS_DIGIT));
     if (!ct_string_finite(&split.before)) {
         return false;
     }
@@ -46,29 +60,41 @@ bool ct_patlak_lexer_number(CTPatlakTokens* tokens, CTString* pattern)
     return true;
 }
 
-/* Try to lex a quote. */
-bool ct_patlak_lexer_quote(CTPatlakTokens* tokens, CTString* pattern)
+/* Print that the quote at the start of the rest of the source is not closed
+ * with its line and column, and abort. */
+void ct_patlak_lexer_unclosed(char const* source, CTString const* rest)
+{
+    CTString   whole    = {.first = source, .last = rest->last};
+    CTLines    lines    = ct_lines(whole);
+    CTLocation location = ct_lines_locate_position(&lines, rest->first);
+    fprintf(
+        stderr,
+        "%td:%td: error: No closing quote!\n",
+        location.line,
+        location.column);
+    abort();
+}
+
+/* Try to lex a quote, which ends at the end of its line. A quote that is not
+ * closed is reported with its location in the source if there is one. */
+bool ct_patlak_lexer_quote(
+    CTPatlakTokens*    tokens,
+    CTString*          pattern,
+    CTPatlakStructure* structure,
+    char const*        source)
 {
     if (!ct_string_starts(pattern, '\'')) {
         return false;
     }
-    char const* end = pattern->first + 1;
-    while (end < pattern->last) {
-        switch (*end) {
-            case '\'':
-                end++;
-                break;
-            case '\\':
-                end++;
-            default:
-                end++;
-                continue;
-        }
-        break;
+    bool    closed = false;
+    CTSplit split  = ct_split_position(
+        pattern,
+        ct_patlak_structure_quote_end(structure, pattern, &closed));
+    if (!closed && source != NULL) {
+        ct_patlak_lexer_unclosed(source, pattern);
     }
-    CTSplit split = ct_split_position(pattern, end);
+    ct_expect(closed, "No closing quote!");
     ct_expect(ct_string_size(&split.before) > 2, "Quote is empty!");
-    ct_expect(ct_string_finishes(&split.before, '\''), "No closing quote!");
     ct_patlak_tokens_add(
         tokens,
         (CTPatlakToken){.type = CT_PATLAK_TOKEN_QUOTE, .value = split.before});
@@ -76,18 +102,18 @@ bool ct_patlak_lexer_quote(CTPatlakTokens* tokens, CTString* pattern)
     return true;
 }
 
-/* Whether the character is not part of an identifier. */
-bool ct_patlak_lexer_not_identifier(char character)
-{
-    return (character < 'a' || character > 'z') &&
-           (character < 'A' || character > 'Z') && character != '_';
-}
-
 /* Try to lex a identifier. */
-bool ct_patlak_lexer_identifier(CTPatlakTokens* tokens, CTString* pattern)
+bool ct_patlak_lexer_identifier(
+    CTPatlakTokens*    tokens,
+    CTString*          pattern,
+    CTPatlakStructure* structure)
 {
-    CTSplit split =
-        ct_split_first_fit(pattern, &ct_patlak_lexer_not_identifier);
+    CTSplit split = ct_split_position(
+        pattern,
+        ct_patlak_structure_first_not(
+            structure,
+            pattern,
+            CT_PATLAK_CLASS_LETTER));
     if (!ct_string_finite(&split.before)) {
         return false;
     }
@@ -100,12 +126,6 @@ bool ct_patlak_lexer_identifier(CTPatlakTokens* tokens, CTString* pattern)
     return true;
 }
 
-/* Whether the character is not whitespace. */
-bool ct_patlak_lexer_not_whitespace(char character)
-{
-    return character != '\t' && character != '\n' && character != ' ';
-}
-
 /* Lex away an unknown token. When unkown token appears, lex character by
  * character with -1 for unkown token type. */
 void ct_patlak_lexer_unkown(CTPatlakTokens* tokens, CTString* pattern)
@@ -117,18 +137,26 @@ void ct_patlak_lexer_unkown(CTPatlakTokens* tokens, CTString* pattern)
     *pattern = split.after;
 }
 
-/* Lex the next token. */
-void ct_patlak_lexer_next(CTPatlakTokens* tokens, CTString* pattern)
+/* Lex the next token. The structure must be of the pattern. */
+void ct_patlak_lexer_next(
+    CTPatlakTokens*    tokens,
+    CTString*          pattern,
+    CTPatlakStructure* structure)
 {
     // Trim the whitespace at the begining.
-    pattern->first =
-        ct_string_first_fit(pattern, &ct_patlak_lexer_not_whitespace);
+    pattern->first = ct_patlak_structure_first_not(
+        structure,
+        pattern,
+        CT_PATLAK_CLASS_WHITESPACE);
+    if (!ct_string_finite(pattern)) {
+        return;
+    }
 
     // If cannot lex any of these in the given order, the token is unknown.
     if (!ct_patlak_lexer_mark(tokens, pattern) &&
-        !ct_patlak_lexer_number(tokens, pattern) &&
-        !ct_patlak_lexer_quote(tokens, pattern) &&
-        !ct_patlak_lexer_identifier(tokens, pattern)) {
+        !ct_patlak_lexer_number(tokens, pattern, structure) &&
+        !ct_patlak_lexer_quote(tokens, pattern, structure, NULL) &&
+        !ct_patlak_lexer_identifier(tokens, pattern, structure)) {
         ct_patlak_lexer_unkown(tokens, pattern);
     }
 }
@@ -136,7 +164,379 @@ void ct_patlak_lexer_next(CTPatlakTokens* tokens, CTString* pattern)
 /* Lex the pattern and add its tokens to the list. */
 void ct_patlak_lexer(CTPatlakTokens* tokens, CTString pattern)
 {
+    CTPatlakStructure structure = {0};
     while (ct_string_finite(&pattern)) {
-        ct_patlak_lexer_next(tokens, &pattern);
+        ct_patlak_lexer_next(tokens, &pattern, &structure);
+    }
+}
+
+/* Try to lex a line feed. */
+bool ct_patlak_lexer_newline(CTPatlakTokens* tokens, CTString* file)
+{
+    if (!ct_string_starts(file, '\n')) {
+        return false;
+    }
+    CTSplit split = ct_split(file, 1);
+    ct_patlak_tokens_add(
+        tokens,
+        (CTPatlakToken){.type = CT_PATLAK_TOKEN_NEWLINE, .value = split.before});
+    *file = split.after;
+    return true;
+}
+
+/* Try to lex a comment. */
+bool ct_patlak_lexer_comment(
+    CTPatlakTokens*    tokens,
+    CTString*          file,
+    CTPatlakStructure* structure)
+{
+    if (ct_string_size(file) < 2 || ct_string_at(file, 0) != '/' ||
+        ct_string_at(file, 1) != '/') {
+        return false;
+    }
+    CTSplit split = ct_split_position(
+        file,
+        ct_patlak_structure_first(
+            structure,
+            file,
+            CT_PATLAK_CLASS_NEWLINE));
+    ct_patlak_tokens_add(
+        tokens,
+        (CTPatlakToken){.type = CT_PATLAK_TOKEN_COMMENT, .value = split.before});
+    *file = split.after;
+    return true;
+}
+
+/* Try to lex a keyword. The whole word is looked up with a single probe to
+ * the table; so, keywords with digits like "int32" are a single token. */
+bool ct_patlak_lexer_keyword(
+    CTPatlakTokens*         tokens,
+    CTString*               file,
+    CTPatlakKeywords const* keywords,
+    CTPatlakStructure*      structure)
+{
+    if (keywords == NULL ||
+        !ct_patlak_structure_starts(structure, file, CT_PATLAK_CLASS_LETTER)) {
+        return false;
+    }
+    CTSplit split = ct_split_position(
+        file,
+        ct_patlak_structure_first_not(
+            structure,
+            file,
+            CT_PATLAK_CLASS_WORD));
+    if (ct_patlak_keywords_find(keywords, &split.before) < 0) {
+        return false;
+    }
+    ct_patlak_tokens_add(
+        tokens,
+        (CTPatlakToken){.type = CT_PATLAK_TOKEN_KEYWORD, .value = split.before});
+    *file = split.after;
+    return true;
+}
+
+/* Lex the next token of a file, which must not start with blanks. The
+ * structure must be of the file, whose first character is at the source. */
+void ct_patlak_lexer_file_next(
+    CTPatlakTokens*         tokens,
+    CTString*               file,
+    CTPatlakKeywords const* keywords,
+    CTPatlakStructure*      structure,
+    char const*             source)
+{
+    // Tokens of different types start with different characters; so, words
+    // and numbers, which are the most common, are found by the class of the
+    // first character without trying the others.
+    if (ct_patlak_structure_starts(structure, file, CT_PATLAK_CLASS_LETTER)) {
+        if (!ct_patlak_lexer_keyword(tokens, file, keywords, structure)) {
+            ct_patlak_lexer_identifier(tokens, file, structure);
+        }
+    } else if (ct_patlak_structure_starts(
+                   structure,
+                   file,
+                   CT_PATLAK_CLASS_DIGIT)) {
+        ct_patlak_lexer_number(tokens, file, structure);
+    } else if (
+        !ct_patlak_lexer_newline(tokens, file) &&
+        !ct_patlak_lexer_comment(tokens, file, structure) &&
+        !ct_patlak_lexer_mark(tokens, file) &&
+        !ct_patlak_lexer_quote(tokens, file, structure, source)) {
+        ct_patlak_lexer_unkown(tokens, file);
+    }
+}
+
+/* Lex the rest of a file, whose first character is at the source, in one
+ * pass and add its tokens to the list. Unlike lexing patterns, line feeds and
+ * comments are tokens. Words in the keyword table are lexed as keywords if
+ * there is a table. Characters are classified a block at a time, so skipping
+ * blanks and comments jumps over them. */
+void ct_patlak_lexer_file_rest(
+    CTPatlakTokens*         tokens,
+    char const*             source,
+    CTString                file,
+    CTPatlakKeywords const* keywords)
+{
+    CTPatlakStructure structure = {0};
+    while (ct_string_finite(&file)) {
+        file.first = ct_patlak_structure_first_not(
+            &structure,
+            &file,
+            CT_PATLAK_CLASS_BLANK);
+        if (!ct_string_finite(&file)) {
+            break;
+        }
+        ct_patlak_lexer_file_next(tokens, &file, keywords, &structure, source);
     }
 }
+
+/* Lex the whole file in one pass and add its tokens to the list. */
+void ct_patlak_lexer_file_keywords(
+    CTPatlakTokens*         tokens,
+    CTString                file,
+    CTPatlakKeywords const* keywords)
+{
+    ct_patlak_lexer_file_rest(tokens, file.first, file, keywords);
+}
+
+/* Lex the whole file in one pass to the compact tokens, which are replaced.
+ * Tokens are collected in a batch that is moved to the compact tokens when it
+ * is full; so, the list of all the tokens is never made. */
+void ct_patlak_lexer_file_compact(
+    CTPatlakCompactTokens*  tokens,
+    CTString                file,
+    CTPatlakKeywords const* keywords)
+{
+    ct_patlak_compact_clear(tokens, file.first);
+    char const*       source    = file.first;
+    CTPatlakStructure structure = {0};
+    CTPatlakTokens    batch     = {0};
+    while (ct_string_finite(&file)) {
+        file.first = ct_patlak_structure_first_not(
+            &structure,
+            &file,
+            CT_PATLAK_CLASS_BLANK);
+        if (!ct_string_finite(&file)) {
+            break;
+        }
+        ct_patlak_lexer_file_next(&batch, &file, keywords, &structure, source);
+        if (ct_patlak_tokens_size(&batch) == CT_PATLAK_LEXER_BATCH) {
+            ct_patlak_compact_add_all(tokens, &batch);
+            ct_patlak_tokens_clear(&batch);
+        }
+    }
+    ct_patlak_compact_add_all(tokens, &batch);
+    ct_patlak_tokens_free(&batch);
+}
+
+/* Lex the loaded part of a file that is still loading, whose first character
+ * is at the source, and add its tokens to the list. Stops before the first
+ * token that reaches the end of the part, or whose word does, because it might
+ * continue in the rest of the file, and leaves the part at it. A word that is
+ * cut might lex shorter; for example, "int3" of "int32" is an identifier and a
+ * number instead of a keyword. */
+void ct_patlak_lexer_file_part(
+    CTPatlakTokens*         tokens,
+    char const*             source,
+    CTString*               part,
+    CTPatlakKeywords const* keywords)
+{
+    CTPatlakStructure structure = {0};
+    while (true) {
+        part->first = ct_patlak_structure_first_not(
+            &structure,
+            part,
+            CT_PATLAK_CLASS_BLANK);
+        if (!ct_string_finite(part)) {
+            break;
+        }
+
+        // Words that reach the end of the part might be longer.
+        if (ct_patlak_structure_starts(
+                &structure,
+                part,
+                CT_PATLAK_CLASS_WORD) &&
+            ct_patlak_structure_first_not(
+                &structure,
+                part,
+                CT_PATLAK_CLASS_WORD) >= part->last) {
+            break;
+        }
+
+        // Quotes that are not closed yet would be reported as errors, unless
+        // their line ended before the end of the part.
+        bool closed = false;
+        if (ct_string_starts(part, '\'') &&
+            ct_patlak_structure_quote_end(&structure, part, &closed) >=
+                part->last &&
+            !closed) {
+            break;
+        }
+
+        CTString before = *part;
+        ct_patlak_lexer_file_next(tokens, part, keywords, &structure, source);
+        if (!ct_string_finite(part)) {
+            tokens->last--;
+            *part = before;
+            break;
+        }
+    }
+}
+
+/* Lex the whole file without keywords. */
+void ct_patlak_lexer_file(CTPatlakTokens* tokens, CTString file)
+{
+    ct_patlak_lexer_file_keywords(tokens, file, NULL);
+}
+
+/* Change to a source. */
+typedef struct {
+    /* Index of the first removed character. */
+    CTIndex offset;
+    /* Amount of removed characters. */
+    CTIndex removed;
+    /* String that is put in place of the removed characters. */
+    CTString inserted;
+} CTPatlakEdit;
+
+/* Move the views of the tokens in the range from the old source to the new
+ * one, where they are the amount of characters further. */
+void ct_patlak_lexer_move(
+    CTPatlakToken*  first,
+    CTPatlakToken*  last,
+    CTString const* old_source,
+    CTString const* new_source,
+    CTIndex         amount)
+{
+    for (CTPatlakToken* i = first; i < last; i++) {
+        CTIndex size = ct_string_size(&i->value);
+        i->value.first =
+            new_source->first + (i->value.first - old_source->first) + amount;
+        i->value.last = i->value.first + size;
+    }
+}
+
+/* Apply the edit to the source, whose tokens are in the list and were lexed
+ * as a file with the keywords. Writes the edited source to the buffer, which
+ * must not hold the source, and returns a view to it. Tokens do not continue
+ * over line feeds; so, lexes again only from the start of the line of the
+ * edit until a token after the edit starts where an old one did, and the rest
+ * of the old tokens are moved. */
+CTString ct_patlak_lexer_edit(
+    CTPatlakTokens*         tokens,
+    CTBuffer*               buffer,
+    CTString const*         source,
+    CTPatlakEdit const*     edit,
+    CTPatlakKeywords const* keywords)
+{
+    ct_expect(
+        edit->offset >= 0 && edit->removed >= 0 &&
+            edit->offset + edit->removed <= ct_string_size(source),
+        "Edit out of source bounds!");
+
+    // Write the edited source.
+    CTIndex inserted = ct_string_size(&edit->inserted);
+    CTIndex change   = inserted - edit->removed;
+    CTIndex size     = ct_string_size(source) + change;
+    CTIndex begining = ct_buffer_size(buffer);
+    ct_buffer_reserve(buffer, size);
+    memcpy(buffer->last, source->first, edit->offset);
+    memcpy(buffer->last + edit->offset, edit->inserted.first, inserted);
+    memcpy(
+        buffer->last + edit->offset + inserted,
+        source->first + edit->offset + edit->removed,
+        ct_string_size(source) - edit->offset - edit->removed);
+    buffer->last += size;
+    CTString whole  = ct_buffer_view(buffer);
+    CTString edited = ct_split(&whole, begining).after;
+
+    // Find the start of the line of the edit, and the first token on it.
+    CTIndex start = edit->offset;
+    while (start > 0 && source->first[start - 1] != '\n') {
+        start--;
+    }
+    CTIndex        count   = ct_patlak_tokens_size(tokens);
+    CTPatlakToken* restart = tokens->first;
+    while (restart < tokens->last &&
+           restart->value.first < source->first + start) {
+        restart++;
+    }
+    CTIndex restart_index = restart - tokens->first;
+
+    // Old tokens that start after the removed characters can be kept.
+    CTPatlakToken* checked = restart;
+    while (checked < tokens->last &&
+           checked->value.first <
+               source->first + edit->offset + edit->removed) {
+        checked++;
+    }
+
+    // Lex as a file until a token after the edit is the same as an old one.
+    CTPatlakStructure structure = {0};
+    CTPatlakTokens    lexed     = {0};
+    CTString          rest      = ct_split(&edited, start).after;
+    CTPatlakToken*    synced    = tokens->last;
+    while (true) {
+        rest.first = ct_patlak_structure_first_not(
+            &structure,
+            &rest,
+            CT_PATLAK_CLASS_BLANK);
+        if (!ct_string_finite(&rest)) {
+            break;
+        }
+        ct_patlak_lexer_file_next(
+            &lexed,
+            &rest,
+            keywords,
+            &structure,
+            edited.first);
+
+        CTPatlakToken const* last     = lexed.last - 1;
+        CTIndex              position = last->value.first - edited.first;
+        if (position < edit->offset + inserted) {
+            continue;
+        }
+        while (checked < tokens->last &&
+               checked->value.first - source->first + change < position) {
+            checked++;
+        }
+        if (checked < tokens->last &&
+            checked->value.first - source->first + change == position &&
+            checked->type == last->type &&
+            ct_string_size(&checked->value) == ct_string_size(&last->value)) {
+            synced = checked;
+            lexed.last--;
+            break;
+        }
+    }
+
+    // Put the lexed tokens between the ones before and after the edit.
+    CTIndex synced_index = synced - tokens->first;
+    CTIndex lexed_size   = ct_patlak_tokens_size(&lexed);
+    CTIndex tail         = count - synced_index;
+    CTIndex growth       = restart_index + lexed_size - synced_index;
+    ct_patlak_tokens_reserve(tokens, growth > 0 ? growth : 0);
+    memmove(
+        tokens->first + restart_index + lexed_size,
+        tokens->first + synced_index,
+        tail * sizeof(CTPatlakToken));
+    memcpy(
+        tokens->first + restart_index,
+        lexed.first,
+        lexed_size * sizeof(CTPatlakToken));
+    tokens->last = tokens->first + restart_index + lexed_size + tail;
+    ct_patlak_lexer_move(
+        tokens->first,
+        tokens->first + restart_index,
+        source,
+        &edited,
+        0);
+    ct_patlak_lexer_move(
+        tokens->first + restart_index + lexed_size,
+        tokens->last,
+        source,
+        &edited,
+        change);
+
+    ct_patlak_tokens_free(&lexed);
+    return edited;
+}
@@ -0,0 +1,488 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "patlak/context.c"
+#include "patlak/lexer.c"
+#include "patlak/matcher.c"
+#include "patlak/token.c"
+#include "prelude/buffer.c"
+#include "prelude/expect.c"
+#include "prelude/memory.c"
+#include "prelude/scalar.c"
+#include "prelude/string.c"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+/* Most amount of parameters a template can have. */
+#define CT_PATLAK_LOADER_PARAMETERS 8
+
+/* Most amount of templates that can be substituted into each other. */
+#define CT_PATLAK_LOADER_DEPTH 64
+
+/* Patterns of a token file, and the order they are tried in while
+ * tokenizing. */
+typedef struct {
+    /* Compiled patterns. */
+    CTPatlakContext context;
+    /* Definitions after substituting the templates, which the patterns keep
+     * views to. */
+    CTBuffer text;
+    /* Names of the patterns in the order. */
+    CTString* order;
+    /* Amount of names in the order. */
+    CTIndex order_size;
+    /* Amount of allocated names. */
+    CTIndex order_capacity;
+    /* Minimal automaton of the order, which is empty if it is not built. */
+    CTPatlakAutomaton automaton;
+} CTPatlakTokenSet;
+
+/* Pattern definition in a token file. */
+typedef struct {
+    /* Name of the pattern. */
+    CTString name;
+    /* Whether the definition is a template. */
+    bool template;
+    /* Names of the parameters of the template. */
+    CTString parameters[CT_PATLAK_LOADER_PARAMETERS];
+    /* Amount of parameters of the template. */
+    CTIndex parameter_count;
+    /* Border before the first token of the units. */
+    CTPatlakToken const* first;
+    /* Border after the last token of the units. */
+    CTPatlakToken const* last;
+} CTPatlakDefinition;
+
+/* Arguments that are substituted for the parameters of a template. */
+typedef struct CTPatlakBindings {
+    /* Names of the parameters. */
+    CTString const* names;
+    /* Amount of parameters. */
+    CTIndex count;
+    /* Border before the first token of each argument. */
+    CTPatlakToken const* firsts[CT_PATLAK_LOADER_PARAMETERS];
+    /* Border after the last token of each argument. */
+    CTPatlakToken const* lasts[CT_PATLAK_LOADER_PARAMETERS];
+    /* Bindings the arguments are substituted with. */
+    struct CTPatlakBindings const* outer;
+} CTPatlakBindings;
+
+/* Information while loading a token file. */
+typedef struct {
+    /* Tokens of the file. */
+    CTPatlakTokens tokens;
+    /* Border before the first definition. */
+    CTPatlakDefinition* first;
+    /* Border after the last definition. */
+    CTPatlakDefinition* last;
+    /* Border after the last allocated definition. */
+    CTPatlakDefinition* allocated;
+    /* Amount of templates that are being substituted. */
+    CTIndex depth;
+} CTPatlakLoader;
+
+/* Add to the end of definitions. */
+void ct_patlak_loader_add(CTPatlakLoader* loader, CTPatlakDefinition definition)
+{
+    if (loader->last == loader->allocated) {
+        CTIndex size     = loader->last - loader->first;
+        CTIndex capacity = size < 8 ? 16 : size * 2;
+        CTPatlakDefinition* memory = ct_memory_resize(
+            CT_MEMORY_PATTERNS,
+            loader->first,
+            loader->allocated - loader->first,
+            capacity,
+            sizeof(CTPatlakDefinition));
+        loader->first     = memory;
+        loader->last      = memory + size;
+        loader->allocated = memory + capacity;
+    }
+    *loader->last++ = definition;
+}
+
+/* Whether the token is a line feed or a comment. */
+bool ct_patlak_loader_trivial(CTPatlakToken const* token)
+{
+    return token->type == CT_PATLAK_TOKEN_NEWLINE ||
+           token->type == CT_PATLAK_TOKEN_COMMENT;
+}
+
+/* First token at or after the token that is not a comment. Line feeds are
+ * kept, because definitions are separated by lines. */
+CTPatlakToken const*
+ct_patlak_loader_uncommented(CTPatlakLoader const* loader, CTPatlakToken const* i)
+{
+    while (i < loader->tokens.last && i->type == CT_PATLAK_TOKEN_COMMENT) {
+        i++;
+    }
+    return i;
+}
+
+/* First token at or after the token that is not a line feed or a comment. */
+CTPatlakToken const*
+ct_patlak_loader_skip(CTPatlakLoader const* loader, CTPatlakToken const* i)
+{
+    while (i < loader->tokens.last && ct_patlak_loader_trivial(i)) {
+        i++;
+    }
+    return i;
+}
+
+/* Whether the token is the mark. Marks that are not in patterns, like the
+ * angle brackets, are lexed as unknown tokens. */
+bool ct_patlak_loader_mark(
+    CTPatlakLoader const* loader,
+    CTPatlakToken const*  token,
+    char                  mark)
+{
+    return token < loader->tokens.last &&
+           token->type != CT_PATLAK_TOKEN_QUOTE &&
+           ct_string_size(&token->value) == 1 && *token->value.first == mark;
+}
+
+/* Token after the angle bracket that closes the one at the token. */
+CTPatlakToken const*
+ct_patlak_loader_close(CTPatlakLoader const* loader, CTPatlakToken const* i)
+{
+    CTIndex depth = 0;
+    do {
+        ct_expect(i < loader->tokens.last, "Unclosed angle bracket!");
+        depth += ct_patlak_loader_mark(loader, i, '<');
+        depth -= ct_patlak_loader_mark(loader, i, '>');
+        i++;
+    } while (depth > 0);
+    return i;
+}
+
+/* Whether a definition starts at the token, which is a name followed by
+ * the equal sign, maybe with template parameters in between. */
+bool ct_patlak_loader_defines(
+    CTPatlakLoader const* loader,
+    CTPatlakToken const*  i)
+{
+    if (i >= loader->tokens.last || i->type != CT_PATLAK_TOKEN_IDENTIFIER) {
+        return false;
+    }
+    i = ct_patlak_loader_uncommented(loader, i + 1);
+    if (ct_patlak_loader_mark(loader, i, '<')) {
+        i = ct_patlak_loader_uncommented(
+            loader,
+            ct_patlak_loader_close(loader, i));
+    }
+    return i < loader->tokens.last && i->type == CT_PATLAK_TOKEN_EQUAL;
+}
+
+/* Parse the definition at the token. Returns the token after it, which is
+ * the first one of the line that starts the next definition or the order. */
+CTPatlakToken const*
+ct_patlak_loader_definition(CTPatlakLoader* loader, CTPatlakToken const* i)
+{
+    CTPatlakDefinition definition = {.name = i->value};
+    i = ct_patlak_loader_uncommented(loader, i + 1);
+
+    if (ct_patlak_loader_mark(loader, i, '<')) {
+        definition.template = true;
+        i = ct_patlak_loader_skip(loader, i + 1);
+        while (!ct_patlak_loader_mark(loader, i, '>')) {
+            ct_expect(
+                definition.parameter_count < CT_PATLAK_LOADER_PARAMETERS,
+                "Too many template parameters!");
+            ct_expect(
+                i < loader->tokens.last &&
+                    i->type == CT_PATLAK_TOKEN_IDENTIFIER,
+                "Expected a template parameter!");
+            definition.parameters[definition.parameter_count++] = i->value;
+            i = ct_patlak_loader_skip(loader, i + 1);
+            if (i < loader->tokens.last && i->type == CT_PATLAK_TOKEN_COMMA) {
+                i = ct_patlak_loader_skip(loader, i + 1);
+            }
+        }
+        i = ct_patlak_loader_uncommented(loader, i + 1);
+    }
+    ct_expect(
+        i < loader->tokens.last && i->type == CT_PATLAK_TOKEN_EQUAL,
+        "Expected an equal sign!");
+
+    // Units continue until a line starts another definition or the order.
+    definition.first = i + 1;
+    for (i = definition.first; i < loader->tokens.last; i++) {
+        if (i->type != CT_PATLAK_TOKEN_NEWLINE) {
+            continue;
+        }
+        CTPatlakToken const* next = ct_patlak_loader_skip(loader, i);
+        if (ct_patlak_loader_defines(loader, next) ||
+            ct_patlak_loader_mark(loader, next, '[')) {
+            break;
+        }
+    }
+    definition.last = i;
+    ct_patlak_loader_add(loader, definition);
+    return ct_patlak_loader_skip(loader, i);
+}
+
+/* Template with the name. */
+CTPatlakDefinition const*
+ct_patlak_loader_template(CTPatlakLoader const* loader, CTString const* name)
+{
+    for (CTPatlakDefinition const* i = loader->first; i < loader->last; i++) {
+        if (i->template && ct_string_equal(&i->name, name)) {
+            return i;
+        }
+    }
+    ct_expect(false, "Template does not exist!");
+    return NULL;
+}
+
+/* Add the token to the text, separating it from the next one. */
+void ct_patlak_loader_write(CTBuffer* text, CTString const* string)
+{
+    CTString const separator = ct_string_terminated(" ");
+    ct_buffer_append(text, string);
+    ct_buffer_append(text, &separator);
+}
+
+/* Add the tokens to the text with the templates and the parameters
+ * substituted. Substitutions are put in a group, so they are not mixed with
+ * the units around them. */
+void ct_patlak_loader_expand(
+    CTPatlakLoader*         loader,
+    CTBuffer*               text,
+    CTPatlakToken const*    first,
+    CTPatlakToken const*    last,
+    CTPatlakBindings const* bindings)
+{
+    CTString const open  = ct_string_terminated("{");
+    CTString const close = ct_string_terminated("}");
+    ct_expect(
+        loader->depth++ < CT_PATLAK_LOADER_DEPTH,
+        "Templates are substituted too deeply!");
+
+    for (CTPatlakToken const* i = first; i < last; i++) {
+        if (ct_patlak_loader_trivial(i)) {
+            continue;
+        }
+        if (i->type != CT_PATLAK_TOKEN_IDENTIFIER) {
+            ct_patlak_loader_write(text, &i->value);
+            continue;
+        }
+
+        // Names of the captures are not substituted.
+        if (ct_patlak_loader_mark(loader, i + 1, ':')) {
+            ct_patlak_loader_write(text, &i->value);
+            continue;
+        }
+
+        // Substitute the argument of the parameter.
+        CTIndex parameter = 0;
+        while (parameter < bindings->count &&
+               !ct_string_equal(bindings->names + parameter, &i->value)) {
+            parameter++;
+        }
+        if (parameter < bindings->count) {
+            ct_patlak_loader_write(text, &open);
+            ct_patlak_loader_expand(
+                loader,
+                text,
+                bindings->firsts[parameter],
+                bindings->lasts[parameter],
+                bindings->outer);
+            ct_patlak_loader_write(text, &close);
+            continue;
+        }
+
+        CTPatlakToken const* after = ct_patlak_loader_skip(loader, i + 1);
+        if (after >= last || !ct_patlak_loader_mark(loader, after, '<')) {
+            ct_patlak_loader_write(text, &i->value);
+            continue;
+        }
+
+        // Substitute the template with the arguments, which are separated by
+        // commas that are not in any brackets.
+        CTPatlakDefinition const* template =
+            ct_patlak_loader_template(loader, &i->value);
+        CTPatlakBindings arguments = {
+            .names = template->parameters,
+            .outer = bindings};
+        CTPatlakToken const* end      = ct_patlak_loader_close(loader, after) - 1;
+        CTPatlakToken const* argument = after + 1;
+        CTIndex              depth    = 0;
+        for (CTPatlakToken const* j = after + 1; j <= end; j++) {
+            if ((j == end || (depth == 0 && j->type == CT_PATLAK_TOKEN_COMMA)) &&
+                ct_patlak_loader_skip(loader, argument) < j) {
+                ct_expect(
+                    arguments.count < CT_PATLAK_LOADER_PARAMETERS,
+                    "Too many template arguments!");
+                arguments.firsts[arguments.count] = argument;
+                arguments.lasts[arguments.count]  = j;
+                arguments.count++;
+                argument = j + 1;
+                continue;
+            }
+            depth += ct_patlak_loader_mark(loader, j, '<') ||
+                     ct_patlak_loader_mark(loader, j, '{') ||
+                     ct_patlak_loader_mark(loader, j, '[');
+            depth -= ct_patlak_loader_mark(loader, j, '>') ||
+                     ct_patlak_loader_mark(loader, j, '}') ||
+                     ct_patlak_loader_mark(loader, j, ']');
+        }
+        ct_expect(
+            arguments.count == template->parameter_count,
+            "Wrong amount of template arguments!");
+
+        ct_patlak_loader_write(text, &open);
+        ct_patlak_loader_expand(
+            loader,
+            text,
+            template->first,
+            template->last,
+            &arguments);
+        ct_patlak_loader_write(text, &close);
+        i = end;
+    }
+
+    loader->depth--;
+}
+
+/* Parse the order at the token, which are the names in square brackets. */
+void ct_patlak_loader_order(
+    CTPatlakLoader*      loader,
+    CTPatlakTokenSet*    set,
+    CTPatlakToken const* i)
+{
+    CTIndex capacity = 0;
+    for (CTPatlakToken const* j = i; j < loader->tokens.last; j++) {
+        capacity += j->type == CT_PATLAK_TOKEN_IDENTIFIER;
+    }
+    set->order =
+        ct_memory_allocate(CT_MEMORY_PATTERNS, capacity, sizeof(CTString));
+    set->order_capacity = capacity;
+
+    i = ct_patlak_loader_skip(loader, i + 1);
+    while (!ct_patlak_loader_mark(loader, i, ']')) {
+        ct_expect(
+            i < loader->tokens.last && i->type == CT_PATLAK_TOKEN_IDENTIFIER,
+            "Expected a pattern name in the order!");
+
+        // Keep the name of the pattern, which lives as long as the set.
+        set->order[set->order_size++] =
+            ct_patlak_patterns_information(&set->context.patterns, &i->value)
+                ->name;
+        i = ct_patlak_loader_skip(loader, i + 1);
+        if (i < loader->tokens.last && i->type == CT_PATLAK_TOKEN_COMMA) {
+            i = ct_patlak_loader_skip(loader, i + 1);
+        }
+    }
+    ct_expect(
+        ct_patlak_loader_skip(loader, i + 1) == loader->tokens.last,
+        "Unexpected tokens after the order!");
+}
+
+/* Load the token file to the set, which must be empty. Templates are
+ * substituted as text before compiling the patterns. The file is only needed
+ * while loading. */
+void ct_patlak_load(CTPatlakTokenSet* set, CTString file)
+{
+    CTPatlakLoader loader = {0};
+    ct_patlak_lexer_file(&loader.tokens, file);
+
+    CTPatlakToken const* i = ct_patlak_loader_skip(&loader, loader.tokens.first);
+    while (i < loader.tokens.last && !ct_patlak_loader_mark(&loader, i, '[')) {
+        ct_expect(
+            ct_patlak_loader_defines(&loader, i),
+            "Expected a pattern definition!");
+        i = ct_patlak_loader_definition(&loader, i);
+    }
+
+    // Write all the definitions before compiling, so the views of the patterns
+    // to the text do not move.
+    CTPatlakBindings const none   = {0};
+    CTString const         equal  = ct_string_terminated("=");
+    CTIndex                count  = 2 * (loader.last - loader.first) + 1;
+    CTIndex*               bounds =
+        ct_memory_allocate(CT_MEMORY_PATTERNS, count, sizeof(CTIndex));
+    CTIndex defined = 0;
+    for (CTPatlakDefinition const* j = loader.first; j < loader.last; j++) {
+        if (j->template) {
+            continue;
+        }
+        bounds[2 * defined] = ct_buffer_size(&set->text);
+        ct_patlak_loader_write(&set->text, &j->name);
+        ct_patlak_loader_write(&set->text, &equal);
+        ct_patlak_loader_expand(&loader, &set->text, j->first, j->last, &none);
+        bounds[2 * defined + 1] = ct_buffer_size(&set->text);
+        defined++;
+    }
+    for (CTIndex j = 0; j < defined; j++) {
+        CTString definition = {
+            .first = set->text.first + bounds[2 * j],
+            .last  = set->text.first + bounds[2 * j + 1]};
+        ct_patlak_compile(&set->context, &definition);
+    }
+    ct_memory_free(CT_MEMORY_PATTERNS, bounds, count, sizeof(CTIndex));
+
+    if (i < loader.tokens.last) {
+        ct_patlak_loader_order(&loader, set, i);
+    }
+
+    ct_memory_free(
+        CT_MEMORY_PATTERNS,
+        loader.first,
+        loader.allocated - loader.first,
+        sizeof(CTPatlakDefinition));
+    ct_patlak_tokens_free(&loader.tokens);
+}
+
+/* Build the minimal automaton of the order, so the next token is found in a
+ * single pass over the input. Should be called after optimizing the context.
+ * Returns false if the order cannot be built, and the set keeps matching the
+ * patterns one by one. */
+bool ct_patlak_token_set_automate(CTPatlakTokenSet* set)
+{
+    ct_patlak_automaton_free(&set->automaton);
+    return ct_patlak_automate(
+        &set->context,
+        set->order,
+        set->order_size,
+        &set->automaton);
+}
+
+/* Match the first pattern in the order to the input using the memory of the
+ * matcher. Returns the match, and sets the index of the pattern in the order.
+ * Empty match means none of them matched. Uses the automaton if it is built,
+ * which gives the shortest match of the pattern. */
+CTString ct_patlak_token_set_next(
+    CTPatlakTokenSet const* set,
+    CTPatlakMatcher*        matcher,
+    CTString const*         input,
+    CTIndex*                token)
+{
+    if (set->automaton.transitions != NULL) {
+        return ct_patlak_automaton_match(&set->automaton, input, token);
+    }
+    return ct_patlak_match_first(
+        &set->context,
+        matcher,
+        set->order,
+        set->order_size,
+        input,
+        token);
+}
+
+/* Deallocate memory. */
+void ct_patlak_token_set_free(CTPatlakTokenSet* set)
+{
+    ct_patlak_free(&set->context);
+    ct_patlak_automaton_free(&set->automaton);
+    ct_buffer_free(&set->text);
+    ct_memory_free(
+        CT_MEMORY_PATTERNS,
+        set->order,
+        set->order_capacity,
+        sizeof(CTString));
+    set->order          = NULL;
+    set->order_size     = 0;
+    set->order_capacity = 0;
+}
@@ -0,0 +1,199 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "patlak/code.c"
+#include "patlak/state.c"
+#include "prelude/expect.c"
+#include "prelude/memory.c"
+#include "prelude/scalar.c"
+
+#include <stdlib.h>
+
+/* Most amount of states a matcher reserves for a position. Codes whose
+ * counters can tell apart more states than this allocate while matching. */
+#define CT_PATLAK_MATCHER_STATES (1 << 12)
+
+/* Amount of memory a matcher reserves, so matching with the codes does not
+ * allocate. */
+typedef struct {
+    /* States at a position, which are each code with each value of the
+     * counters. */
+    CTIndex states;
+    /* States that are pushed at a position, which are each way to go on from
+     * each of the states. */
+    CTIndex pushes;
+    /* States that wait in the pending states, which are the ones after a
+     * string for each position of the string, and the ones after a
+     * reference. */
+    CTIndex waiting;
+    /* Records of the tags at a position, which are the copies of the records
+     * of the states and the records of the tags. Zero if the codes do not
+     * have tags. */
+    CTIndex records;
+    /* Amount of deeper matchers for the references in the references. */
+    CTIndex depth;
+} CTPatlakMatcherBound;
+
+/* Memory that is reused while decoding. Decoding goes over the input one
+ * position at a time, and all the states at a position wait for the same
+ * character. Each reference that is decoded separately uses the matcher of the
+ * next depth. A matcher should be used by one thread at a time, while the
+ * codes can be shared by all of them. */
+typedef struct CTPatlakMatcher {
+    /* States at the current position, in the order of their priority. */
+    CTPatlakStates active;
+    /* States at the position after the current one. */
+    CTPatlakStates next;
+    /* States that matched a reference, which wait for the position after
+     * it. */
+    CTPatlakStates pending;
+    /* States that are not decoded yet at the current position. */
+    CTPatlakStates stack;
+    /* States that were decoded at the current position. */
+    CTPatlakVisits visits;
+    /* Memory that is reserved by this and the deeper matchers. */
+    CTPatlakMatcherBound bound;
+    /* Matcher of the references. */
+    struct CTPatlakMatcher* deeper;
+    /* Records of the tags the states passed at the current position. */
+    CTPatlakTags tags;
+    /* Records of the tags at the previous position, which are copied to the
+     * current records if a state still points to them. */
+    CTPatlakTags previous;
+    /* Record of the tags of the state that matched last. */
+    int matched;
+} CTPatlakMatcher;
+
+/* Product of the amounts, or the most amount of states if it is more. */
+CTIndex ct_patlak_matcher_multiply(CTIndex lhs, CTIndex rhs)
+{
+    if (lhs > CT_PATLAK_MATCHER_STATES / rhs) {
+        return CT_PATLAK_MATCHER_STATES;
+    }
+    return lhs * rhs;
+}
+
+/* Memory a matcher of the codes needs, with the amount of deeper matchers.
+ * States at a position are decoded once for each code and counters; so, the
+ * amounts are bound by the codes. Only the states that wait after the
+ * references for longer than a position, and the references that recur more
+ * than the depth, might allocate while matching. */
+CTPatlakMatcherBound
+ct_patlak_matcher_bound(CTPatlakCodes const* codes, CTIndex depth)
+{
+    CTPatlakMatcherBound bound = {.depth = depth};
+    CTIndex              values[CT_PATLAK_STATE_COUNTERS] = {1, 1, 1, 1};
+    CTIndex              tags                             = 0;
+    for (CTPatlakCode const* i = codes->first; i < codes->last; i++) {
+        bound.states++;
+        switch (i->type) {
+            case CT_PATLAK_CODE_STRING:
+                bound.waiting += i->length;
+                bound.pushes++;
+                break;
+            case CT_PATLAK_CODE_BRANCH:
+                bound.pushes += i->branches;
+                break;
+            case CT_PATLAK_CODE_REPEAT: {
+                // Counters go up to the maximum, or to the minimum if there is
+                // not one.
+                CTIndex most = (i->maximum >= 0 ? i->maximum : i->minimum) + 1;
+                if (values[i->counter] < most) {
+                    values[i->counter] = most;
+                }
+                bound.pushes += 2;
+            } break;
+            case CT_PATLAK_CODE_REFERANCE:
+                bound.waiting++;
+                bound.pushes++;
+                break;
+            case CT_PATLAK_CODE_TAG:
+                tags++;
+                bound.pushes++;
+                break;
+            default:
+                bound.pushes++;
+        }
+    }
+    for (int i = 0; i < CT_PATLAK_STATE_COUNTERS; i++) {
+        bound.states = ct_patlak_matcher_multiply(bound.states, values[i]);
+        bound.pushes = ct_patlak_matcher_multiply(bound.pushes, values[i]);
+        bound.waiting = ct_patlak_matcher_multiply(bound.waiting, values[i]);
+        tags = ct_patlak_matcher_multiply(tags, values[i]);
+    }
+
+    // The stack also gets the states that start the position one by one.
+    bound.pushes++;
+    if (tags > 0) {
+        bound.records = bound.states + bound.waiting + tags;
+    }
+    return bound;
+}
+
+/* Matcher that reserves the memory of the bound, and deeper matchers for the
+ * depth of it. */
+CTPatlakMatcher ct_patlak_matcher_presized(CTPatlakMatcherBound bound)
+{
+    CTPatlakMatcher matcher = {.bound = bound};
+    // Active and next states change places after each position.
+    ct_patlak_states_reserve(&matcher.active, bound.states + bound.waiting);
+    ct_patlak_states_reserve(&matcher.next, bound.states + bound.waiting);
+    ct_patlak_states_reserve(&matcher.pending, bound.waiting);
+    ct_patlak_states_reserve(&matcher.stack, bound.pushes);
+    ct_patlak_visits_reserve(&matcher.visits, bound.states);
+    ct_patlak_tags_reserve(&matcher.tags, bound.records);
+    ct_patlak_tags_reserve(&matcher.previous, bound.records);
+    if (bound.depth > 0) {
+        CTPatlakMatcherBound deeper = bound;
+        deeper.depth--;
+        matcher.deeper =
+            ct_memory_allocate(CT_MEMORY_STATES, 1, sizeof(CTPatlakMatcher));
+        *matcher.deeper = ct_patlak_matcher_presized(deeper);
+    }
+    return matcher;
+}
+
+/* Matcher for the codes, whose references are decoded inside each other at
+ * most the depth amount of times. */
+CTPatlakMatcher ct_patlak_matcher(CTPatlakCodes const* codes, CTIndex depth)
+{
+    return ct_patlak_matcher_presized(ct_patlak_matcher_bound(codes, depth));
+}
+
+/* Matcher of the next depth. Deeper matchers than the depth of the bound are
+ * created the first time they are needed, which only happens when a
+ * reference recurs. */
+CTPatlakMatcher* ct_patlak_matcher_deeper(CTPatlakMatcher* matcher)
+{
+    if (matcher->deeper == NULL) {
+        CTPatlakMatcherBound deeper = matcher->bound;
+        deeper.depth                = 0;
+        matcher->deeper =
+            ct_memory_allocate(CT_MEMORY_STATES, 1, sizeof(CTPatlakMatcher));
+        *matcher->deeper = ct_patlak_matcher_presized(deeper);
+    }
+    return matcher->deeper;
+}
+
+/* Deallocate memory. */
+void ct_patlak_matcher_free(CTPatlakMatcher* matcher)
+{
+    if (matcher->deeper != NULL) {
+        ct_patlak_matcher_free(matcher->deeper);
+        ct_memory_free(
+            CT_MEMORY_STATES,
+            matcher->deeper,
+            1,
+            sizeof(CTPatlakMatcher));
+        matcher->deeper = NULL;
+    }
+    ct_patlak_states_free(&matcher->active);
+    ct_patlak_states_free(&matcher->next);
+    ct_patlak_states_free(&matcher->pending);
+    ct_patlak_states_free(&matcher->stack);
+    ct_patlak_visits_free(&matcher->visits);
+    ct_patlak_tags_free(&matcher->tags);
+    ct_patlak_tags_free(&matcher->previous);
+}
@@ -3,7 +3,11 @@
 
 #pragma once
 
+#include "patlak/jit.c"
+#include "patlak/set.c"
+#include "patlak/state.c"
 #include "prelude/expect.c"
+#include "prelude/memory.c"
 #include "prelude/scalar.c"
 #include "prelude/string.c"
 
@@ -12,12 +16,40 @@
 #include <stdlib.h>
 #include <string.h>
 
+/* What is known about the inputs a pattern matches, without decoding. */
+typedef struct {
+    /* Whether the pattern can reach its end without consuming a character. */
+    bool nullable;
+    /* Characters that can be consumed first. */
+    CTPatlakSet first;
+    /* Least amount of characters a match consumes. */
+    CTIndex minimum;
+    /* Most amount of characters a match consumes. Negative means there is no
+     * limit. */
+    CTIndex maximum;
+} CTPatlakAnalysis;
+
+/* Most amount of captures a pattern can have. */
+#define CT_PATLAK_PATTERN_CAPTURES (CT_PATLAK_STATE_TAGS / 2)
+
 /* Pattern information. */
 typedef struct {
     /* Name of the pattern. */
     CTString name;
     /* Index to the start of the pattern's code. */
     CTIndex start;
+    /* Whether the analysis was done. */
+    bool analyzed;
+    /* Analysis of the pattern's code. */
+    CTPatlakAnalysis analysis;
+    /* Names of the captures. Capture at an index uses the tags at the double
+     * of the index and after it. */
+    CTString captures[CT_PATLAK_PATTERN_CAPTURES];
+    /* Amount of captures. */
+    int capture_count;
+    /* Machine code of the pattern, which is compiled when the patterns are
+     * optimized and shared by all the matchers. */
+    CTPatlakJit jit;
 } CTPatlakPattern;
 
 /* unsigned long long map of all the patterns. */
@@ -112,16 +144,53 @@ ct_patlak_patterns_find(CTPatlakPatternRange const* range, CTString const* name)
     return NULL;
 }
 
-/* Pointer to the value that corresponds to the key. Returns nullptr if
- * the value does not exist. */
-CTIndex*
-ct_patlak_patterns_get(CTPatlakPatterns const* patterns, CTString const* name)
+/* Pattern information with the name. Terminates if it does not exist. */
+CTPatlakPattern* ct_patlak_patterns_information(
+    CTPatlakPatterns const* patterns,
+    CTString const*         name)
 {
     CTPatlakPatternRange range =
         ct_patlak_patterns_range(patterns, ct_string_hash(name));
     CTPatlakPattern* information = ct_patlak_patterns_find(&range, name);
     ct_expect(information != NULL, "Pattern does not exist!");
-    return &information->start;
+    return information;
+}
+
+/* Index of the capture with the name in the pattern. Returns negative if not
+ * found. */
+int ct_patlak_pattern_capture(
+    CTPatlakPattern const* pattern,
+    CTString const*        name)
+{
+    for (int i = 0; i < pattern->capture_count; i++) {
+        if (ct_string_equal(pattern->captures + i, name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Pattern information whose code starts at the index. Returns null if there is
+ * not any. Goes through all the patterns. */
+CTPatlakPattern*
+ct_patlak_patterns_starting(CTPatlakPatterns const* patterns, CTIndex start)
+{
+    for (CTPatlakPattern* i = patterns->information.first;
+         i < patterns->information.last;
+         i++) {
+        if (i->start == start) {
+            return i;
+        }
+    }
+    return NULL;
+}
+
+/* Pointer to the value that corresponds to the key. Returns nullptr if
+ * the value does not exist. */
+CTIndex*
+ct_patlak_patterns_get(CTPatlakPatterns const* patterns, CTString const* name)
+{
+    return &ct_patlak_patterns_information(patterns, name)->start;
 }
 
 /* Maximum allowed amount of keys whose hashes give the same index after
@@ -152,17 +221,35 @@ void ct_patlak_patterns_grow_indicies(CTPatlakPatterns* patterns)
         new_size = 1;
     }
     CTIndex* memory =
-        reallocarray(patterns->indicies.first, new_size, sizeof(CTIndex*));
+        reallocarray(patterns->indicies.first, new_size, sizeof(CTIndex));
     ct_expect(memory != NULL, "Could not allocate!");
+    ct_memory_account(
+        CT_MEMORY_PATTERNS,
+        size * (CTIndex)sizeof(CTIndex),
+        new_size * (CTIndex)sizeof(CTIndex));
 
     patterns->indicies.first = memory;
     patterns->indicies.last  = memory + new_size;
 }
 
-/* Compare pattern information. */
-int ct_patlak_patterns_information_compare(void const* lhs, void const* rhs)
+/* Sort the pattern information by the index their hashes give. Insertion
+ * sort, which keeps the order of the ones with the same index. */
+void ct_patlak_patterns_sort(CTPatlakPatterns* patterns)
 {
-    return (int)(ct_string_hash(lhs) - ct_string_hash(rhs));
+    CTIndex indicies = ct_patlak_patterns_indicies_size(patterns);
+    for (CTPatlakPattern* i = patterns->information.first + 1;
+         i < patterns->information.last;
+         i++) {
+        CTPatlakPattern    pattern = *i;
+        unsigned long long index   = ct_string_hash(&pattern.name) % indicies;
+        CTPatlakPattern*   j       = i;
+        while (j > patterns->information.first &&
+               ct_string_hash(&(j - 1)->name) % indicies > index) {
+            *j = *(j - 1);
+            j--;
+        }
+        *j = pattern;
+    }
 }
 
 /* Recalculate indicies. */
@@ -192,11 +279,7 @@ void ct_patlak_patterns_rehash(CTPatlakPatterns* patterns)
         ct_patlak_patterns_grow_indicies(patterns);
 
         // Sort the pairs by hash.
-        qsort(
-            patterns->information.first,
-            ct_patlak_patterns_information_size(patterns),
-            sizeof(CTPatlakPattern),
-            &ct_patlak_patterns_information_compare);
+        ct_patlak_patterns_sort(patterns);
 
         ct_patlak_patterns_recalculate(patterns);
     } while (ct_patlak_patterns_need_rehash(patterns));
@@ -239,6 +322,10 @@ void ct_patlak_patterns_information_reserve(
         new_capacity,
         sizeof(CTPatlakPattern));
     ct_expect(memory != NULL, "Could not allocate!");
+    ct_memory_account(
+        CT_MEMORY_PATTERNS,
+        capacity * (CTIndex)sizeof(CTPatlakPattern),
+        new_capacity * (CTIndex)sizeof(CTPatlakPattern));
 
     patterns->information.last =
         memory + ct_patlak_patterns_information_size(patterns);
@@ -252,10 +339,13 @@ void ct_patlak_patterns_information_put(
     CTPatlakPattern*  position,
     CTPatlakPattern   pattern)
 {
+    // Reserving might move the information; thus, keep the index.
+    CTIndex index = position - patterns->information.first;
     ct_patlak_patterns_information_reserve(patterns, 1);
+    position     = patterns->information.first + index;
     CTIndex size = patterns->information.last++ - position;
     if (size != 0) {
-        memmove(position + 1, position, size);
+        memmove(position + 1, position, size * sizeof(CTPatlakPattern));
     }
     *position = pattern;
 }
@@ -304,6 +394,18 @@ void ct_patlak_patterns_add(
 /* Deallocate the memory. */
 void ct_patlak_patterns_free(CTPatlakPatterns* patterns)
 {
+    for (CTPatlakPattern* i = patterns->information.first;
+         i < patterns->information.last;
+         i++) {
+        ct_patlak_jit_free(&i->jit);
+    }
+    ct_memory_account(
+        CT_MEMORY_PATTERNS,
+        ct_patlak_patterns_information_capacity(patterns) *
+                (CTIndex)sizeof(CTPatlakPattern) +
+            ct_patlak_patterns_indicies_size(patterns) *
+                (CTIndex)sizeof(CTIndex),
+        0);
     free(patterns->information.first);
     patterns->information.first     = NULL;
     patterns->information.last      = NULL;
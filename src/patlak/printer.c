@@ -4,88 +4,189 @@
 #pragma once
 
 #include "patlak/code.c"
+#include "patlak/compact.c"
 #include "patlak/token.c"
+#include "prelude/writer.c"
 
-#include <stdio.h>
-
-/* Print the code. */
-void ct_patlak_printer_code(CTPatlakCode const* code)
+/* Print the code of the codes. */
+void ct_patlak_printer_code(
+    CTWriter*            writer,
+    CTPatlakCodes const* codes,
+    CTPatlakCode const*  code)
 {
     switch (code->type) {
         case CT_PATLAK_CODE_EMPTY:
-            printf("EMPTY");
+            ct_writer_terminated(writer, "EMPTY");
+            break;
         case CT_PATLAK_CODE_LITERAL:
-            printf("LITERAL {%c}", code->literal);
+            ct_writer_terminated(writer, "LITERAL {");
+            ct_writer_character(writer, code->literal);
+            ct_writer_character(writer, '}');
+            break;
         case CT_PATLAK_CODE_RANGE:
-            printf("RANGE {%c~%c}", code->first, code->last);
+            ct_writer_terminated(writer, "RANGE {");
+            ct_writer_character(writer, code->first);
+            ct_writer_character(writer, '~');
+            ct_writer_character(writer, code->last);
+            ct_writer_character(writer, '}');
+            break;
+        case CT_PATLAK_CODE_SET: {
+            // Print the runs of characters in the set as ranges.
+            ct_writer_terminated(writer, "SET {");
+            CTPatlakSet const* set = ct_patlak_codes_set(codes, code);
+            for (int i = 0; i < 256; i++) {
+                if (!ct_patlak_set_has(set, (char)i)) {
+                    continue;
+                }
+                int last = i;
+                while (last < 255 &&
+                       ct_patlak_set_has(set, (char)(last + 1))) {
+                    last++;
+                }
+                ct_writer_character(writer, (char)i);
+                if (last > i) {
+                    ct_writer_character(writer, '~');
+                    ct_writer_character(writer, (char)last);
+                }
+                i = last;
+            }
+            ct_writer_character(writer, '}');
+        } break;
+        case CT_PATLAK_CODE_STRING: {
+            CTString string = ct_patlak_codes_string(codes, code);
+            ct_writer_terminated(writer, "STRING {");
+            ct_writer_string(writer, &string);
+            ct_writer_character(writer, '}');
+        } break;
         case CT_PATLAK_CODE_REFERANCE:
-            printf("REFERENCE {%05ld}", code->reffered);
+            ct_writer_terminated(writer, "REFERENCE {");
+            ct_writer_integer(writer, code->reffered, 5, false);
+            ct_writer_character(writer, '}');
+            break;
         case CT_PATLAK_CODE_BRANCH:
-            printf("BRANCH {%ld}", code->branches);
+            ct_writer_terminated(writer, "BRANCH {");
+            ct_writer_integer(writer, code->branches, 0, false);
+            ct_writer_character(writer, '}');
+            break;
+        case CT_PATLAK_CODE_COUNT:
+            ct_writer_terminated(writer, "COUNT {");
+            ct_writer_integer(writer, code->counter, 0, false);
+            ct_writer_character(writer, '}');
+            break;
+        case CT_PATLAK_CODE_REPEAT:
+            ct_writer_terminated(writer, "REPEAT {");
+            ct_writer_integer(writer, code->counter, 0, false);
+            ct_writer_terminated(writer, ": ");
+            ct_writer_integer(writer, code->minimum, 0, false);
+            ct_writer_character(writer, ',');
+            ct_writer_integer(writer, code->maximum, 0, false);
+            ct_writer_character(writer, '}');
+            break;
+        case CT_PATLAK_CODE_TAG:
+            ct_writer_terminated(writer, "TAG {");
+            ct_writer_integer(writer, code->tag, 0, false);
+            ct_writer_character(writer, '}');
+            break;
         case CT_PATLAK_CODE_TERMINAL:
-            printf("TERMINAL");
+            ct_writer_terminated(writer, "TERMINAL");
+            break;
     }
-    printf(" %+ld\n", code->movement);
+    ct_writer_character(writer, ' ');
+    ct_writer_integer(writer, code->movement, 0, true);
+    ct_writer_character(writer, '\n');
 }
 
 /* Print the codes. */
-void ct_patlak_printer_codes(CTPatlakCodes const* codes)
+void ct_patlak_printer_codes(CTWriter* writer, CTPatlakCodes const* codes)
 {
     for (CTPatlakCode const* i = codes->first; i < codes->last; i++) {
-        printf("[%05ld] ", i - codes->first);
-        ct_patlak_printer_code(i);
+        ct_writer_character(writer, '[');
+        ct_writer_integer(writer, i - codes->first, 5, false);
+        ct_writer_terminated(writer, "] ");
+        ct_patlak_printer_code(writer, codes, i);
     }
 }
 
-/* Format string from the token type. */
-char const* ct_patlak_printer_token_type(CTPatlakTokenType type)
+/* Print the token. */
+void ct_patlak_printer_token(CTWriter* writer, CTPatlakToken const* token)
 {
-    switch (type) {
+    switch (token->type) {
         case CT_PATLAK_TOKEN_EQUAL:
-            return "= ";
         case CT_PATLAK_TOKEN_DOT:
-            return ". ";
         case CT_PATLAK_TOKEN_PIPE:
-            return "| ";
         case CT_PATLAK_TOKEN_COMMA:
-            return ", ";
         case CT_PATLAK_TOKEN_QUESTION_MARK:
-            return "? ";
         case CT_PATLAK_TOKEN_STAR:
-            return "* ";
         case CT_PATLAK_TOKEN_PLUS:
-            return "+ ";
         case CT_PATLAK_TOKEN_OPENING_CURLY_BRACKET:
-            return "{ ";
         case CT_PATLAK_TOKEN_CLOSING_CURLY_BRACKET:
-            return "} ";
         case CT_PATLAK_TOKEN_OPENING_SQUARE_BRACKET:
-            return "[ ";
         case CT_PATLAK_TOKEN_CLOSING_SQUARE_BRACKET:
-            return "] ";
         case CT_PATLAK_TOKEN_NUMBER:
         case CT_PATLAK_TOKEN_QUOTE:
         case CT_PATLAK_TOKEN_IDENTIFIER:
-            return "%.*s ";
+        case CT_PATLAK_TOKEN_KEYWORD:
+            ct_writer_string(writer, &token->value);
+            break;
+        case CT_PATLAK_TOKEN_NEWLINE:
+            ct_writer_character(writer, '\n');
+            return;
+        case CT_PATLAK_TOKEN_COMMENT:
+            return;
         default:
-            return "!(%.*s) ";
+            ct_writer_terminated(writer, "!(");
+            ct_writer_string(writer, &token->value);
+            ct_writer_character(writer, ')');
     }
+    ct_writer_character(writer, ' ');
 }
 
-/* Print the token. */
-void ct_patlak_printer_token(CTPatlakToken const* token)
+/* Print the tokens. */
+void ct_patlak_printer_tokens(CTWriter* writer, CTPatlakTokens const* tokens)
 {
-    printf(
-        ct_patlak_printer_token_type(token->type),
-        (int)ct_string_size(&token->value),
-        token->value.first);
+    for (CTPatlakToken const* i = tokens->first; i < tokens->last; i++) {
+        ct_patlak_printer_token(writer, i);
+    }
+    ct_writer_character(writer, '\n');
 }
 
-/* Print the tokens. */
-void ct_patlak_printer_tokens(CTPatlakTokens const* tokens)
+/* Print the tokens of a file from the index to the end of the list, which
+ * might get more tokens later. Lines that only have a comment are not
+ * printed. */
+void ct_patlak_printer_file_from(
+    CTWriter*                    writer,
+    CTPatlakCompactTokens const* tokens,
+    CTIndex                      index)
 {
-    for (CTPatlakToken const* i = tokens->first; i < tokens->last; i++) {
-        ct_patlak_printer_token(i);
+    signed char const* types = tokens->types;
+    for (CTIndex i = index; i < tokens->size; i++) {
+        bool commented = i > 0 && types[i - 1] == CT_PATLAK_TOKEN_COMMENT &&
+                         (i == 1 || types[i - 2] == CT_PATLAK_TOKEN_NEWLINE);
+        if (types[i] != CT_PATLAK_TOKEN_NEWLINE || !commented) {
+            CTPatlakToken token = ct_patlak_compact_get(tokens, i);
+            ct_patlak_printer_token(writer, &token);
+        }
     }
-    printf("\n");
+}
+
+/* Finish the last line of the printed file even if the file does not. */
+void ct_patlak_printer_file_end(
+    CTWriter*                    writer,
+    CTPatlakCompactTokens const* tokens)
+{
+    if (tokens->size > 0 &&
+        tokens->types[tokens->size - 1] != CT_PATLAK_TOKEN_NEWLINE &&
+        tokens->types[tokens->size - 1] != CT_PATLAK_TOKEN_COMMENT) {
+        ct_writer_character(writer, '\n');
+    }
+}
+
+/* Print the tokens of a whole file. Lines that only have a comment are not
+ * printed, and the last line is finished even if the file does not. */
+void ct_patlak_printer_file(
+    CTWriter*                    writer,
+    CTPatlakCompactTokens const* tokens)
+{
+    ct_patlak_printer_file_from(writer, tokens, 0);
+    ct_patlak_printer_file_end(writer, tokens);
 }
@@ -0,0 +1,57 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <stdbool.h>
+
+/* Amount of bits in a word of the set. */
+#define CT_PATLAK_SET_WORD 64
+
+/* Set of characters as a bitmap with a bit for each of the 256 characters. */
+typedef struct {
+    /* Bits of the characters. Character c is the bit c % 64 of the word
+     * c / 64. */
+    unsigned long long words[256 / CT_PATLAK_SET_WORD];
+} CTPatlakSet;
+
+/* Whether the character is in the set. */
+bool ct_patlak_set_has(CTPatlakSet const* set, char character)
+{
+    unsigned char index = character;
+    return (set->words[index / CT_PATLAK_SET_WORD] >>
+            (index % CT_PATLAK_SET_WORD)) &
+           1;
+}
+
+/* Put the character to the set. */
+void ct_patlak_set_add(CTPatlakSet* set, char character)
+{
+    unsigned char index = character;
+    set->words[index / CT_PATLAK_SET_WORD] |= 1ULL
+                                              << (index % CT_PATLAK_SET_WORD);
+}
+
+/* Put the characters in the inclusive range to the set. */
+void ct_patlak_set_add_range(CTPatlakSet* set, char first, char last)
+{
+    for (unsigned i = (unsigned char)first; i <= (unsigned char)last; i++) {
+        ct_patlak_set_add(set, (char)i);
+    }
+}
+
+/* Put all the characters to the set. */
+void ct_patlak_set_fill(CTPatlakSet* set)
+{
+    for (int i = 0; i < 256 / CT_PATLAK_SET_WORD; i++) {
+        set->words[i] = ~0ULL;
+    }
+}
+
+/* Put the characters in the other set to the set. */
+void ct_patlak_set_join(CTPatlakSet* set, CTPatlakSet const* other)
+{
+    for (int i = 0; i < 256 / CT_PATLAK_SET_WORD; i++) {
+        set->words[i] |= other->words[i];
+    }
+}
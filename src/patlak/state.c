@@ -4,10 +4,22 @@
 #pragma once
 
 #include "patlak/code.c"
+#include "prelude/expect.c"
+#include "prelude/memory.c"
 #include "prelude/scalar.c"
 #include "prelude/string.c"
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Amount of counters a state carries. Limits the depth of nested counted
+ * repeats in a pattern. */
+#define CT_PATLAK_STATE_COUNTERS 4
+
+/* Amount of tags a record of the states carries. Each capture of a pattern
+ * uses two tags, which are its borders. */
+#define CT_PATLAK_STATE_TAGS 8
 
 /* State of the nondeterministic finite automaton. */
 typedef struct {
@@ -15,8 +27,12 @@ typedef struct {
     CTString input;
     /* Index of the code. */
     CTIndex code;
-    /* Whether the state reached a dead end. */
-    bool dead;
+    /* Record of the tags the state passed, which is kept outside the state so
+     * the states of the patterns without captures are not bigger. Zero means
+     * no tags were passed. */
+    int tags;
+    /* Amount of repeats done by the counted repeats the state is in. */
+    CTIndex counters[CT_PATLAK_STATE_COUNTERS];
 } CTPatlakState;
 
 /* Dynamic array of states. */
@@ -82,6 +98,10 @@ void ct_patlak_states_reserve(CTPatlakStates* states, CTIndex amount)
     CTPatlakState* memory =
         reallocarray(states->first, new_capacity, sizeof(CTPatlakState));
     ct_expect(memory != NULL, "Could not allocate!");
+    ct_memory_account(
+        CT_MEMORY_STATES,
+        capacity * (CTIndex)sizeof(CTPatlakState),
+        new_capacity * (CTIndex)sizeof(CTPatlakState));
 
     states->last      = memory + ct_patlak_states_size(states);
     states->first     = memory;
@@ -104,8 +124,262 @@ void ct_patlak_states_clear(CTPatlakStates* states)
 /* Deallocate memory. */
 void ct_patlak_states_free(CTPatlakStates* states)
 {
+    ct_memory_account(
+        CT_MEMORY_STATES,
+        ct_patlak_states_capacity(states) * (CTIndex)sizeof(CTPatlakState),
+        0);
     free(states->first);
     states->first     = NULL;
     states->last      = NULL;
     states->allocated = NULL;
 }
+
+/* Dynamic array of the positions of the tags that states recorded. Each
+ * record is CT_PATLAK_STATE_TAGS positions, and is never changed after it is
+ * added; so, states can share them. */
+typedef struct {
+    /* Border before the first position. */
+    char const** first;
+    /* Border after the last position. */
+    char const** last;
+    /* Border after the last allocated position. */
+    char const** allocated;
+} CTPatlakTags;
+
+/* Positions of the record. Null if the record is zero. */
+char const* const* ct_patlak_tags_get(CTPatlakTags const* tags, int record)
+{
+    if (record == 0) {
+        return NULL;
+    }
+    ct_expect(
+        record > 0 &&
+            record <= (tags->last - tags->first) / CT_PATLAK_STATE_TAGS,
+        "Record out of bounds!");
+    return tags->first + (CTIndex)(record - 1) * CT_PATLAK_STATE_TAGS;
+}
+
+/* Make sure the amount of records will fit. Grows to at least the double of
+ * the current size if necessary. */
+void ct_patlak_tags_reserve(CTPatlakTags* tags, CTIndex records)
+{
+    CTIndex amount = records * CT_PATLAK_STATE_TAGS;
+    if (tags->allocated - tags->last >= amount) {
+        return;
+    }
+    CTIndex size     = tags->last - tags->first;
+    CTIndex capacity = size < CT_PATLAK_STATE_TAGS * 8
+                         ? CT_PATLAK_STATE_TAGS * 16
+                         : size * 2;
+    if (capacity < size + amount) {
+        capacity = size + amount;
+    }
+    char const** memory =
+        reallocarray(tags->first, capacity, sizeof(char const*));
+    ct_expect(memory != NULL, "Could not allocate!");
+    ct_memory_account(
+        CT_MEMORY_STATES,
+        (tags->allocated - tags->first) * (CTIndex)sizeof(char const*),
+        capacity * (CTIndex)sizeof(char const*));
+    tags->first     = memory;
+    tags->last      = memory + size;
+    tags->allocated = memory + capacity;
+}
+
+/* Add a copy of the record of the other records, which might be the same
+ * ones. Returns the added record. */
+int ct_patlak_tags_copy(
+    CTPatlakTags*       tags,
+    CTPatlakTags const* other,
+    int                 record)
+{
+    // Find the record after reserving, which might move it.
+    ct_patlak_tags_reserve(tags, 1);
+    char const* const* previous = ct_patlak_tags_get(other, record);
+    for (int i = 0; i < CT_PATLAK_STATE_TAGS; i++) {
+        tags->last[i] = previous == NULL ? NULL : previous[i];
+    }
+    tags->last += CT_PATLAK_STATE_TAGS;
+    return (int)((tags->last - tags->first) / CT_PATLAK_STATE_TAGS);
+}
+
+/* Add a record that is a copy of the record with the position of the tag
+ * changed. Returns the added record. */
+int ct_patlak_tags_record(
+    CTPatlakTags* tags,
+    int           record,
+    int           tag,
+    char const*   position)
+{
+    ct_expect(tag >= 0 && tag < CT_PATLAK_STATE_TAGS, "Tag out of bounds!");
+    int added = ct_patlak_tags_copy(tags, tags, record);
+    tags->last[tag - CT_PATLAK_STATE_TAGS] = position;
+    return added;
+}
+
+/* Remove the records. Keeps the memory. */
+void ct_patlak_tags_clear(CTPatlakTags* tags)
+{
+    tags->last = tags->first;
+}
+
+/* Deallocate memory. */
+void ct_patlak_tags_free(CTPatlakTags* tags)
+{
+    ct_memory_account(
+        CT_MEMORY_STATES,
+        (tags->allocated - tags->first) * (CTIndex)sizeof(char const*),
+        0);
+    free(tags->first);
+    tags->first     = NULL;
+    tags->last      = NULL;
+    tags->allocated = NULL;
+}
+
+/* Code and counters of a state that was visited at an input position. */
+typedef struct {
+    /* Position the state was visited at, which is the stamp of the visits
+     * then. Zero means the slot is empty. */
+    unsigned stamp;
+    /* Index of the code. */
+    CTIndex code;
+    /* Amount of repeats done by the counted repeats. */
+    CTIndex counters[CT_PATLAK_STATE_COUNTERS];
+} CTPatlakVisit;
+
+/* Hash set of the states that were visited at the current input position.
+ * States at the same position with the same code and counters decode the same
+ * way; so, only the first of them is decoded, which also stops the loops that
+ * do not consume any input. Moving to the next position changes the stamp
+ * instead of clearing the slots. */
+typedef struct {
+    /* Slots, whose amount is a power of two. */
+    CTPatlakVisit* slots;
+    /* Amount of slots. */
+    CTIndex capacity;
+    /* Amount of slots with the current stamp. */
+    CTIndex size;
+    /* Stamp of the current position. */
+    unsigned stamp;
+} CTPatlakVisits;
+
+/* Hash of the code and the counters of the state. */
+CTIndex ct_patlak_visits_hash(CTPatlakState const* state)
+{
+    uint64_t hash = (uint64_t)state->code;
+    for (int i = 0; i < CT_PATLAK_STATE_COUNTERS; i++) {
+        hash = hash * 0x100000001B3ULL ^ (uint64_t)state->counters[i];
+    }
+    hash *= 0x9E3779B97F4A7C15ULL;
+    return (CTIndex)(hash >> 32);
+}
+
+/* Whether the slot has the code and the counters of the state. */
+bool ct_patlak_visits_same(
+    CTPatlakVisit const* visit,
+    CTPatlakState const* state)
+{
+    if (visit->code != state->code) {
+        return false;
+    }
+    for (int i = 0; i < CT_PATLAK_STATE_COUNTERS; i++) {
+        if (visit->counters[i] != state->counters[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Make sure the amount of states can be visited at a position. Keeps at least
+ * half of the slots empty, so the probes stay short. */
+void ct_patlak_visits_reserve(CTPatlakVisits* visits, CTIndex amount)
+{
+    ct_expect(amount >= 0, "Reserving negative amount!");
+    if (2 * amount < visits->capacity) {
+        return;
+    }
+    CTIndex capacity = visits->capacity > 0 ? visits->capacity : 16;
+    while (2 * amount >= capacity) {
+        capacity *= 2;
+    }
+
+    // Move the visits of the current position to the new slots.
+    CTPatlakVisit* slots = calloc(capacity, sizeof(CTPatlakVisit));
+    ct_expect(slots != NULL, "Could not allocate!");
+    ct_memory_account(
+        CT_MEMORY_STATES,
+        visits->capacity * (CTIndex)sizeof(CTPatlakVisit),
+        capacity * (CTIndex)sizeof(CTPatlakVisit));
+    for (CTIndex i = 0; i < visits->capacity; i++) {
+        CTPatlakVisit const* visit = visits->slots + i;
+        if (visit->stamp != visits->stamp || visits->stamp == 0) {
+            continue;
+        }
+        CTPatlakState state = {.code = visit->code};
+        for (int j = 0; j < CT_PATLAK_STATE_COUNTERS; j++) {
+            state.counters[j] = visit->counters[j];
+        }
+        CTIndex slot = ct_patlak_visits_hash(&state) & (capacity - 1);
+        while (slots[slot].stamp != 0) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        slots[slot] = *visit;
+    }
+    free(visits->slots);
+    visits->slots    = slots;
+    visits->capacity = capacity;
+}
+
+/* Forget the visited states by moving to the next position. */
+void ct_patlak_visits_next(CTPatlakVisits* visits)
+{
+    visits->size = 0;
+    visits->stamp++;
+
+    // Clear the slots once the stamps wrap around, so old ones do not look
+    // current.
+    if (visits->stamp == 0) {
+        for (CTIndex i = 0; i < visits->capacity; i++) {
+            visits->slots[i].stamp = 0;
+        }
+        visits->stamp = 1;
+    }
+}
+
+/* Visit the state at the current position. Returns false if a state with the
+ * same code and counters was already visited there. */
+bool ct_patlak_visits_add(CTPatlakVisits* visits, CTPatlakState const* state)
+{
+    ct_patlak_visits_reserve(visits, visits->size + 1);
+    CTIndex        mask  = visits->capacity - 1;
+    CTIndex        slot  = ct_patlak_visits_hash(state) & mask;
+    CTPatlakVisit* visit = visits->slots + slot;
+    for (; visit->stamp == visits->stamp; visit = visits->slots + slot) {
+        if (ct_patlak_visits_same(visit, state)) {
+            return false;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    // Slots of the earlier positions are free to take.
+    visit->stamp = visits->stamp;
+    visit->code  = state->code;
+    for (int i = 0; i < CT_PATLAK_STATE_COUNTERS; i++) {
+        visit->counters[i] = state->counters[i];
+    }
+    visits->size++;
+    return true;
+}
+
+/* Deallocate memory. */
+void ct_patlak_visits_free(CTPatlakVisits* visits)
+{
+    ct_memory_account(
+        CT_MEMORY_STATES,
+        visits->capacity * (CTIndex)sizeof(CTPatlakVisit),
+        0);
+    free(visits->slots);
+    visits->slots    = NULL;
+    visits->capacity = 0;
+    visits->size     = 0;
+}
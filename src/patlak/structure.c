@@ -0,0 +1,287 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "prelude/scalar.c"
+#include "prelude/string.c"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#    include <emmintrin.h>
+#endif
+
+/* Amount of characters that are classified together. */
+#define CT_PATLAK_STRUCTURE_BLOCK 64
+
+/* Classes of characters that the lexer looks for. */
+typedef enum {
+    /* Spaces and tabs. */
+    CT_PATLAK_CLASS_BLANK,
+    /* Blanks and line feeds. */
+    CT_PATLAK_CLASS_WHITESPACE,
+    /* Line feeds. */
+    CT_PATLAK_CLASS_NEWLINE,
+    /* Single quotes. */
+    CT_PATLAK_CLASS_QUOTE,
+    /* Backslashes. */
+    CT_PATLAK_CLASS_BACKSLASH,
+    /* Decimal digits, which make numbers. */
+    CT_PATLAK_CLASS_DIGIT,
+    /* Letters and underscores, which make identifiers. */
+    CT_PATLAK_CLASS_LETTER,
+    /* Letters and digits, which make words. */
+    CT_PATLAK_CLASS_WORD,
+    /* Amount of classes. */
+    CT_PATLAK_CLASSES
+} CTPatlakClass;
+
+/* Classes of the characters in a block of a source, one bit for each character
+ * from the least significant one. The lexer finds the borders of the tokens by
+ * counting the trailing zeros of these instead of probing the characters one
+ * by one, and keeps the block while the tokens are in it. */
+typedef struct {
+    /* Start of the classified block. Null if there is none yet. */
+    char const* block;
+    /* Amount of classified characters, which is less than a block only at the
+     * end of the string. */
+    CTIndex amount;
+    /* Classified characters. */
+    uint64_t classified;
+    /* Characters in each class. */
+    uint64_t classes[CT_PATLAK_CLASSES];
+} CTPatlakStructure;
+
+#if defined(__SSE2__)
+/* Mask of the characters that are in the inclusive range. Compares are signed,
+ * so characters after the ASCII are never in ranges of the ASCII. */
+unsigned ct_patlak_structure_range(__m128i characters, char first, char last)
+{
+    return (unsigned)_mm_movemask_epi8(_mm_and_si128(
+        _mm_cmpgt_epi8(characters, _mm_set1_epi8((char)(first - 1))),
+        _mm_cmplt_epi8(characters, _mm_set1_epi8((char)(last + 1)))));
+}
+
+/* Mask of the characters that are equal to the character. */
+unsigned ct_patlak_structure_equal(__m128i characters, char character)
+{
+    return (unsigned)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(characters, _mm_set1_epi8(character)));
+}
+#endif
+
+/* Classify the amount of characters at the position, which is at most a
+ * block. */
+void ct_patlak_structure_classify(
+    CTPatlakStructure* structure,
+    char const*        position,
+    CTIndex            amount)
+{
+    *structure = (CTPatlakStructure){
+        .block      = position,
+        .amount     = amount,
+        .classified = amount < CT_PATLAK_STRUCTURE_BLOCK
+                          ? ((uint64_t)1 << amount) - 1
+                          : ~(uint64_t)0};
+#if defined(__SSE2__)
+    // Copy a block that is not whole, so the loads stay in the string. Nulls
+    // after the characters are not in any of the classes.
+    char        padded[CT_PATLAK_STRUCTURE_BLOCK];
+    char const* characters = position;
+    if (amount < CT_PATLAK_STRUCTURE_BLOCK) {
+        memset(padded, 0, sizeof(padded));
+        memcpy(padded, position, amount);
+        characters = padded;
+    }
+    uint64_t* classes = structure->classes;
+    for (int i = 0; i < CT_PATLAK_STRUCTURE_BLOCK; i += 16) {
+        __m128i loaded = _mm_loadu_si128((__m128i const*)(characters + i));
+        __m128i lower  = _mm_or_si128(loaded, _mm_set1_epi8(0x20));
+        classes[CT_PATLAK_CLASS_BLANK] |=
+            (uint64_t)(ct_patlak_structure_equal(loaded, ' ') |
+                       ct_patlak_structure_equal(loaded, '\t'))
+            << i;
+        classes[CT_PATLAK_CLASS_NEWLINE] |=
+            (uint64_t)ct_patlak_structure_equal(loaded, '\n') << i;
+        classes[CT_PATLAK_CLASS_QUOTE] |=
+            (uint64_t)ct_patlak_structure_equal(loaded, '\'') << i;
+        classes[CT_PATLAK_CLASS_BACKSLASH] |=
+            (uint64_t)ct_patlak_structure_equal(loaded, '\\') << i;
+        classes[CT_PATLAK_CLASS_LETTER] |=
+            (uint64_t)(ct_patlak_structure_range(lower, 'a', 'z') |
+                       ct_patlak_structure_equal(loaded, '_'))
+            << i;
+        classes[CT_PATLAK_CLASS_DIGIT] |=
+            (uint64_t)ct_patlak_structure_range(loaded, '0', '9') << i;
+    }
+#else
+    uint64_t* classes = structure->classes;
+    for (CTIndex i = 0; i < amount; i++) {
+        uint64_t bit       = (uint64_t)1 << i;
+        char     character = position[i];
+        switch (character) {
+            case ' ':
+            case '\t':
+                classes[CT_PATLAK_CLASS_BLANK] |= bit;
+                break;
+            case '\n':
+                classes[CT_PATLAK_CLASS_NEWLINE] |= bit;
+                break;
+            case '\'':
+                classes[CT_PATLAK_CLASS_QUOTE] |= bit;
+                break;
+            case '\\':
+                classes[CT_PATLAK_CLASS_BACKSLASH] |= bit;
+                break;
+            case '_':
+                classes[CT_PATLAK_CLASS_LETTER] |= bit;
+                break;
+            default:
+                if ((character >= 'a' && character <= 'z') ||
+                    (character >= 'A' && character <= 'Z')) {
+                    classes[CT_PATLAK_CLASS_LETTER] |= bit;
+                } else if (character >= '0' && character <= '9') {
+                    classes[CT_PATLAK_CLASS_DIGIT] |= bit;
+                }
+        }
+    }
+#endif
+    classes[CT_PATLAK_CLASS_WHITESPACE] =
+        classes[CT_PATLAK_CLASS_BLANK] | classes[CT_PATLAK_CLASS_NEWLINE];
+    classes[CT_PATLAK_CLASS_WORD] =
+        classes[CT_PATLAK_CLASS_LETTER] | classes[CT_PATLAK_CLASS_DIGIT];
+}
+
+/* Classify the block that starts at the position if the position is not in the
+ * classified one. All the strings a structure is used with must have the same
+ * end. */
+void ct_patlak_structure_load(
+    CTPatlakStructure* structure,
+    CTString const*    string,
+    char const*        position)
+{
+    if (structure->block != NULL && position >= structure->block &&
+        position < structure->block + structure->amount) {
+        return;
+    }
+    CTIndex amount = string->last - position;
+    if (amount > CT_PATLAK_STRUCTURE_BLOCK) {
+        amount = CT_PATLAK_STRUCTURE_BLOCK;
+    }
+    ct_patlak_structure_classify(structure, position, amount);
+}
+
+/* Mask of the classified characters from the position, which must be in the
+ * block. */
+uint64_t ct_patlak_structure_from(
+    CTPatlakStructure const* structure,
+    char const*              position)
+{
+    CTIndex offset = position - structure->block;
+    return structure->classified & ~(uint64_t)0 << offset;
+}
+
+/* First character in the string whose bit in the class is different from the
+ * flip, or the end of the string. */
+char const* ct_patlak_structure_find(
+    CTPatlakStructure* structure,
+    CTString const*    string,
+    CTPatlakClass      class,
+    uint64_t           flip)
+{
+    char const* position = string->first;
+    while (position < string->last) {
+        ct_patlak_structure_load(structure, string, position);
+        uint64_t mask = (structure->classes[class] ^ flip) &
+                        ct_patlak_structure_from(structure, position);
+        if (mask != 0) {
+            return structure->block + __builtin_ctzll(mask);
+        }
+        position = structure->block + structure->amount;
+    }
+    return string->last;
+}
+
+/* First character in the string that is in the class, or the end of the
+ * string. */
+char const* ct_patlak_structure_first(
+    CTPatlakStructure* structure,
+    CTString const*    string,
+    CTPatlakClass      class)
+{
+    return ct_patlak_structure_find(structure, string, class, 0);
+}
+
+/* First character in the string that is not in the class, or the end of the
+ * string. */
+char const* ct_patlak_structure_first_not(
+    CTPatlakStructure* structure,
+    CTString const*    string,
+    CTPatlakClass      class)
+{
+    return ct_patlak_structure_find(structure, string, class, ~(uint64_t)0);
+}
+
+/* Whether the string starts with a character in the class. */
+bool ct_patlak_structure_starts(
+    CTPatlakStructure* structure,
+    CTString const*    string,
+    CTPatlakClass      class)
+{
+    if (!ct_string_finite(string)) {
+        return false;
+    }
+    ct_patlak_structure_load(structure, string, string->first);
+    return structure->classes[class] >> (string->first - structure->block) & 1;
+}
+
+/* Mask of the characters that are escaped by the backslashes, which are the
+ * ones after odd runs of backslashes. Runs that start at odd bits are found by
+ * adding their starts to them, whose carries flip the parity of the bits after
+ * the runs. Escaped is whether the first character is escaped, and it becomes
+ * whether the character after the block is. */
+uint64_t ct_patlak_structure_escaped(uint64_t backslashes, bool* escaped)
+{
+    uint64_t const even = 0x5555555555555555;
+    backslashes &= ~(uint64_t)*escaped;
+    uint64_t follows = backslashes << 1 | (uint64_t)*escaped;
+    uint64_t starts  = backslashes & ~even & ~follows;
+    uint64_t carried = starts + backslashes;
+    *escaped         = carried < starts;
+    return (even ^ carried << 1) & follows;
+}
+
+/* End of the quote at the start of the string, which is after the closing
+ * quote; or at the first line feed, or the end of the string, if the quote is
+ * not closed before them. Line feeds end the quote even if they are escaped.
+ * Sets whether the quote is closed. */
+char const* ct_patlak_structure_quote_end(
+    CTPatlakStructure* structure,
+    CTString const*    string,
+    bool*              closed)
+{
+    char const* position = string->first + 1;
+    bool        escaped  = false;
+    *closed              = false;
+    while (position < string->last) {
+        ct_patlak_structure_load(structure, string, position);
+        uint64_t range   = ct_patlak_structure_from(structure, position);
+        uint64_t escapes = ct_patlak_structure_escaped(
+            structure->classes[CT_PATLAK_CLASS_BACKSLASH] & range,
+            &escaped);
+        uint64_t closing =
+            structure->classes[CT_PATLAK_CLASS_QUOTE] & range & ~escapes;
+        uint64_t stops =
+            closing | (structure->classes[CT_PATLAK_CLASS_NEWLINE] & range);
+        if (stops != 0) {
+            int stop = __builtin_ctzll(stops);
+            *closed  = closing >> stop & 1;
+            return structure->block + stop + *closed;
+        }
+        position = structure->block + structure->amount;
+    }
+    return string->last;
+}
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "prelude/expect.c"
+#include "prelude/memory.c"
 #include "prelude/string.c"
 
 #include <stdlib.h>
@@ -39,7 +40,15 @@ typedef enum {
     CT_PATLAK_TOKEN_QUOTE,
     /* Any amount of consecutive characters from the English alphabet
      * and underscores. */
-    CT_PATLAK_TOKEN_IDENTIFIER
+    CT_PATLAK_TOKEN_IDENTIFIER,
+    /* Line feed: "\n". Only lexed when lexing whole files. */
+    CT_PATLAK_TOKEN_NEWLINE,
+    /* Two slashes and the characters after them until the end of the line:
+     * "//". Only lexed when lexing whole files. */
+    CT_PATLAK_TOKEN_COMMENT,
+    /* Identifier, maybe with digits after it, that is in the keyword table.
+     * Only lexed when lexing whole files with a keyword table. */
+    CT_PATLAK_TOKEN_KEYWORD
 } CTPatlakTokenType;
 
 /* Parts of a pattern string. */
@@ -113,6 +122,10 @@ void ct_patlak_tokens_reserve(CTPatlakTokens* tokens, CTIndex amount)
     CTPatlakToken* memory =
         reallocarray(tokens->first, new_capacity, sizeof(CTPatlakToken));
     ct_expect(memory != NULL, "Could not allocate!");
+    ct_memory_account(
+        CT_MEMORY_TOKENS,
+        capacity * (CTIndex)sizeof(CTPatlakToken),
+        new_capacity * (CTIndex)sizeof(CTPatlakToken));
 
     tokens->last      = memory + ct_patlak_tokens_size(tokens);
     tokens->first     = memory;
@@ -135,6 +148,10 @@ void ct_patlak_tokens_clear(CTPatlakTokens* tokens)
 /* Deallocate memory. */
 void ct_patlak_tokens_free(CTPatlakTokens* tokens)
 {
+    ct_memory_account(
+        CT_MEMORY_TOKENS,
+        ct_patlak_tokens_capacity(tokens) * (CTIndex)sizeof(CTPatlakToken),
+        0);
     free(tokens->first);
     tokens->first     = NULL;
     tokens->last      = NULL;
@@ -0,0 +1,257 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "patlak/compact.c"
+#include "patlak/keywords.c"
+#include "patlak/lexer.c"
+#include "patlak/printer.c"
+#include "patlak/token.c"
+#include "prelude/buffer.c"
+#include "prelude/expect.c"
+#include "prelude/ring.c"
+#include "prelude/scalar.c"
+#include "prelude/string.c"
+#include "prelude/writer.c"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Size of chunks the file is loaded by. */
+#define CT_PIPELINE_CHUNK (1 << 16)
+
+/* Amount of tokens that are handed to the next stage together. */
+#define CT_PIPELINE_BATCH 256
+
+/* Amount of chunks or batches that can wait between two stages. */
+#define CT_PIPELINE_DEPTH 16
+
+/* Size of the smallest file that is worth starting the threads for. */
+#define CT_PIPELINE_THRESHOLD (4 * CT_PIPELINE_CHUNK)
+
+/* Loaded part of the file that is handed from loading to lexing. */
+typedef struct {
+    /* Amount of characters that are loaded from the start of the file. */
+    CTIndex loaded;
+    /* Whether the whole file is loaded. */
+    bool finished;
+} CTPipelineChunk;
+
+/* Tokens that are handed from lexing to printing. */
+typedef struct {
+    /* Tokens in the order they were lexed. */
+    CTPatlakToken tokens[CT_PIPELINE_BATCH];
+    /* Amount of tokens. */
+    CTIndex size;
+    /* Whether these are the last tokens of the file. */
+    bool finished;
+} CTPipelineBatch;
+
+/* Stages that compile a file concurrently. Loading and lexing run on their own
+ * threads, and hand their work to the next stage through the rings. */
+typedef struct {
+    /* File that is loaded. */
+    FILE* file;
+    /* Memory the file is loaded to, which fits the whole file. */
+    char* contents;
+    /* Size of the file. */
+    CTIndex size;
+    /* Loaded parts from loading to lexing. */
+    CTRing chunks;
+    /* Tokens from lexing to printing. */
+    CTRing batches;
+    /* Keyword table the file is lexed with. Null if there is none. */
+    CTPatlakKeywords const* keywords;
+} CTPipeline;
+
+/* Load the file chunk by chunk and hand each loaded part to lexing. */
+void* ct_pipeline_load(void* argument)
+{
+    CTPipeline*     pipeline = argument;
+    CTPipelineChunk chunk    = {0};
+    while (chunk.loaded < pipeline->size) {
+        CTIndex amount = pipeline->size - chunk.loaded;
+        if (amount > CT_PIPELINE_CHUNK) {
+            amount = CT_PIPELINE_CHUNK;
+        }
+        CTIndex read = (CTIndex)fread(
+            pipeline->contents + chunk.loaded,
+            1,
+            amount,
+            pipeline->file);
+        ct_expect(read == amount, "Problem while reading file!");
+        chunk.loaded += read;
+        ct_ring_push(&pipeline->chunks, &chunk);
+    }
+    chunk.finished = true;
+    ct_ring_push(&pipeline->chunks, &chunk);
+    return NULL;
+}
+
+/* Hand the lexed tokens to printing in batches. Hands all of them if the file
+ * is finished, otherwise only the full batches and keeps the rest. */
+void ct_pipeline_hand(
+    CTPipeline*     pipeline,
+    CTPatlakTokens* tokens,
+    CTIndex*        handed,
+    bool            finished)
+{
+    CTPipelineBatch batch = {0};
+    while (true) {
+        CTIndex left = ct_patlak_tokens_size(tokens) - *handed;
+        if (left < CT_PIPELINE_BATCH && !finished) {
+            break;
+        }
+        batch.size     = left < CT_PIPELINE_BATCH ? left : CT_PIPELINE_BATCH;
+        batch.finished = batch.size == left && finished;
+        memcpy(
+            batch.tokens,
+            tokens->first + *handed,
+            batch.size * sizeof(CTPatlakToken));
+        *handed += batch.size;
+        ct_ring_push(&pipeline->batches, &batch);
+        if (batch.finished) {
+            break;
+        }
+    }
+
+    // Forget the handed tokens, so the list stays at most a batch.
+    CTIndex kept = ct_patlak_tokens_size(tokens) - *handed;
+    memmove(
+        tokens->first,
+        tokens->first + *handed,
+        kept * sizeof(CTPatlakToken));
+    tokens->last = tokens->first + kept;
+    *handed      = 0;
+}
+
+/* Lex the loaded parts as they come, and hand their tokens to printing. */
+void* ct_pipeline_lex(void* argument)
+{
+    CTPipeline*     pipeline = argument;
+    CTPatlakTokens  tokens   = {0};
+    CTIndex         handed   = 0;
+    CTString        part     = {.first = pipeline->contents};
+    CTPipelineChunk chunk    = {0};
+    do {
+        ct_ring_pop(&pipeline->chunks, &chunk);
+        part.last = pipeline->contents + chunk.loaded;
+        if (chunk.finished) {
+            ct_patlak_lexer_file_rest(
+                &tokens,
+                pipeline->contents,
+                part,
+                pipeline->keywords);
+        } else {
+            ct_patlak_lexer_file_part(
+                &tokens,
+                pipeline->contents,
+                &part,
+                pipeline->keywords);
+        }
+        ct_pipeline_hand(pipeline, &tokens, &handed, chunk.finished);
+    } while (!chunk.finished);
+    ct_patlak_tokens_free(&tokens);
+    return NULL;
+}
+
+/* Load and lex the file on their own threads, and collect and print the
+ * tokens on this thread. */
+void ct_pipeline_concurrent(
+    CTPipeline*            pipeline,
+    CTPatlakCompactTokens* tokens,
+    CTWriter*              writer)
+{
+    pipeline->chunks  = ct_ring(CT_PIPELINE_DEPTH, sizeof(CTPipelineChunk));
+    pipeline->batches = ct_ring(CT_PIPELINE_DEPTH, sizeof(CTPipelineBatch));
+    pthread_t loader  = {0};
+    pthread_t lexer   = {0};
+    ct_expect(
+        pthread_create(&loader, NULL, &ct_pipeline_load, pipeline) == 0 &&
+            pthread_create(&lexer, NULL, &ct_pipeline_lex, pipeline) == 0,
+        "Could not start the pipeline!");
+
+    CTPipelineBatch batch = {0};
+    do {
+        ct_ring_pop(&pipeline->batches, &batch);
+        CTIndex collected = tokens->size;
+        ct_patlak_compact_reserve(tokens, batch.size);
+        for (CTIndex i = 0; i < batch.size; i++) {
+            ct_patlak_compact_add(tokens, batch.tokens[i]);
+        }
+        if (writer != NULL) {
+            ct_patlak_printer_file_from(writer, tokens, collected);
+        }
+    } while (!batch.finished);
+    if (writer != NULL) {
+        ct_patlak_printer_file_end(writer, tokens);
+    }
+
+    ct_expect(
+        pthread_join(loader, NULL) == 0 && pthread_join(lexer, NULL) == 0,
+        "Could not finish the pipeline!");
+    ct_ring_free(&pipeline->chunks);
+    ct_ring_free(&pipeline->batches);
+}
+
+/* Load, lex and print the file one stage after the other on this thread. */
+void ct_pipeline_sequential(
+    CTPipeline*            pipeline,
+    CTPatlakCompactTokens* tokens,
+    CTWriter*              writer)
+{
+    CTIndex read =
+        (CTIndex)fread(pipeline->contents, 1, pipeline->size, pipeline->file);
+    ct_expect(read == pipeline->size, "Problem while reading file!");
+    CTString file = {
+        .first = pipeline->contents,
+        .last  = pipeline->contents + pipeline->size};
+    ct_patlak_lexer_file_compact(tokens, file, pipeline->keywords);
+    if (writer != NULL) {
+        ct_patlak_printer_file(writer, tokens);
+    }
+}
+
+/* Load and lex the file at the path to the buffer and the tokens while the
+ * tokens are collected, so reading, lexing and printing overlap. The tokens
+ * are replaced by the ones of the file. Prints the tokens as they come if
+ * there is a writer. Small files and machines with a
+ * single processor do the stages one after the other, as they cannot gain
+ * from the threads. Returns a view to the contents of the file. */
+CTString ct_pipeline(
+    CTBuffer*               buffer,
+    CTPatlakCompactTokens*  tokens,
+    char const*             path,
+    CTPatlakKeywords const* keywords,
+    CTWriter*               writer)
+{
+    FILE* file = fopen(path, "r");
+    ct_expect(file != NULL, "Could not open the file!");
+    struct stat status;
+    ct_expect(fstat(fileno(file), &status) == 0, "Could not stat the file!");
+
+    // Tokens view the contents, so they must not move while loading.
+    CTIndex begining = ct_buffer_size(buffer);
+    ct_buffer_reserve(buffer, (CTIndex)status.st_size);
+    CTPipeline pipeline = {
+        .file     = file,
+        .contents = buffer->last,
+        .size     = (CTIndex)status.st_size,
+        .keywords = keywords};
+    ct_patlak_compact_clear(tokens, pipeline.contents);
+    if (pipeline.size < CT_PIPELINE_THRESHOLD ||
+        sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+        ct_pipeline_sequential(&pipeline, tokens, writer);
+    } else {
+        ct_pipeline_concurrent(&pipeline, tokens, writer);
+    }
+    ct_expect(fclose(file) != -1, "Could not close the file!");
+
+    buffer->last += pipeline.size;
+    CTString whole = ct_buffer_view(buffer);
+    return ct_split(&whole, begining).after;
+}
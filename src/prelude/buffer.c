@@ -4,11 +4,13 @@
 #pragma once
 
 #include "prelude/expect.c"
+#include "prelude/memory.c"
 #include "prelude/scalar.c"
 #include "prelude/string.c"
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* Dynamic array of characters. */
 typedef struct {
@@ -57,15 +59,34 @@ void ct_buffer_reserve(CTBuffer* buffer, CTIndex amount)
     CTIndex new_capacity = capacity + growth;
     char*   memory = reallocarray(buffer->first, new_capacity, sizeof(char));
     ct_expect(memory != NULL, "Could not allocate!");
+    ct_memory_account(CT_MEMORY_BUFFER, capacity, new_capacity);
 
     buffer->last      = memory + ct_buffer_size(buffer);
     buffer->first     = memory;
     buffer->allocated = memory + new_capacity;
 }
 
+/* Add a copy of the string to the end. */
+void ct_buffer_append(CTBuffer* buffer, CTString const* string)
+{
+    CTIndex size = ct_string_size(string);
+    ct_buffer_reserve(buffer, size);
+    if (size != 0) {
+        memcpy(buffer->last, string->first, size);
+    }
+    buffer->last += size;
+}
+
+/* Remove the characters. Keeps the memory. */
+void ct_buffer_clear(CTBuffer* buffer)
+{
+    buffer->last = buffer->first;
+}
+
 /* Deallocate memory. */
 void ct_buffer_free(CTBuffer* buffer)
 {
+    ct_memory_account(CT_MEMORY_BUFFER, ct_buffer_capacity(buffer), 0);
     free(buffer->first);
     buffer->first     = NULL;
     buffer->last      = NULL;
@@ -0,0 +1,138 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "prelude/expect.c"
+#include "prelude/memory.c"
+#include "prelude/scalar.c"
+#include "prelude/string.c"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__)
+#    include <emmintrin.h>
+#endif
+
+/* Line and column of a character in a source. Both start from one. */
+typedef struct {
+    /* Line of the character. */
+    CTIndex line;
+    /* Column of the character. */
+    CTIndex column;
+} CTLocation;
+
+/* Offsets of the line starts in a source. Only found when they are first
+ * needed. */
+typedef struct {
+    /* Source the lines are in. */
+    CTString source;
+    /* Border before the first offset. */
+    CTIndex* first;
+    /* Border after the last offset. */
+    CTIndex* last;
+} CTLines;
+
+/* Lines of the source. */
+CTLines ct_lines(CTString source)
+{
+    return (CTLines){.source = source};
+}
+
+/* Amount of line feeds in the source. Counts 16 characters at a time when
+ * vector instructions are available. */
+CTIndex ct_lines_count(CTString const* source)
+{
+    CTIndex     count = 0;
+    char const* i     = source->first;
+#if defined(__SSE2__)
+    __m128i const feeds = _mm_set1_epi8('\n');
+    for (; source->last - i >= 16; i += 16) {
+        __m128i characters = _mm_loadu_si128((__m128i const*)i);
+        count += __builtin_popcount(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(characters, feeds)));
+    }
+#endif
+    for (; i < source->last; i++) {
+        count += *i == '\n';
+    }
+    return count;
+}
+
+/* Find the offsets of the line starts. */
+void ct_lines_build(CTLines* lines)
+{
+    CTIndex amount = ct_lines_count(&lines->source) + 1;
+    lines->first   = malloc(amount * sizeof(CTIndex));
+    ct_expect(lines->first != NULL, "Could not allocate!");
+    ct_memory_account(CT_MEMORY_LINES, 0, amount * (CTIndex)sizeof(CTIndex));
+    lines->last    = lines->first;
+    *lines->last++ = 0;
+
+    char const* i = lines->source.first;
+#if defined(__SSE2__)
+    __m128i const feeds = _mm_set1_epi8('\n');
+    for (; lines->source.last - i >= 16; i += 16) {
+        __m128i  characters = _mm_loadu_si128((__m128i const*)i);
+        unsigned mask =
+            (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(characters, feeds));
+        while (mask != 0) {
+            CTIndex feed   = i - lines->source.first + __builtin_ctz(mask);
+            *lines->last++ = feed + 1;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < lines->source.last; i++) {
+        if (*i == '\n') {
+            *lines->last++ = i - lines->source.first + 1;
+        }
+    }
+    ct_expect(lines->last - lines->first == amount, "Miscounted the lines!");
+}
+
+/* Line and column of the character at the offset. Finds the lines if they are
+ * not found yet, then searches them in logarithmic time. */
+CTLocation ct_lines_locate(CTLines* lines, CTIndex offset)
+{
+    ct_expect(
+        offset >= 0 && offset <= ct_string_size(&lines->source),
+        "Offset out of source bounds!");
+    if (lines->first == NULL) {
+        ct_lines_build(lines);
+    }
+
+    // Find the last line that starts at or before the offset.
+    CTIndex* low  = lines->first;
+    CTIndex* high = lines->last;
+    while (high - low > 1) {
+        CTIndex* middle = low + (high - low) / 2;
+        if (*middle <= offset) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return (CTLocation){
+        .line   = low - lines->first + 1,
+        .column = offset - *low + 1};
+}
+
+/* Line and column of the character at the position. */
+CTLocation ct_lines_locate_position(CTLines* lines, char const* position)
+{
+    return ct_lines_locate(lines, position - lines->source.first);
+}
+
+/* Deallocate memory. */
+void ct_lines_free(CTLines* lines)
+{
+    ct_memory_account(
+        CT_MEMORY_LINES,
+        (lines->last - lines->first) * (CTIndex)sizeof(CTIndex),
+        0);
+    free(lines->first);
+    lines->first = NULL;
+    lines->last  = NULL;
+}
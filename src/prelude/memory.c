@@ -0,0 +1,181 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "prelude/expect.c"
+#include "prelude/scalar.c"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Kind of container whose memory is accounted. */
+typedef enum {
+    /* Buffers of characters, and rings. */
+    CT_MEMORY_BUFFER,
+    /* Pieces and blocks of ropes. */
+    CT_MEMORY_ROPE,
+    /* Line starts of sources. */
+    CT_MEMORY_LINES,
+    /* Lexed tokens, both listed and compact. */
+    CT_MEMORY_TOKENS,
+    /* Compiled codes. */
+    CT_MEMORY_CODES,
+    /* Decoding states and their tags. */
+    CT_MEMORY_STATES,
+    /* Pattern information and indicies. */
+    CT_MEMORY_PATTERNS,
+    /* Nodes of the parsed trees. */
+    CT_MEMORY_NODES,
+    /* Tables of deterministic automata. */
+    CT_MEMORY_AUTOMATA,
+    /* Keyword tables. */
+    CT_MEMORY_KEYWORDS,
+    /* Machine code of patterns, both while it is written and once it is
+     * mapped. */
+    CT_MEMORY_MACHINE,
+    /* Amount of kinds. */
+    CT_MEMORY_KINDS
+} CTMemoryKind;
+
+/* Allocation counters of a kind. Containers might grow on any thread; thus,
+ * the counters are atomic. */
+typedef struct {
+    /* Amount of bytes that are allocated now. */
+    _Atomic CTIndex current;
+    /* Most amount of bytes that were allocated at the same time. */
+    _Atomic CTIndex peak;
+    /* Amount of bytes that were added by all the allocations. */
+    _Atomic CTIndex allocated;
+    /* Amount of allocations and reallocations. */
+    _Atomic CTIndex reallocations;
+} CTMemory;
+
+/* Counters of each kind. */
+static CTMemory ct_memory_kinds[CT_MEMORY_KINDS];
+
+/* Counters of all the kinds together, whose peak is the real one rather than
+ * the sum of the peaks. */
+static CTMemory ct_memory_total;
+
+/* Names of the kinds in the report. */
+static char const* const ct_memory_names[CT_MEMORY_KINDS] = {
+    "buffer",
+    "rope",
+    "lines",
+    "tokens",
+    "codes",
+    "states",
+    "patterns",
+    "nodes",
+    "automata",
+    "keywords",
+    "machine"};
+
+/* Record the change of the memory to the counters. */
+void ct_memory_count(CTMemory* memory, CTIndex old_size, CTIndex new_size)
+{
+    CTIndex change  = new_size - old_size;
+    CTIndex current = atomic_fetch_add_explicit(
+                          &memory->current,
+                          change,
+                          memory_order_relaxed) +
+                      change;
+    CTIndex peak = atomic_load_explicit(&memory->peak, memory_order_relaxed);
+    while (current > peak && !atomic_compare_exchange_weak_explicit(
+                                 &memory->peak,
+                                 &peak,
+                                 current,
+                                 memory_order_relaxed,
+                                 memory_order_relaxed)) {}
+    if (new_size > 0) {
+        atomic_fetch_add_explicit(
+            &memory->reallocations,
+            1,
+            memory_order_relaxed);
+    }
+    if (change > 0) {
+        atomic_fetch_add_explicit(
+            &memory->allocated,
+            change,
+            memory_order_relaxed);
+    }
+}
+
+/* Record that a container of the kind went from the old to the new amount of
+ * bytes. New size of zero is a deallocation. */
+void ct_memory_account(CTMemoryKind kind, CTIndex old_size, CTIndex new_size)
+{
+    ct_memory_count(ct_memory_kinds + kind, old_size, new_size);
+    ct_memory_count(&ct_memory_total, old_size, new_size);
+}
+
+/* Allocate zeroed memory for the amount of elements of the width, and account
+ * it to the kind. */
+void* ct_memory_allocate(CTMemoryKind kind, CTIndex amount, CTIndex width)
+{
+    void* memory = calloc(amount > 0 ? amount : 1, width);
+    ct_expect(memory != NULL, "Could not allocate!");
+    ct_memory_account(kind, 0, amount * width);
+    return memory;
+}
+
+/* Resize the memory from the old to the new amount of elements of the width,
+ * and account the change to the kind. The added elements are not zeroed. */
+void* ct_memory_resize(
+    CTMemoryKind kind,
+    void*        memory,
+    CTIndex      old_amount,
+    CTIndex      new_amount,
+    CTIndex      width)
+{
+    void* resized = reallocarray(memory, new_amount, width);
+    ct_expect(resized != NULL, "Could not allocate!");
+    ct_memory_account(kind, old_amount * width, new_amount * width);
+    return resized;
+}
+
+/* Deallocate the memory of the amount of elements of the width, and account it
+ * to the kind. */
+void ct_memory_free(
+    CTMemoryKind kind,
+    void*        memory,
+    CTIndex      amount,
+    CTIndex      width)
+{
+    if (memory != NULL) {
+        ct_memory_account(kind, amount * width, 0);
+    }
+    free(memory);
+}
+
+/* Print a row of the report. */
+void ct_memory_row(FILE* stream, char const* name, CTMemory* memory)
+{
+    fprintf(
+        stream,
+        "%-10s %14td %14td %14td %10td\n",
+        name,
+        atomic_load(&memory->peak),
+        atomic_load(&memory->current),
+        atomic_load(&memory->allocated),
+        atomic_load(&memory->reallocations));
+}
+
+/* Print the counters of each kind and the total to the stream. */
+void ct_memory_report(FILE* stream)
+{
+    fprintf(
+        stream,
+        "%-10s %14s %14s %14s %10s\n",
+        "kind",
+        "peak",
+        "current",
+        "allocated",
+        "reallocs");
+    for (int i = 0; i < CT_MEMORY_KINDS; i++) {
+        ct_memory_row(stream, ct_memory_names[i], ct_memory_kinds + i);
+    }
+    ct_memory_row(stream, "total", &ct_memory_total);
+}
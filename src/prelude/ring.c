@@ -0,0 +1,107 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "prelude/expect.c"
+#include "prelude/memory.c"
+#include "prelude/scalar.c"
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Bounded queue of fixed size elements between a single producer thread and a
+ * single consumer thread. Without locks; each side only writes its own
+ * counter, and publishes the elements with it. */
+typedef struct {
+    /* Memory of the elements. */
+    unsigned char* elements;
+    /* Amount of bytes of an element. */
+    CTIndex width;
+    /* Amount of elements that fit, which is a power of two. */
+    CTIndex capacity;
+    /* Amount of elements that were ever pushed. Written by the producer. */
+    _Atomic CTIndex pushed;
+    /* Amount of elements that were ever popped. Written by the consumer. */
+    _Atomic CTIndex popped;
+} CTRing;
+
+/* Ring of the amount of elements, which must be a power of two, with the
+ * width. */
+CTRing ct_ring(CTIndex capacity, CTIndex width)
+{
+    ct_expect(
+        capacity > 0 && (capacity & (capacity - 1)) == 0,
+        "Ring capacity is not a power of two!");
+    CTRing ring = {.width = width, .capacity = capacity};
+    ring.elements = calloc(capacity, width);
+    ct_expect(ring.elements != NULL, "Could not allocate!");
+    ct_memory_account(CT_MEMORY_BUFFER, 0, capacity * width);
+    atomic_init(&ring.pushed, 0);
+    atomic_init(&ring.popped, 0);
+    return ring;
+}
+
+/* Memory of the element that is the amount of elements after the start. */
+unsigned char* ct_ring_at(CTRing const* ring, CTIndex count)
+{
+    return ring->elements + (count & (ring->capacity - 1)) * ring->width;
+}
+
+/* Try to copy the element to the end. Returns whether there was space. Only
+ * called from the producer. */
+bool ct_ring_try_push(CTRing* ring, void const* element)
+{
+    CTIndex pushed = atomic_load_explicit(&ring->pushed, memory_order_relaxed);
+    CTIndex popped = atomic_load_explicit(&ring->popped, memory_order_acquire);
+    if (pushed - popped == ring->capacity) {
+        return false;
+    }
+    memcpy(ct_ring_at(ring, pushed), element, ring->width);
+    atomic_store_explicit(&ring->pushed, pushed + 1, memory_order_release);
+    return true;
+}
+
+/* Try to move the element at the start to the given memory. Returns whether
+ * there was an element. Only called from the consumer. */
+bool ct_ring_try_pop(CTRing* ring, void* element)
+{
+    CTIndex popped = atomic_load_explicit(&ring->popped, memory_order_relaxed);
+    CTIndex pushed = atomic_load_explicit(&ring->pushed, memory_order_acquire);
+    if (pushed == popped) {
+        return false;
+    }
+    memcpy(element, ct_ring_at(ring, popped), ring->width);
+    atomic_store_explicit(&ring->popped, popped + 1, memory_order_release);
+    return true;
+}
+
+/* Copy the element to the end, waiting for space if the ring is full. */
+void ct_ring_push(CTRing* ring, void const* element)
+{
+    while (!ct_ring_try_push(ring, element)) {
+        sched_yield();
+    }
+}
+
+/* Move the element at the start to the given memory, waiting for one if the
+ * ring is empty. */
+void ct_ring_pop(CTRing* ring, void* element)
+{
+    while (!ct_ring_try_pop(ring, element)) {
+        sched_yield();
+    }
+}
+
+/* Deallocate memory. */
+void ct_ring_free(CTRing* ring)
+{
+    if (ring->elements != NULL) {
+        ct_memory_account(CT_MEMORY_BUFFER, ring->capacity * ring->width, 0);
+    }
+    free(ring->elements);
+    ring->elements = NULL;
+}
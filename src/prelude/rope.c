@@ -0,0 +1,232 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "prelude/expect.c"
+#include "prelude/memory.c"
+#include "prelude/scalar.c"
+#include "prelude/string.c"
+#include "prelude/writer.c"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#if !defined(IOV_MAX)
+#    define IOV_MAX 1024
+#endif
+
+/* Amount of characters in a block. */
+#define CT_ROPE_BLOCK 65536
+
+/* Fixed amount of characters that are copied to a rope. */
+typedef struct CTRopeBlock {
+    /* Block that is used after this one. */
+    struct CTRopeBlock* next;
+    /* Amount of used characters. */
+    CTIndex size;
+    /* Characters. */
+    char characters[CT_ROPE_BLOCK];
+} CTRopeBlock;
+
+/* Characters that are written together, which are kept as pieces that refer
+ * to other strings instead of a contiguous copy. Copied characters are kept
+ * in fixed blocks that never move, so growing never copies the characters
+ * again. */
+typedef struct {
+    /* Border before the first piece. */
+    struct iovec* first;
+    /* Border after the last piece. */
+    struct iovec* last;
+    /* Border after the last allocated piece. */
+    struct iovec* allocated;
+    /* First block. */
+    CTRopeBlock* blocks;
+    /* Block that is copied to. */
+    CTRopeBlock* current;
+} CTRope;
+
+/* Amount of pieces. */
+CTIndex ct_rope_pieces(CTRope const* rope)
+{
+    return rope->last - rope->first;
+}
+
+/* Amount of characters. */
+CTIndex ct_rope_size(CTRope const* rope)
+{
+    CTIndex size = 0;
+    for (struct iovec const* i = rope->first; i < rope->last; i++) {
+        size += (CTIndex)i->iov_len;
+    }
+    return size;
+}
+
+/* Make sure the amount of pieces will fit. Grows by at least the half of the
+ * current capacity if necessary. */
+void ct_rope_reserve(CTRope* rope, CTIndex amount)
+{
+    ct_expect(amount >= 0, "Reserving negative amount!");
+    CTIndex growth = amount - (rope->allocated - rope->last);
+    if (growth <= 0) {
+        return;
+    }
+
+    CTIndex capacity      = rope->allocated - rope->first;
+    CTIndex half_capacity = capacity >> 1;
+    if (growth < half_capacity) {
+        growth = half_capacity;
+    }
+
+    CTIndex       new_capacity = capacity + growth;
+    struct iovec* memory =
+        reallocarray(rope->first, new_capacity, sizeof(struct iovec));
+    ct_expect(memory != NULL, "Could not allocate!");
+    ct_memory_account(
+        CT_MEMORY_ROPE,
+        capacity * (CTIndex)sizeof(struct iovec),
+        new_capacity * (CTIndex)sizeof(struct iovec));
+
+    rope->last      = memory + ct_rope_pieces(rope);
+    rope->first     = memory;
+    rope->allocated = memory + new_capacity;
+}
+
+/* Add the characters between the borders as a piece. Joins them to the last
+ * piece if they directly follow it. */
+void ct_rope_piece(CTRope* rope, char const* first, char const* last)
+{
+    if (first == last) {
+        return;
+    }
+    if (rope->first < rope->last) {
+        struct iovec* previous = rope->last - 1;
+        if ((char const*)previous->iov_base + previous->iov_len == first) {
+            previous->iov_len += last - first;
+            return;
+        }
+    }
+    ct_rope_reserve(rope, 1);
+    *rope->last++ =
+        (struct iovec){.iov_base = (void*)first, .iov_len = last - first};
+}
+
+/* Add the string without copying it. The string must not change until the
+ * rope is written. */
+void ct_rope_slice(CTRope* rope, CTString const* string)
+{
+    ct_rope_piece(rope, string->first, string->last);
+}
+
+/* Add the null-terminated string without copying it. */
+void ct_rope_terminated(CTRope* rope, char const* terminated)
+{
+    CTString string = ct_string_terminated(terminated);
+    ct_rope_slice(rope, &string);
+}
+
+/* Block that has space to copy to. */
+CTRopeBlock* ct_rope_block(CTRope* rope)
+{
+    if (rope->current != NULL && rope->current->size < CT_ROPE_BLOCK) {
+        return rope->current;
+    }
+
+    // Reuse the blocks that were kept while clearing before allocating.
+    CTRopeBlock* next =
+        rope->current == NULL ? rope->blocks : rope->current->next;
+    if (next == NULL) {
+        next = malloc(sizeof(CTRopeBlock));
+        ct_expect(next != NULL, "Could not allocate!");
+        ct_memory_account(CT_MEMORY_ROPE, 0, sizeof(CTRopeBlock));
+        next->next = NULL;
+        if (rope->current == NULL) {
+            rope->blocks = next;
+        } else {
+            rope->current->next = next;
+        }
+    }
+    next->size    = 0;
+    rope->current = next;
+    return next;
+}
+
+/* Add a copy of the string. */
+void ct_rope_copy(CTRope* rope, CTString const* string)
+{
+    char const* first = string->first;
+    while (first < string->last) {
+        CTRopeBlock* block  = ct_rope_block(rope);
+        CTIndex      amount = CT_ROPE_BLOCK - block->size;
+        if (amount > string->last - first) {
+            amount = string->last - first;
+        }
+        char* copy = block->characters + block->size;
+        memcpy(copy, first, amount);
+        block->size += amount;
+        ct_rope_piece(rope, copy, copy + amount);
+        first += amount;
+    }
+}
+
+/* Add a copy of the character. */
+void ct_rope_character(CTRope* rope, char character)
+{
+    CTString string = {.first = &character, .last = &character + 1};
+    ct_rope_copy(rope, &string);
+}
+
+/* Write all the characters to the file descriptor. Gives the pieces to the
+ * system in batches that it accepts at once. */
+void ct_rope_write(CTRope const* rope, int descriptor)
+{
+    struct iovec const* i = rope->first;
+    while (i < rope->last) {
+        CTIndex batch = rope->last - i;
+        if (batch > IOV_MAX) {
+            batch = IOV_MAX;
+        }
+        ssize_t written = writev(descriptor, i, (int)batch);
+        ct_expect(written > 0, "Could not write!");
+
+        // Skip the written pieces, and finish the one that was cut.
+        while (i < rope->last && (size_t)written >= i->iov_len) {
+            written -= (ssize_t)i->iov_len;
+            i++;
+        }
+        if (written > 0) {
+            char const* first = i->iov_base;
+            ct_writer_write(descriptor, first + written, first + i->iov_len);
+            i++;
+        }
+    }
+}
+
+/* Remove the characters. Keeps the memory. */
+void ct_rope_clear(CTRope* rope)
+{
+    rope->last    = rope->first;
+    rope->current = NULL;
+}
+
+/* Deallocate memory. */
+void ct_rope_free(CTRope* rope)
+{
+    while (rope->blocks != NULL) {
+        CTRopeBlock* next = rope->blocks->next;
+        ct_memory_account(CT_MEMORY_ROPE, sizeof(CTRopeBlock), 0);
+        free(rope->blocks);
+        rope->blocks = next;
+    }
+    ct_memory_account(
+        CT_MEMORY_ROPE,
+        (rope->allocated - rope->first) * (CTIndex)sizeof(struct iovec),
+        0);
+    free(rope->first);
+    rope->first     = NULL;
+    rope->last      = NULL;
+    rope->allocated = NULL;
+    rope->current   = NULL;
+}
@@ -0,0 +1,108 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "prelude/expect.c"
+#include "prelude/scalar.c"
+#include "prelude/string.c"
+
+/* Biggest code point. */
+#define CT_UTF8_LAST 0x10FFFF
+
+/* First code point that is a surrogate, which cannot be encoded. */
+#define CT_UTF8_SURROGATE_FIRST 0xD800
+
+/* Last code point that is a surrogate. */
+#define CT_UTF8_SURROGATE_LAST 0xDFFF
+
+/* Amount of bytes that encode the code point. */
+int ct_utf8_size(CTIndex code_point)
+{
+    ct_expect(
+        code_point >= 0 && code_point <= CT_UTF8_LAST &&
+            (code_point < CT_UTF8_SURROGATE_FIRST ||
+             code_point > CT_UTF8_SURROGATE_LAST),
+        "Not a valid code point!");
+    if (code_point < 0x80) {
+        return 1;
+    }
+    if (code_point < 0x800) {
+        return 2;
+    }
+    if (code_point < 0x10000) {
+        return 3;
+    }
+    return 4;
+}
+
+/* Encode the code point to the bytes. Returns the amount of bytes. */
+int ct_utf8_encode(CTIndex code_point, unsigned char* bytes)
+{
+    int size = ct_utf8_size(code_point);
+    if (size == 1) {
+        bytes[0] = (unsigned char)code_point;
+        return 1;
+    }
+
+    // Continuation bytes carry 6 bits each from the end, and the leading byte
+    // marks the size with as many high bits.
+    for (int i = size - 1; i > 0; i--) {
+        bytes[i] = (unsigned char)(0x80 | (code_point & 0x3F));
+        code_point >>= 6;
+    }
+    bytes[0] = (unsigned char)(((0xF00 >> size) & 0xFF) | code_point);
+    return size;
+}
+
+/* Decode the code point at the start of the string. Returns the amount of
+ * bytes it took, or zero if the string does not start with a valid encoding,
+ * which includes the longer than necessary ones. */
+int ct_utf8_decode(CTString const* string, CTIndex* code_point)
+{
+    CTIndex available = ct_string_size(string);
+    if (available == 0) {
+        return 0;
+    }
+
+    unsigned char leading = (unsigned char)string->first[0];
+    int           size    = 0;
+    CTIndex       result  = 0;
+    if (leading < 0x80) {
+        *code_point = leading;
+        return 1;
+    } else if (leading >= 0xC2 && leading <= 0xDF) {
+        size   = 2;
+        result = leading & 0x1F;
+    } else if (leading >= 0xE0 && leading <= 0xEF) {
+        size   = 3;
+        result = leading & 0x0F;
+    } else if (leading >= 0xF0 && leading <= 0xF4) {
+        size   = 4;
+        result = leading & 0x07;
+    } else {
+        return 0;
+    }
+    if (available < size) {
+        return 0;
+    }
+
+    for (int i = 1; i < size; i++) {
+        unsigned char continuation = (unsigned char)string->first[i];
+        if ((continuation & 0xC0) != 0x80) {
+            return 0;
+        }
+        result = result << 6 | (continuation & 0x3F);
+    }
+
+    // Reject overlong encodings, surrogates and the code points after the
+    // last one.
+    if (result > CT_UTF8_LAST ||
+        (result >= CT_UTF8_SURROGATE_FIRST &&
+         result <= CT_UTF8_SURROGATE_LAST) ||
+        ct_utf8_size(result) != size) {
+        return 0;
+    }
+    *code_point = result;
+    return size;
+}
@@ -0,0 +1,138 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "prelude/buffer.c"
+#include "prelude/expect.c"
+#include "prelude/scalar.c"
+#include "prelude/string.c"
+
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Amount of characters that are collected before writing them. */
+#define CT_WRITER_CAPACITY 65536
+
+/* Collects formatted characters and writes them to a file descriptor in big
+ * chunks. */
+typedef struct {
+    /* Characters that are not written yet. */
+    CTBuffer buffer;
+    /* File descriptor that is written to. */
+    int descriptor;
+    /* File descriptor that is written the same characters. Negative means
+     * there is none. */
+    int copy;
+} CTWriter;
+
+/* Writer to the file descriptor. */
+CTWriter ct_writer(int descriptor)
+{
+    return (CTWriter){.descriptor = descriptor, .copy = -1};
+}
+
+/* Write all the characters to the file descriptor. */
+void ct_writer_write(int descriptor, char const* first, char const* last)
+{
+    while (first < last) {
+        ssize_t written = write(descriptor, first, last - first);
+        ct_expect(written > 0, "Could not write!");
+        first += written;
+    }
+}
+
+/* Write all the collected characters. */
+void ct_writer_flush(CTWriter* writer)
+{
+    ct_writer_write(
+        writer->descriptor,
+        writer->buffer.first,
+        writer->buffer.last);
+    if (writer->copy >= 0) {
+        ct_writer_write(writer->copy, writer->buffer.first, writer->buffer.last);
+    }
+    ct_buffer_clear(&writer->buffer);
+}
+
+/* Make sure the amount of characters fits without going over the capacity.
+ * Writes the collected characters if necessary. */
+void ct_writer_reserve(CTWriter* writer, CTIndex amount)
+{
+    if (ct_buffer_size(&writer->buffer) + amount > CT_WRITER_CAPACITY) {
+        ct_writer_flush(writer);
+    }
+    ct_buffer_reserve(&writer->buffer, amount);
+}
+
+/* Collect the character. */
+void ct_writer_character(CTWriter* writer, char character)
+{
+    ct_writer_reserve(writer, 1);
+    *writer->buffer.last++ = character;
+}
+
+/* Collect the characters in the string. */
+void ct_writer_string(CTWriter* writer, CTString const* string)
+{
+    CTIndex size = ct_string_size(string);
+    if (size > CT_WRITER_CAPACITY) {
+        // Do not copy what is going to be written right away.
+        ct_writer_flush(writer);
+        ct_writer_write(writer->descriptor, string->first, string->last);
+        if (writer->copy >= 0) {
+            ct_writer_write(writer->copy, string->first, string->last);
+        }
+        return;
+    }
+    ct_writer_reserve(writer, size);
+    memcpy(writer->buffer.last, string->first, size);
+    writer->buffer.last += size;
+}
+
+/* Collect the characters of the null terminated string. */
+void ct_writer_terminated(CTWriter* writer, char const* terminated_string)
+{
+    CTString string = ct_string_terminated(terminated_string);
+    ct_writer_string(writer, &string);
+}
+
+/* Collect the decimal digits of the integer. Puts zeros in front of the
+ * digits until there are at least the width amount of them. Puts the sign
+ * even if it is positive, when forced. */
+void ct_writer_integer(
+    CTWriter* writer,
+    CTIndex   integer,
+    int       width,
+    bool      forced_sign)
+{
+    // Enough for the digits of the biggest integer.
+    char  digits[32];
+    char* first = digits + sizeof(digits);
+
+    // Go through negative values, which can hold the smallest integer.
+    CTIndex negative = integer < 0 ? integer : -integer;
+    do {
+        *--first = (char)('0' - negative % 10);
+        negative /= 10;
+    } while (negative != 0);
+    while (digits + sizeof(digits) - first < width && first > digits) {
+        *--first = '0';
+    }
+
+    if (integer < 0) {
+        ct_writer_character(writer, '-');
+    } else if (forced_sign) {
+        ct_writer_character(writer, '+');
+    }
+    CTString string = {.first = first, .last = digits + sizeof(digits)};
+    ct_writer_string(writer, &string);
+}
+
+/* Write the collected characters and deallocate memory. */
+void ct_writer_free(CTWriter* writer)
+{
+    ct_writer_flush(writer);
+    ct_buffer_free(&writer->buffer);
+}
@@ -0,0 +1,271 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "prelude/buffer.c"
+#include "prelude/expect.c"
+#include "prelude/scalar.c"
+#include "prelude/string.c"
+#include "prelude/writer.c"
+#include "session.c"
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Size of chunks the connections are read by. */
+#define CT_SERVER_CHUNK 4096
+
+/* Seconds the server waits for a client to send its request or to read the
+ * answer. */
+#define CT_SERVER_TIMEOUT 5
+
+/* Request that stops the server. */
+#define CT_SERVER_STOP "--stop"
+
+/* Address of the socket at the path. */
+struct sockaddr_un ct_server_address(char const* path)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    ct_expect(
+        strlen(path) < sizeof(address.sun_path),
+        "Socket path is too long!");
+    strcpy(address.sun_path, path);
+    return address;
+}
+
+/* Read from the file descriptor to the buffer until the end. Returns whether
+ * the end is reached, which is not the case when reading fails or times out. */
+bool ct_server_read(CTBuffer* buffer, int descriptor)
+{
+    ssize_t read_amount = 0;
+    do {
+        ct_buffer_reserve(buffer, CT_SERVER_CHUNK);
+        read_amount = read(descriptor, buffer->last, CT_SERVER_CHUNK);
+        if (read_amount < 0) {
+            return false;
+        }
+        buffer->last += read_amount;
+    } while (read_amount > 0);
+    return true;
+}
+
+/* Answer the request, which is the working directory and the arguments as null
+ * terminated strings, by running the arguments to the connection. Runs in a
+ * child of the server, so the directory, the options, the redirections and the
+ * aborts of a bad source do not reach the server. */
+_Noreturn void
+ct_server_answer(CTSession* session, CTString request, int connection)
+{
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+
+    // Print the output and the errors to the connection.
+    ct_expect(
+        dup2(connection, STDOUT_FILENO) != -1 &&
+            dup2(connection, STDERR_FILENO) != -1,
+        "Could not redirect the output!");
+    close(connection);
+
+    char const* directory = request.first;
+    request.first += strlen(directory) + 1;
+    ct_expect(chdir(directory) == 0, "Could not change the directory!");
+
+    int count = 0;
+    for (char const* i = request.first; i < request.last; i += strlen(i) + 1) {
+        count++;
+    }
+    char const** arguments = malloc(sizeof(char const*) * (count + 1));
+    ct_expect(arguments != NULL, "Could not allocate!");
+    for (int i = 0; i < count; i++) {
+        arguments[i] = request.first;
+        request.first += strlen(request.first) + 1;
+    }
+
+    int status = ct_session_run(session, count, arguments);
+    fflush(stderr);
+    _exit(status);
+}
+
+/* Compile the request in a child and send its exit status to the connection
+ * after its output as a single byte. Children that are killed by a signal, like
+ * the aborts of the errors, end with 128 and the signal. Returns whether the
+ * server should continue. */
+bool ct_server_fork(CTSession* session, CTString request, int connection)
+{
+    char const* arguments = request.first + strlen(request.first) + 1;
+    bool        stop      = arguments < request.last &&
+                 strcmp(arguments, CT_SERVER_STOP) == 0;
+
+    int status = 0;
+    if (!stop) {
+        pid_t child = fork();
+        if (child == 0) {
+            ct_server_answer(session, request, connection);
+        }
+        if (child == -1 || waitpid(child, &status, 0) != child) {
+            status = 1;
+        } else if (WIFEXITED(status)) {
+            status = WEXITSTATUS(status);
+        } else {
+            status = 128 + WTERMSIG(status);
+        }
+    }
+
+    unsigned char byte = (unsigned char)status;
+    if (write(connection, &byte, 1) != 1) {
+        fprintf(stderr, "Could not send the status to a client!\n");
+    }
+    return !stop;
+}
+
+/* Whether a signal asked the server to stop. */
+volatile sig_atomic_t ct_server_stopped = 0;
+
+/* Ask the server to stop. */
+void ct_server_stop(int signal)
+{
+    (void)signal;
+    ct_server_stopped = 1;
+}
+
+/* Serve compilations through the socket at the path until a stop request or an
+ * interrupt. Only the owner can connect to the socket, and it is removed when
+ * the server stops. Each request is compiled in a child of the server, which
+ * starts from the memory of the server's session. Compiles the patterns of the
+ * token file once before serving if there is one, so the requests that
+ * generate from it inherit them. */
+void ct_server_serve(char const* path, char const* patterns)
+{
+    // A client that leaves early must not end the server.
+    signal(SIGPIPE, SIG_IGN);
+
+    // Stop by removing the socket on interrupts. Without restarting, accept
+    // returns when one arrives.
+    struct sigaction stop = {.sa_handler = &ct_server_stop};
+    sigemptyset(&stop.sa_mask);
+    ct_expect(
+        sigaction(SIGINT, &stop, NULL) == 0 &&
+            sigaction(SIGTERM, &stop, NULL) == 0,
+        "Could not handle the interrupts!");
+
+    // Compile before creating the socket, so a bad token file does not leave
+    // it behind.
+    CTSession session = ct_session(STDOUT_FILENO);
+    if (patterns != NULL) {
+        ct_session_patterns(&session, patterns);
+    }
+
+    // Replace the socket of an old server, but nothing else.
+    struct stat status = {0};
+    if (stat(path, &status) == 0) {
+        ct_expect(S_ISSOCK(status.st_mode), "Path is not a socket!");
+        ct_expect(unlink(path) == 0, "Could not remove the old socket!");
+    }
+
+    struct sockaddr_un address  = ct_server_address(path);
+    int                listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    ct_expect(listener != -1, "Could not create the socket!");
+    mode_t mask = umask(0077);
+    ct_expect(
+        bind(listener, (struct sockaddr const*)&address, sizeof(address)) == 0,
+        "Could not bind the socket!");
+    umask(mask);
+    ct_expect(listen(listener, SOMAXCONN) == 0, "Could not listen!");
+    printf("Serving at %s...\n", path);
+    fflush(stdout);
+
+    CTBuffer       request = {0};
+    bool           serving = true;
+    struct timeval timeout = {.tv_sec = CT_SERVER_TIMEOUT};
+    while (serving && !ct_server_stopped) {
+        int connection = accept(listener, NULL, NULL);
+        if (connection == -1) {
+            continue;
+        }
+
+        // Drop the clients that do not finish their requests or do not read
+        // the answers in time, instead of waiting for them.
+        setsockopt(
+            connection,
+            SOL_SOCKET,
+            SO_RCVTIMEO,
+            &timeout,
+            sizeof(timeout));
+        setsockopt(
+            connection,
+            SOL_SOCKET,
+            SO_SNDTIMEO,
+            &timeout,
+            sizeof(timeout));
+        ct_buffer_clear(&request);
+        if (ct_server_read(&request, connection) &&
+            ct_buffer_size(&request) != 0 && *(request.last - 1) == '\0') {
+            serving =
+                ct_server_fork(&session, ct_buffer_view(&request), connection);
+        }
+        close(connection);
+    }
+
+    close(listener);
+    unlink(path);
+    ct_buffer_free(&request);
+    ct_session_free(&session);
+}
+
+/* Send the working directory and the arguments to the server at the socket
+ * path, and print what it answers. Returns the exit status of the
+ * compilation. */
+int ct_server_forward(
+    char const*        path,
+    int                argument_count,
+    char const* const* arguments)
+{
+    CTBuffer request = {0};
+    ct_buffer_reserve(&request, CT_SERVER_CHUNK);
+    while (getcwd(request.first, ct_buffer_capacity(&request)) == NULL) {
+        ct_buffer_reserve(&request, ct_buffer_capacity(&request) + 1);
+    }
+    request.last += strlen(request.first) + 1;
+    for (int i = 0; i < argument_count; i++) {
+        size_t size = strlen(arguments[i]) + 1;
+        ct_buffer_reserve(&request, (CTIndex)size);
+        memcpy(request.last, arguments[i], size);
+        request.last += size;
+    }
+
+    struct sockaddr_un address    = ct_server_address(path);
+    int                connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    ct_expect(connection != -1, "Could not create the socket!");
+    ct_expect(
+        connect(
+            connection,
+            (struct sockaddr const*)&address,
+            sizeof(address)) == 0,
+        "Could not connect to the server!");
+    ct_writer_write(connection, request.first, request.last);
+    ct_expect(
+        shutdown(connection, SHUT_WR) == 0,
+        "Could not finish the request!");
+
+    ct_buffer_clear(&request);
+    ct_expect(
+        ct_server_read(&request, connection),
+        "Could not read the answer!");
+    close(connection);
+    ct_expect(ct_buffer_size(&request) != 0, "Server did not answer!");
+    int status = (unsigned char)*--request.last;
+    fflush(stdout);
+    ct_writer_write(STDOUT_FILENO, request.first, request.last);
+    ct_buffer_free(&request);
+    return status;
+}
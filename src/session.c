@@ -0,0 +1,234 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "cache.c"
+#include "options.c"
+#include "patlak/compact.c"
+#include "patlak/context.c"
+#include "patlak/generator.c"
+#include "patlak/keywords.c"
+#include "patlak/lexer.c"
+#include "patlak/loader.c"
+#include "patlak/printer.c"
+#include "patlak/token.c"
+#include "pipeline.c"
+#include "prelude/buffer.c"
+#include "prelude/file.c"
+#include "prelude/lines.c"
+#include "prelude/memory.c"
+#include "prelude/rope.c"
+#include "prelude/string.c"
+#include "prelude/writer.c"
+#include "thrice/emitter.c"
+#include "thrice/parser.c"
+#include "thrice/tree.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Memory that is kept between compilations. */
+typedef struct {
+    /* Contents of the compiled file. */
+    CTBuffer buffer;
+    /* Keyword table of Thrice sources. */
+    CTPatlakKeywords keywords;
+    /* Tokens of the compiled file. */
+    CTPatlakCompactTokens tokens;
+    /* Nodes of the compiled file. */
+    CTThriceTree tree;
+    /* C code of the compiled file. */
+    CTRope rope;
+    /* Output of the compilations. */
+    CTWriter writer;
+    /* Outputs of earlier compilations. */
+    CTCache cache;
+    /* Resolved path of the token file whose patterns are compiled, or null. */
+    char* patterns;
+    /* Modification time of the token file when it was loaded. */
+    struct timespec modified;
+    /* Contents of the token file. */
+    CTBuffer patterns_file;
+    /* Compiled patterns of the token file. */
+    CTPatlakTokenSet set;
+} CTSession;
+
+/* Session that outputs to the file descriptor. */
+CTSession ct_session(int descriptor)
+{
+    return (CTSession){
+        .keywords = ct_thrice_parser_keywords(),
+        .writer   = ct_writer(descriptor)};
+}
+
+/* Whether the file at the path is a Thrice source. */
+bool ct_session_source(char const* path)
+{
+    size_t size = strlen(path);
+    return size >= 4 && strcmp(path + size - 4, ".thr") == 0;
+}
+
+/* Transpile the lexed Thrice source to C and write it to the output. */
+void ct_session_transpile(CTSession* session, CTString file, char const* path)
+{
+    CTLines lines = ct_lines(file);
+    ct_thrice_tree_clear(&session->tree);
+    ct_thrice_parse(&session->tree, &session->tokens, &lines, path);
+    ct_lines_free(&lines);
+
+    ct_rope_clear(&session->rope);
+    ct_thrice_emit(&session->rope, &session->tree, &session->tokens);
+    ct_writer_flush(&session->writer);
+    ct_rope_write(&session->rope, session->writer.descriptor);
+    if (session->writer.copy >= 0) {
+        ct_rope_write(&session->rope, session->writer.copy);
+    }
+}
+
+/* Compiled patterns of the token file at the path. Loads and compiles them
+ * unless they are already in the session and the file did not change since,
+ * so a resident session compiles each token file once. */
+CTPatlakTokenSet const*
+ct_session_patterns(CTSession* session, char const* path)
+{
+    char*       resolved = realpath(path, NULL);
+    struct stat status   = {0};
+    ct_expect(
+        resolved != NULL && stat(resolved, &status) == 0,
+        "Could not open the token file!");
+    if (session->patterns != NULL && strcmp(resolved, session->patterns) == 0 &&
+        status.st_mtim.tv_sec == session->modified.tv_sec &&
+        status.st_mtim.tv_nsec == session->modified.tv_nsec) {
+        free(resolved);
+        return &session->set;
+    }
+
+    free(session->patterns);
+    ct_patlak_token_set_free(&session->set);
+    session->set = (CTPatlakTokenSet){0};
+    ct_buffer_clear(&session->patterns_file);
+    ct_patlak_load(
+        &session->set,
+        ct_file_load(&session->patterns_file, resolved));
+    ct_patlak_optimize(&session->set.context);
+    session->patterns = resolved;
+    session->modified = status.st_mtim;
+    return &session->set;
+}
+
+/* Write C code that matches the patterns in the token file at the path, with
+ * the prefix before the names, to the output. */
+void ct_session_generate(
+    CTSession*  session,
+    char const* path,
+    char const* prefix)
+{
+    ct_patlak_generate(
+        &session->writer,
+        ct_session_patterns(session, path),
+        prefix);
+    ct_writer_flush(&session->writer);
+}
+
+/* Compile the file at the path. Thrice sources are transpiled to C, and
+ * the tokens of the other files are printed. */
+void ct_session_compile(CTSession* session, char const* path)
+{
+    ct_writer_terminated(&session->writer, "Compiling ");
+    ct_writer_terminated(&session->writer, path);
+    ct_writer_terminated(&session->writer, "...\n");
+    ct_buffer_clear(&session->buffer);
+    bool                    source   = ct_session_source(path);
+    CTPatlakKeywords const* keywords = source ? &session->keywords : NULL;
+
+    // Without a cache nothing needs the whole file first; so, load, lex and
+    // print on separate threads to overlap them.
+    if (!ct_cache_enabled(&session->cache)) {
+        CTString file = ct_pipeline(
+            &session->buffer,
+            &session->tokens,
+            path,
+            keywords,
+            source ? NULL : &session->writer);
+        if (source) {
+            ct_session_transpile(session, file, path);
+        } else {
+            ct_writer_flush(&session->writer);
+        }
+        return;
+    }
+
+    // Skip lexing and printing when the same contents were compiled before.
+    CTString file = ct_file_load(&session->buffer, path);
+    uint64_t key  = ct_cache_key(&session->cache, &file, source, keywords);
+    if (ct_cache_load(&session->cache, key, &session->writer)) {
+        ct_writer_flush(&session->writer);
+        return;
+    }
+    ct_cache_begin(&session->cache, key, &session->writer);
+
+    ct_patlak_lexer_file_compact(&session->tokens, file, keywords);
+    if (source) {
+        ct_session_transpile(session, file, path);
+    } else {
+        ct_patlak_printer_file(&session->writer, &session->tokens);
+        ct_writer_flush(&session->writer);
+    }
+    ct_cache_end(&session->cache, key, &session->writer);
+}
+
+/* Run the arguments of a command line. Either generates C code with
+ * "--generate <token file> [prefix]", or compiles the files with the options
+ * among them. Returns the exit status, which is 1 if a file could not be
+ * opened. */
+int ct_session_run(CTSession* session, int count, char const* const* arguments)
+{
+    if (count >= 2 && strcmp(arguments[0], "--generate") == 0) {
+        ct_session_generate(
+            session,
+            arguments[1],
+            count >= 3 ? arguments[2] : "patlak");
+        return 0;
+    }
+
+    CTOptions options = ct_options(count, arguments);
+    ct_expect(options.count > 0, "Provide a thrice file!");
+    if (options.cache != NULL) {
+        session->cache = ct_cache(options.cache, CT_CACHE_LIMIT);
+    }
+    int status = 0;
+    for (int i = 0; i < options.count; i++) {
+        if (access(options.files[i], R_OK) != 0) {
+            ct_writer_terminated(&session->writer, "Could not open ");
+            ct_writer_terminated(&session->writer, options.files[i]);
+            ct_writer_terminated(&session->writer, "!\n");
+            status = 1;
+            continue;
+        }
+        ct_session_compile(session, options.files[i]);
+    }
+    ct_writer_flush(&session->writer);
+    if (options.report) {
+        ct_memory_report(stderr);
+    }
+    ct_options_free(&options);
+    return status;
+}
+
+/* Deallocate memory. */
+void ct_session_free(CTSession* session)
+{
+    ct_patlak_token_set_free(&session->set);
+    ct_buffer_free(&session->patterns_file);
+    free(session->patterns);
+    ct_writer_free(&session->writer);
+    ct_rope_free(&session->rope);
+    ct_thrice_tree_free(&session->tree);
+    ct_patlak_compact_free(&session->tokens);
+    ct_buffer_free(&session->buffer);
+    ct_patlak_keywords_free(&session->keywords);
+}
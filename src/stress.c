@@ -0,0 +1,578 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "patlak/context.c"
+#include "patlak/decode.c"
+#include "patlak/matcher.c"
+#include "prelude/buffer.c"
+#include "prelude/expect.c"
+#include "prelude/memory.c"
+#include "prelude/scalar.c"
+#include "prelude/string.c"
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Amount of input characters of the smaller run of each case. */
+#define CT_STRESS_SIZE (1 << 12)
+
+/* Most amount of seconds a case can take with an engine. */
+#define CT_STRESS_SECONDS 10
+
+/* Most amount of bytes of address space a case can use with an engine. */
+#define CT_STRESS_BYTES ((rlim_t)1 << 30)
+
+/* Most times the time or the memory of a case can grow when its input is
+ * doubled. Linear cases grow about two times. */
+#define CT_STRESS_GROWTH 3.0
+
+/* Amount of bytes of state memory that is small enough to not be checked
+ * for growth. */
+#define CT_STRESS_FLOOR (64 << 10)
+
+/* Amount of seconds that is short enough to not be checked for growth, where
+ * the noise of the clock is bigger than the time. */
+#define CT_STRESS_INSTANT 1e-3
+
+/* Amount of times each run is repeated, whose fastest is measured. */
+#define CT_STRESS_REPEATS 3
+
+/* Amount of lanes the batch engine steps. */
+#define CT_STRESS_LANES 2
+
+/* Depth of the nested repeats. */
+#define CT_STRESS_DEPTH 8
+
+/* Amount of arms of the wide alternatives. */
+#define CT_STRESS_ARMS 64
+
+/* Amount of patterns in the reference chains. */
+#define CT_STRESS_CHAIN 64
+
+/* Adversarial pattern set and the input that is matched to the last pattern,
+ * which is named "stress". */
+typedef struct {
+    /* Definitions of the patterns, which are separated by line feeds. */
+    CTBuffer patterns;
+    /* Input that is matched. */
+    CTBuffer input;
+} CTStressCase;
+
+/* Generator of a case with the amount of input characters. */
+typedef void (*CTStressGenerator)(CTStressCase* stress, CTIndex size);
+
+/* Add the characters to the buffer. */
+void ct_stress_text(CTBuffer* buffer, char const* text)
+{
+    CTString string = ct_string_terminated(text);
+    ct_buffer_append(buffer, &string);
+}
+
+/* Add the character the amount of times to the buffer. */
+void ct_stress_repeat(CTBuffer* buffer, char character, CTIndex amount)
+{
+    ct_buffer_reserve(buffer, amount);
+    memset(buffer->last, character, amount);
+    buffer->last += amount;
+}
+
+/* Add the name of the pattern at the index to the buffer. Names cannot have
+ * digits; so, the index is written with letters. */
+void ct_stress_name(CTBuffer* buffer, CTIndex index)
+{
+    ct_stress_text(buffer, "r");
+    do {
+        char letter[2] = {(char)('a' + index % 26), '\0'};
+        ct_stress_text(buffer, letter);
+        index /= 26;
+    } while (index > 0);
+}
+
+/* Repeats in repeats that all match the same character, so every depth is
+ * alive at each step, followed by a character the input never has. */
+void ct_stress_nested(CTStressCase* stress, CTIndex size)
+{
+    ct_stress_text(&stress->patterns, "stress = ");
+    for (int i = 0; i < CT_STRESS_DEPTH; i++) {
+        ct_stress_text(&stress->patterns, "*{");
+    }
+    ct_stress_text(&stress->patterns, "'a'");
+    for (int i = 0; i < CT_STRESS_DEPTH; i++) {
+        ct_stress_text(&stress->patterns, "}");
+    }
+    ct_stress_text(&stress->patterns, " 'b'");
+    ct_stress_repeat(&stress->input, 'a', size);
+}
+
+/* Repeat of alternatives that match the same characters in many ways, which
+ * is exponential for a backtracking engine. */
+void ct_stress_ambiguous(CTStressCase* stress, CTIndex size)
+{
+    ct_stress_text(
+        &stress->patterns,
+        "stress = *{'a' | 'a' 'a' | *{'a'} | [1,3]{'a'}} 'b'");
+    ct_stress_repeat(&stress->input, 'a', size);
+}
+
+/* Counted repeats in counted repeats, whose counters make the states
+ * different from each other. */
+void ct_stress_counted(CTStressCase* stress, CTIndex size)
+{
+    ct_stress_text(&stress->patterns, "stress = *{[1,4]{[1,4]{'a'}}} 'b'");
+    ct_stress_repeat(&stress->input, 'a', size);
+}
+
+/* Many alternatives that share a long prefix and differ only at the end,
+ * where the input misses all of them. */
+void ct_stress_fan_out(CTStressCase* stress, CTIndex size)
+{
+    ct_stress_text(&stress->patterns, "stress = ");
+    for (int i = 0; i < CT_STRESS_ARMS; i++) {
+        char arm[32];
+        snprintf(
+            arm,
+            sizeof(arm),
+            "%s*{'a'} 'c' '%c%c'",
+            i == 0 ? "" : " | ",
+            'A' + i % 26,
+            'A' + i / 26);
+        ct_stress_text(&stress->patterns, arm);
+    }
+    ct_stress_repeat(&stress->input, 'a', size);
+    ct_stress_text(&stress->input, "c~");
+}
+
+/* Long chain of patterns that each refer to the one before, repeated over
+ * the input, so every character is matched through all the references. */
+void ct_stress_chain(CTStressCase* stress, CTIndex size)
+{
+    for (CTIndex i = 0; i < CT_STRESS_CHAIN; i++) {
+        ct_stress_name(&stress->patterns, i);
+        ct_stress_text(&stress->patterns, " = ");
+        if (i == 0) {
+            ct_stress_text(&stress->patterns, "'a'");
+        } else {
+            ct_stress_name(&stress->patterns, i - 1);
+        }
+        ct_stress_text(&stress->patterns, "\n");
+    }
+    ct_stress_text(&stress->patterns, "stress = *{");
+    ct_stress_name(&stress->patterns, CT_STRESS_CHAIN - 1);
+    ct_stress_text(&stress->patterns, "} 'b'");
+    ct_stress_repeat(&stress->input, 'a', size);
+}
+
+/* Repeat of a long literal, where the input repeats the literal but misses
+ * its last character once at the end. */
+void ct_stress_near_miss(CTStressCase* stress, CTIndex size)
+{
+    ct_stress_text(&stress->patterns, "stress = *{'");
+    ct_stress_repeat(&stress->patterns, 'a', 63);
+    ct_stress_text(&stress->patterns, "b'} '.'");
+    for (CTIndex i = 0; i + 64 <= size; i += 64) {
+        ct_stress_repeat(&stress->input, 'a', 63);
+        ct_stress_text(&stress->input, "b");
+    }
+    ct_stress_repeat(&stress->input, 'a', 63);
+}
+
+/* Named generator. */
+typedef struct {
+    /* Name in the report. */
+    char const* name;
+    /* Generator. */
+    CTStressGenerator generator;
+} CTStressShape;
+
+/* Shapes of the cases. */
+static CTStressShape const ct_stress_shapes[] = {
+    {"nested", &ct_stress_nested},
+    {"ambiguous", &ct_stress_ambiguous},
+    {"counted", &ct_stress_counted},
+    {"fan-out", &ct_stress_fan_out},
+    {"chain", &ct_stress_chain},
+    {"near-miss", &ct_stress_near_miss}};
+
+/* Compiled case that is matched by the engines. */
+typedef struct {
+    /* Generated case. */
+    CTStressCase stress;
+    /* Patterns as they are compiled. */
+    CTPatlakContext plain;
+    /* Patterns after the optimizations. */
+    CTPatlakContext optimized;
+    /* Name of the matched pattern. */
+    CTString name;
+    /* Input that is matched. */
+    CTString input;
+} CTStressRun;
+
+/* Matching engine. Returns the match of the run. */
+typedef CTString (*CTStressEngine)(CTStressRun* run);
+
+/* Decode the plain codes with a new matcher. */
+CTString ct_stress_decode(CTStressRun* run)
+{
+    CTPatlakPattern const* pattern =
+        ct_patlak_patterns_information(&run->plain.patterns, &run->name);
+    CTPatlakState initial = {.input = run->input, .code = pattern->start};
+    return ct_patlak_decode_test(&run->plain.codes, initial);
+}
+
+/* Match the optimized codes, which runs the machine code of the pattern if it
+ * was compiled. */
+CTString ct_stress_match(CTStressRun* run)
+{
+    CTPatlakMatcher matcher = ct_patlak_context_matcher(&run->optimized);
+    CTString        match =
+        ct_patlak_match(&run->optimized, &matcher, &run->name, &run->input);
+    ct_patlak_matcher_free(&matcher);
+    return match;
+}
+
+/* Decode the optimized codes while recording the captures. */
+CTString ct_stress_captures(CTStressRun* run)
+{
+    CTPatlakMatcher matcher = ct_patlak_context_matcher(&run->optimized);
+    CTString        captures[CT_PATLAK_PATTERN_CAPTURES];
+    CTString        match = ct_patlak_match_captures(
+        &run->optimized,
+        &matcher,
+        &run->name,
+        &run->input,
+        captures);
+    ct_patlak_matcher_free(&matcher);
+    return match;
+}
+
+/* Step the input in a batch next to copies of it. */
+CTString ct_stress_batch(CTStressRun* run)
+{
+    CTPatlakMatcher matchers[CT_STRESS_LANES] = {0};
+    CTString        inputs[CT_STRESS_LANES];
+    CTString        results[CT_STRESS_LANES];
+    for (int i = 0; i < CT_STRESS_LANES; i++) {
+        matchers[i] = ct_patlak_context_matcher(&run->optimized);
+        inputs[i]   = run->input;
+    }
+    ct_patlak_match_batch(
+        &run->optimized,
+        matchers,
+        CT_STRESS_LANES,
+        &run->name,
+        inputs,
+        results,
+        CT_STRESS_LANES);
+    for (int i = 0; i < CT_STRESS_LANES; i++) {
+        ct_patlak_matcher_free(matchers + i);
+    }
+    return results[0];
+}
+
+/* Match with the minimal automaton of the optimized pattern, or decode if it
+ * cannot be built. */
+CTString ct_stress_automaton(CTStressRun* run)
+{
+    CTPatlakAutomaton automaton = {0};
+    CTIndex           matched   = 0;
+    if (!ct_patlak_automate(&run->optimized, &run->name, 1, &automaton)) {
+        CTPatlakMatcher matcher = ct_patlak_context_matcher(&run->optimized);
+        CTString        match   = ct_patlak_match(
+            &run->optimized,
+            &matcher,
+            &run->name,
+            &run->input);
+        ct_patlak_matcher_free(&matcher);
+        return match;
+    }
+    CTString match =
+        ct_patlak_automaton_match(&automaton, &run->input, &matched);
+    ct_patlak_automaton_free(&automaton);
+    return match;
+}
+
+/* Named engine. */
+typedef struct {
+    /* Name in the report. */
+    char const* name;
+    /* Engine. */
+    CTStressEngine engine;
+} CTStressEngineEntry;
+
+/* Engines every case is run against. */
+static CTStressEngineEntry const ct_stress_engines[] = {
+    {"decode", &ct_stress_decode},
+    {"match", &ct_stress_match},
+    {"captures", &ct_stress_captures},
+    {"batch", &ct_stress_batch},
+    {"automaton", &ct_stress_automaton}};
+
+/* Compile the patterns of the case to the context. */
+void ct_stress_compile(CTPatlakContext* context, CTStressCase const* stress)
+{
+    CTString rest = {
+        .first = stress->patterns.first,
+        .last  = stress->patterns.last};
+    while (ct_string_finite(&rest)) {
+        CTSplit split = ct_split_first(&rest, '\n');
+        ct_patlak_compile(context, &split.before);
+
+        // Skip the line feed, which starts the rest.
+        rest = ct_split(&split.after, ct_string_finite(&split.after)).after;
+    }
+}
+
+/* Generate and compile the case with the amount of input characters. */
+CTStressRun ct_stress_run(CTStressShape const* shape, CTIndex size)
+{
+    CTStressRun run = {0};
+    shape->generator(&run.stress, size);
+    ct_stress_compile(&run.plain, &run.stress);
+    ct_stress_compile(&run.optimized, &run.stress);
+    ct_patlak_optimize(&run.optimized);
+    run.name  = ct_string_terminated("stress");
+    run.input = ct_buffer_view(&run.stress.input);
+    return run;
+}
+
+/* Deallocate memory. */
+void ct_stress_run_free(CTStressRun* run)
+{
+    ct_patlak_free(&run->plain);
+    ct_patlak_free(&run->optimized);
+    ct_buffer_free(&run->stress.patterns);
+    ct_buffer_free(&run->stress.input);
+}
+
+/* Seconds on the monotonic clock. */
+double ct_stress_now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
+
+/* Cost of matching the case with the engine. */
+typedef struct {
+    /* Fastest time in seconds. */
+    double seconds;
+    /* Peak bytes of the decoding states. */
+    CTIndex states;
+    /* Amount of characters the engine matched, or negative if it did not. */
+    CTIndex match;
+} CTStressCost;
+
+/* Amount of characters plain decoding matched at the size and at the double
+ * of the size, which all the engines should agree with. Negative amounts mean
+ * it did not match. */
+typedef struct {
+    /* Match at the size. */
+    CTIndex small;
+    /* Match at the double of the size. */
+    CTIndex big;
+} CTStressReference;
+
+/* Amount of matched characters, or negative if the match is empty. */
+CTIndex ct_stress_size(CTString const* match)
+{
+    return ct_string_finite(match) ? ct_string_size(match) : -1;
+}
+
+/* Measure the engine on the case with the amount of input characters. */
+CTStressCost ct_stress_measure(
+    CTStressShape const*       shape,
+    CTStressEngineEntry const* engine,
+    CTIndex                    size)
+{
+    CTStressRun  run  = ct_stress_run(shape, size);
+    CTStressCost cost = {.seconds = -1};
+    atomic_store(&ct_memory_kinds[CT_MEMORY_STATES].peak, 0);
+    for (int i = 0; i < CT_STRESS_REPEATS; i++) {
+        double   start   = ct_stress_now();
+        CTString match   = engine->engine(&run);
+        double   seconds = ct_stress_now() - start;
+        if (cost.seconds < 0 || seconds < cost.seconds) {
+            cost.seconds = seconds;
+        }
+        cost.match = ct_stress_size(&match);
+    }
+    cost.states = atomic_load(&ct_memory_kinds[CT_MEMORY_STATES].peak);
+    ct_stress_run_free(&run);
+    return cost;
+}
+
+/* Run the case with the engine at the size and double the size, and report
+ * it. All the matches start at the input; so, their sizes are compared to the
+ * reference. Returns whether the engine agreed with the reference and grew
+ * linearly. */
+bool ct_stress_check(
+    CTStressShape const*       shape,
+    CTStressEngineEntry const* engine,
+    CTStressReference const*   reference,
+    CTIndex                    size)
+{
+    CTStressCost small = ct_stress_measure(shape, engine, size);
+    CTStressCost big   = ct_stress_measure(shape, engine, size * 2);
+
+    double time_growth =
+        big.seconds / (small.seconds > 0 ? small.seconds : 1e-9);
+    double memory_growth =
+        (double)big.states / (double)(small.states > 0 ? small.states : 1);
+    bool agrees =
+        small.match == reference->small && big.match == reference->big;
+    bool linear = (big.seconds <= CT_STRESS_INSTANT ||
+                   time_growth <= CT_STRESS_GROWTH) &&
+                  (big.states <= CT_STRESS_FLOOR ||
+                   memory_growth <= CT_STRESS_GROWTH);
+    printf(
+        "%-10s %-9s %10.6f %10.6f %6.2fx %10td %6.2fx %s\n",
+        shape->name,
+        engine->name,
+        small.seconds,
+        big.seconds,
+        time_growth,
+        big.states,
+        memory_growth,
+        !agrees ? "MISMATCH" : !linear ? "SUPERLINEAR" : "ok");
+    return agrees && linear;
+}
+
+/* Fork a child process that runs under the time and memory limits, so a
+ * blowup is reported instead of taking the machine down. Returns the process
+ * identifier of the child to the parent, and zero to the child. */
+pid_t ct_stress_fork(void)
+{
+    fflush(stdout);
+    pid_t child = fork();
+    ct_expect(child >= 0, "Could not fork!");
+    if (child == 0) {
+        struct rlimit limit = {
+            .rlim_cur = CT_STRESS_BYTES,
+            .rlim_max = CT_STRESS_BYTES};
+        setrlimit(RLIMIT_AS, &limit);
+        alarm(CT_STRESS_SECONDS);
+    }
+    return child;
+}
+
+/* Wait for the child and report it under the names if it did not exit by
+ * itself. Returns whether it exited successfully. */
+bool ct_stress_wait(pid_t child, char const* shape, char const* engine)
+{
+    int status = 0;
+    ct_expect(waitpid(child, &status, 0) == child, "Could not wait!");
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status) == EXIT_SUCCESS;
+    }
+    printf(
+        "%-10s %-9s %s\n",
+        shape,
+        engine,
+        WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM
+            ? "TIMEOUT"
+            : "CRASHED, maybe out of memory");
+    return false;
+}
+
+/* Decode the plain codes of the case at the size and at the double of the
+ * size in a limited child, which sends the matches back through a pipe. Done
+ * once for each case, apart from the timed engines; so, a slow reference is
+ * reported on its own instead of as a failure of every engine. Returns
+ * whether the reference was found. */
+bool ct_stress_reference(
+    CTStressShape const* shape,
+    CTStressReference*   reference,
+    CTIndex              size)
+{
+    int ends[2];
+    ct_expect(pipe(ends) == 0, "Could not create a pipe!");
+    pid_t child = ct_stress_fork();
+    if (child == 0) {
+        close(ends[0]);
+        CTStressRun small = ct_stress_run(shape, size);
+        CTStressRun big   = ct_stress_run(shape, size * 2);
+        CTString    first = ct_stress_decode(&small);
+        CTString    other = ct_stress_decode(&big);
+        CTStressReference found = {
+            .small = ct_stress_size(&first),
+            .big   = ct_stress_size(&other)};
+        bool sent = write(ends[1], &found, sizeof(found)) == sizeof(found);
+        ct_stress_run_free(&small);
+        ct_stress_run_free(&big);
+        _exit(sent ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    close(ends[1]);
+    bool received = read(ends[0], reference, sizeof(*reference)) ==
+                    sizeof(*reference);
+    close(ends[0]);
+    return ct_stress_wait(child, shape->name, "reference") && received;
+}
+
+/* Run the check of the engine in a limited child. Returns whether the check
+ * passed. */
+bool ct_stress_guard(
+    CTStressShape const*       shape,
+    CTStressEngineEntry const* engine,
+    CTStressReference const*   reference,
+    CTIndex                    size)
+{
+    pid_t child = ct_stress_fork();
+    if (child == 0) {
+        bool passed = ct_stress_check(shape, engine, reference, size);
+        fflush(stdout);
+        _exit(passed ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    return ct_stress_wait(child, shape->name, engine->name);
+}
+
+/* Entry to the stress workload. Runs every case against every engine, and
+ * fails if any of them disagrees with decoding, times out, runs out of
+ * memory or grows more than linearly. Engines of a case whose decoding could
+ * not be finished are not run, and the case fails. Running with a number uses
+ * it as the amount of input characters of the smaller runs. */
+int main(int argument_count, char const* const* arguments)
+{
+    CTIndex size = CT_STRESS_SIZE;
+    if (argument_count >= 2) {
+        size = strtol(arguments[1], NULL, 10);
+        ct_expect(size > 0, "Size is not positive!");
+    }
+
+    printf(
+        "%-10s %-9s %10s %10s %7s %10s %7s %s\n",
+        "case",
+        "engine",
+        "seconds",
+        "doubled",
+        "growth",
+        "states",
+        "growth",
+        "result");
+    bool passed = true;
+    for (size_t i = 0; i < sizeof(ct_stress_shapes) / sizeof(*ct_stress_shapes);
+         i++) {
+        CTStressReference reference = {0};
+        if (!ct_stress_reference(ct_stress_shapes + i, &reference, size)) {
+            passed = false;
+            continue;
+        }
+        for (size_t j = 0;
+             j < sizeof(ct_stress_engines) / sizeof(*ct_stress_engines);
+             j++) {
+            passed &= ct_stress_guard(
+                ct_stress_shapes + i,
+                ct_stress_engines + j,
+                &reference,
+                size);
+        }
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
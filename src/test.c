@@ -0,0 +1,1090 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "cache.c"
+#include "options.c"
+#include "patlak/context.c"
+#include "patlak/decode.c"
+#include "patlak/matcher.c"
+#include "pipeline.c"
+#include "prelude/buffer.c"
+#include "prelude/expect.c"
+#include "prelude/memory.c"
+#include "prelude/scalar.c"
+#include "prelude/split.c"
+#include "prelude/string.c"
+#include "thrice/emitter.c"
+#include "thrice/parser.c"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Amount of characters of the long inputs, which are too long for the
+ * matchers that are not linear to finish. */
+#define CT_TEST_LONG (1 << 14)
+
+/* Amount of the checks that failed. */
+static int ct_test_failures = 0;
+
+/* Count the check as failed and print it if the condition does not hold. */
+void ct_test_check(bool condition, char const* group, char const* check)
+{
+    if (!condition) {
+        fprintf(stderr, "%s: failed: %s\n", group, check);
+        ct_test_failures++;
+    }
+}
+
+/* Compile the patterns, which are definitions that are separated by line
+ * feeds, to the context. */
+void ct_test_compile(CTPatlakContext* context, char const* patterns)
+{
+    CTString rest = ct_string_terminated(patterns);
+    while (ct_string_finite(&rest)) {
+        CTSplit split = ct_split_first(&rest, '\n');
+        ct_patlak_compile(context, &split.before);
+
+        // Skip the line feed, which starts the rest.
+        rest = ct_split(&split.after, ct_string_finite(&split.after)).after;
+    }
+}
+
+/* Amount of matched characters, or negative if the match is empty. */
+CTIndex ct_test_size(CTString const* match)
+{
+    return ct_string_finite(match) ? ct_string_size(match) : -1;
+}
+
+/* Pattern named "s" and an input with the amount of characters it should
+ * match, or negative if it should not. */
+typedef struct {
+    /* Definitions of the patterns, which are separated by line feeds. */
+    char const* patterns;
+    /* Input that is matched. */
+    char const* input;
+    /* Amount of matched characters. */
+    CTIndex expected;
+} CTTestMatch;
+
+/* Repeats whose bodies match empty, which loop without consuming input,
+ * ordinary patterns around them, and references, which match their shortest
+ * match whether they are inlined or not. */
+static CTTestMatch const ct_test_matches[] = {
+    {"s = *{*{'a'}} 'b'", "aac", -1},
+    {"s = *{*{'a'}} 'b'", "aab", 3},
+    {"s = *{?'a'} 'b'", "aac", -1},
+    {"s = *{?'a'} 'b'", "aab", 3},
+    {"s = [2,]{?'a'} 'b'", "aac", -1},
+    {"s = [2,]{?'a'} 'b'", "b", 1},
+    {"s = [1,3]{*{'a'}} 'b'", "aaaac", -1},
+    {"s = +{?'a'} 'b'", "aab", 3},
+    {"s = [0,3]'a' 'b'", "aaab", 4},
+    {"s = [0,3]'a' 'b'", "aaaab", -1},
+    {"s = [0,3]'a' 'b'", "b", 1},
+    {"s = [0,]'a' 'b'", "aaaab", 5},
+    {"s = [0,]'a' 'b'", "b", 1},
+    {"s = *{'a' | ?'b'} 'c'", "abad", -1},
+    {"s = *{'a'} 'a'", "aaa", 1},
+    {"s = 'a' 'b' | 'abcdef'", "abcdef", 2},
+    {"s = *{'ab'} 'abc'", "ababc", 5},
+    {"r = +{'a'}\ns = r 'b' | r", "aab", 1},
+    {"r = +{'a'}\ns = *{r} 'b'", "aaab", 4},
+    {"d = +'0~9'\ns = w: d '.' f: d", "12.34", -1},
+    {"d = +'0~9'\ns = d '.' d", "1.34", 3},
+    {"d = '0~9' | 'ab'\ns = +d '.' d", "1ab.3", 5},
+    {"d = 'a' ?'b'\ns = d 'c'", "abc", -1}};
+
+/* Decode the plain codes and match the optimized codes of each case. */
+void ct_test_decode(void)
+{
+    for (size_t i = 0; i < sizeof(ct_test_matches) / sizeof(*ct_test_matches);
+         i++) {
+        CTTestMatch const* test      = ct_test_matches + i;
+        CTPatlakContext    plain     = {0};
+        CTPatlakContext    optimized = {0};
+        ct_test_compile(&plain, test->patterns);
+        ct_test_compile(&optimized, test->patterns);
+        ct_patlak_optimize(&optimized);
+
+        CTString               name    = ct_string_terminated("s");
+        CTString               input   = ct_string_terminated(test->input);
+        CTPatlakPattern const* pattern =
+            ct_patlak_patterns_information(&plain.patterns, &name);
+        CTPatlakState   initial = {.input = input, .code = pattern->start};
+        CTPatlakMatcher matcher = ct_patlak_context_matcher(&optimized);
+        CTString decoded = ct_patlak_decode_test(&plain.codes, initial);
+        CTString matched = ct_patlak_match(&optimized, &matcher, &name, &input);
+        ct_test_check(
+            ct_test_size(&decoded) == test->expected,
+            test->patterns,
+            test->input);
+        ct_test_check(
+            ct_test_size(&matched) == test->expected,
+            test->patterns,
+            test->input);
+
+        ct_patlak_matcher_free(&matcher);
+        ct_patlak_free(&plain);
+        ct_patlak_free(&optimized);
+    }
+}
+
+/* Patterns named with the letters from "a" in their order and an input, which
+ * the decoder and the automaton should match the same. */
+typedef struct {
+    /* Definitions of the patterns, which are separated by line feeds. */
+    char const* patterns;
+    /* Amount of patterns. */
+    CTIndex order;
+    /* Input that is matched. */
+    char const* input;
+} CTTestOrder;
+
+/* Strings that overlap the shorter matches of the same or the earlier
+ * patterns. */
+static CTTestOrder const ct_test_orders[] = {
+    {"a = 'a' 'b' | 'abcdef'", 1, "abcdef"},
+    {"a = 'abcdef' | 'a' 'b'", 1, "abcdef"},
+    {"a = 'abc' | 'ab' 'c' 'd'", 1, "abcd"},
+    {"a = *{'ab'} 'c'", 1, "ababc"},
+    {"a = 'abcd'\nb = +{'a' | 'b'}", 2, "abcd"},
+    {"a = 'xyz' 'w'\nb = 'x' 'y'", 2, "xyzw"},
+    {"a = 'xyz' 'w'\nb = 'x' 'y'", 2, "xyz"}};
+
+/* Match each case with the decoder and the automaton of the patterns. */
+void ct_test_automaton(void)
+{
+    for (size_t i = 0; i < sizeof(ct_test_orders) / sizeof(*ct_test_orders);
+         i++) {
+        CTTestOrder const* test    = ct_test_orders + i;
+        CTPatlakContext    context = {0};
+        ct_test_compile(&context, test->patterns);
+        ct_patlak_optimize(&context);
+
+        char     letters[] = "abcd";
+        CTString names[4];
+        for (CTIndex j = 0; j < test->order; j++) {
+            names[j] = (CTString){
+                .first = letters + j,
+                .last  = letters + j + 1};
+        }
+        CTString          input     = ct_string_terminated(test->input);
+        CTPatlakMatcher   matcher   = ct_patlak_context_matcher(&context);
+        CTPatlakAutomaton automaton = {0};
+        CTIndex           decoded   = -1;
+        CTIndex           automated = -1;
+        CTString          first     = ct_patlak_match_first(
+            &context,
+            &matcher,
+            names,
+            test->order,
+            &input,
+            &decoded);
+        ct_test_check(
+            ct_patlak_automate(&context, names, test->order, &automaton),
+            test->patterns,
+            "automaton is built");
+        CTString match =
+            ct_patlak_automaton_match(&automaton, &input, &automated);
+        ct_test_check(
+            ct_test_size(&first) == ct_test_size(&match) &&
+                decoded == automated,
+            test->patterns,
+            test->input);
+
+        ct_patlak_automaton_free(&automaton);
+        ct_patlak_matcher_free(&matcher);
+        ct_patlak_free(&context);
+    }
+}
+
+/* Decode long inputs that almost match patterns whose states are told apart
+ * by their counters, which should take linear time. */
+void ct_test_decode_long(void)
+{
+    char const* patterns[] = {
+        "s = *{[1,4]{[1,4]{'a'}}} 'b'",
+        "s = *{*{*{*{'a'}}}} 'b'",
+        "s = *{[2,]{?'a'}} 'b'"};
+    CTBuffer buffer = {0};
+    ct_buffer_reserve(&buffer, CT_TEST_LONG + 1);
+    memset(buffer.last, 'a', CT_TEST_LONG);
+    buffer.last[CT_TEST_LONG] = 'c';
+    buffer.last += CT_TEST_LONG + 1;
+
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(*patterns); i++) {
+        CTPatlakContext context = {0};
+        ct_test_compile(&context, patterns[i]);
+        CTPatlakMatcher matcher = ct_patlak_context_matcher(&context);
+        CTString        name    = ct_string_terminated("s");
+        CTString        input   = ct_buffer_view(&buffer);
+        CTString match = ct_patlak_match(&context, &matcher, &name, &input);
+        ct_test_check(!ct_string_finite(&match), "long", patterns[i]);
+        ct_patlak_matcher_free(&matcher);
+        ct_patlak_free(&context);
+    }
+    ct_buffer_free(&buffer);
+}
+
+/* Match long inputs with the matchers of the contexts, which should have all
+ * the memory they need, and check that the states are not allocated. */
+void ct_test_allocations(void)
+{
+    char const* patterns[] = {
+        "s = *{[1,4]{[1,4]{'a'}}} 'b'",
+        "s = *{x: 'a' | y: [2,3]{'a'}} 'b'",
+        "r = 'a'\nq = r | 'b'\ns = *{q} 'c'",
+        "s = *{'aaaa' | 'aa'} 'b'"};
+    CTBuffer buffer = {0};
+    ct_buffer_reserve(&buffer, CT_TEST_LONG + 1);
+    memset(buffer.last, 'a', CT_TEST_LONG);
+    buffer.last[CT_TEST_LONG] = 'c';
+    buffer.last += CT_TEST_LONG + 1;
+
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(*patterns); i++) {
+        CTPatlakContext plain     = {0};
+        CTPatlakContext optimized = {0};
+        ct_test_compile(&plain, patterns[i]);
+        ct_test_compile(&optimized, patterns[i]);
+        ct_patlak_optimize(&optimized);
+        CTPatlakMatcher plain_matcher = ct_patlak_context_matcher(&plain);
+        CTPatlakMatcher optimized_matcher =
+            ct_patlak_context_matcher(&optimized);
+
+        CTString name     = ct_string_terminated("s");
+        CTString input    = ct_buffer_view(&buffer);
+        CTString captures[CT_PATLAK_PATTERN_CAPTURES];
+        CTIndex  before   = atomic_load(
+            &ct_memory_kinds[CT_MEMORY_STATES].reallocations);
+        ct_patlak_match(&plain, &plain_matcher, &name, &input);
+        ct_patlak_match(&optimized, &optimized_matcher, &name, &input);
+        ct_patlak_match_captures(
+            &optimized,
+            &optimized_matcher,
+            &name,
+            &input,
+            captures);
+        CTIndex after =
+            atomic_load(&ct_memory_kinds[CT_MEMORY_STATES].reallocations);
+        ct_test_check(before == after, "allocations", patterns[i]);
+
+        ct_patlak_matcher_free(&plain_matcher);
+        ct_patlak_matcher_free(&optimized_matcher);
+        ct_patlak_free(&plain);
+        ct_patlak_free(&optimized);
+    }
+    ct_buffer_free(&buffer);
+}
+
+/* Build and free a keyword table and a matcher that recurs, and check that
+ * their memory is accounted and is given back. */
+void ct_test_memory(void)
+{
+    CTIndex before = atomic_load(&ct_memory_kinds[CT_MEMORY_KEYWORDS].current);
+    CTString         spelling = ct_string_terminated("return");
+    CTPatlakKeywords keywords = ct_patlak_keywords(&spelling, 1);
+    CTIndex          during =
+        atomic_load(&ct_memory_kinds[CT_MEMORY_KEYWORDS].current);
+    ct_patlak_keywords_free(&keywords);
+    CTIndex after = atomic_load(&ct_memory_kinds[CT_MEMORY_KEYWORDS].current);
+    ct_test_check(
+        during > before && after == before,
+        "memory",
+        "keywords");
+
+    CTPatlakContext context = {0};
+    ct_test_compile(&context, "s = 'a' ?s 'b'");
+    before = atomic_load(&ct_memory_kinds[CT_MEMORY_STATES].current);
+    CTPatlakMatcher matcher = ct_patlak_context_matcher(&context);
+    CTString        name    = ct_string_terminated("s");
+    CTString        input   = ct_string_terminated("aaabbb");
+    CTIndex created = atomic_load(&ct_memory_kinds[CT_MEMORY_STATES].current);
+    ct_patlak_match(&context, &matcher, &name, &input);
+    during = atomic_load(&ct_memory_kinds[CT_MEMORY_STATES].current);
+    ct_patlak_matcher_free(&matcher);
+    ct_patlak_free(&context);
+    after = atomic_load(&ct_memory_kinds[CT_MEMORY_STATES].current);
+    ct_test_check(
+        during > created && after == before,
+        "memory",
+        "deeper");
+}
+
+/* Parse options that are before, between and after the files. */
+void ct_test_options(void)
+{
+    char const* arguments[] = {
+        "--mem-report",
+        "a.thr",
+        "--cache",
+        "directory",
+        "b.token"};
+    CTOptions options = ct_options(5, arguments);
+    ct_test_check(
+        options.report && options.cache != NULL &&
+            strcmp(options.cache, "directory") == 0 && options.count == 2 &&
+            strcmp(options.files[0], "a.thr") == 0 &&
+            strcmp(options.files[1], "b.token") == 0,
+        "options",
+        "mixed");
+    ct_options_free(&options);
+}
+
+/* Token patterns, which should be compiled to machine code, and inputs that
+ * the machine code and the decoder should match the same. */
+static char const* const ct_test_tokens[] = {
+    "s = +{'a~z' | 'A~Z' | '_'} *{'a~z' | 'A~Z' | '0~9' | '_'}",
+    "s = +{'0~9'} ?{'.' +{'0~9'}}",
+    "s = '<<=' | '>>=' | '<=' | '=='",
+    "s = 'return' | 'register'",
+    "s = '/*' *{.} '*/'",
+    "s = +{'a~z'} ';'"};
+
+/* Inputs of the token patterns. */
+static char const* const ct_test_inputs[] = {
+    "",
+    "a",
+    "_x9 = 1",
+    "9.25;",
+    "12.x",
+    "<<=>",
+    "<=",
+    "registers",
+    "retur",
+    "/* a ** b */ c",
+    "/* a ** b",
+    "abc;",
+    "abc",
+    "\xff"};
+
+/* Match the inputs with the token patterns until they are compiled, and then
+ * with their machine code, and check that they match the same as the
+ * decoder. */
+void ct_test_jit(void)
+{
+    for (size_t i = 0; i < sizeof(ct_test_tokens) / sizeof(*ct_test_tokens);
+         i++) {
+        CTPatlakContext plain     = {0};
+        CTPatlakContext optimized = {0};
+        ct_test_compile(&plain, ct_test_tokens[i]);
+        ct_test_compile(&optimized, ct_test_tokens[i]);
+        ct_patlak_optimize(&optimized);
+
+        CTString               name    = ct_string_terminated("s");
+        CTPatlakPattern const* pattern =
+            ct_patlak_patterns_information(&optimized.patterns, &name);
+        CTIndex start =
+            ct_patlak_patterns_information(&plain.patterns, &name)->start;
+        ct_test_check(
+            pattern->jit.function == NULL,
+            ct_test_tokens[i],
+            "machine code is not compiled before matching");
+
+        // Every pattern admits some of the inputs, so each round counts.
+        CTPatlakMatcher matcher = ct_patlak_context_matcher(&optimized);
+        for (CTIndex k = 0; k < CT_PATLAK_JIT_THRESHOLD; k++) {
+            for (size_t j = 0;
+                 j < sizeof(ct_test_inputs) / sizeof(*ct_test_inputs);
+                 j++) {
+                CTString input = ct_string_terminated(ct_test_inputs[j]);
+                CTPatlakState initial = {.input = input, .code = start};
+                CTString decoded = ct_patlak_decode_test(&plain.codes, initial);
+                CTString matched =
+                    ct_patlak_match(&optimized, &matcher, &name, &input);
+                ct_test_check(
+                    ct_test_size(&decoded) == ct_test_size(&matched),
+                    ct_test_tokens[i],
+                    ct_test_inputs[j]);
+            }
+        }
+        ct_patlak_matcher_free(&matcher);
+#if defined(__x86_64__) && !defined(_WIN32)
+        ct_test_check(
+            pattern->jit.function != NULL,
+            ct_test_tokens[i],
+            "machine code is compiled");
+#endif
+        for (size_t j = 0;
+             j < sizeof(ct_test_inputs) / sizeof(*ct_test_inputs);
+             j++) {
+            CTString      input   = ct_string_terminated(ct_test_inputs[j]);
+            CTPatlakState initial = {.input = input, .code = start};
+            CTString decoded = ct_patlak_decode_test(&plain.codes, initial);
+            CTIndex  jitted  = -1;
+            if (pattern->jit.function != NULL) {
+                char const* last =
+                    pattern->jit.function(input.first, input.last);
+                jitted = last == NULL ? -1 : last - input.first;
+            }
+            ct_test_check(
+                pattern->jit.function == NULL ||
+                    ct_test_size(&decoded) == jitted,
+                ct_test_tokens[i],
+                ct_test_inputs[j]);
+        }
+
+        ct_patlak_free(&plain);
+        ct_patlak_free(&optimized);
+    }
+}
+
+/* Edit of the source of the lexing checks, which is applied to the source
+ * that the edits before it made. */
+typedef struct {
+    /* Index of the first removed character. */
+    CTIndex offset;
+    /* Amount of removed characters. */
+    CTIndex removed;
+    /* Characters that are put in place of the removed ones. */
+    char const* inserted;
+} CTTestEdit;
+
+/* Source that is edited. */
+static char const ct_test_source[] =
+    "main(str arg) {\n"
+    "    // Say 'hi\n"
+    "    return 'a' + 12;\n"
+    "}\n";
+
+/* Edits that join and split lines, comment them out, and change quotes and
+ * keywords. */
+static CTTestEdit const ct_test_edits[] = {
+    {0, 0, "// "},
+    {0, 3, ""},
+    {15, 1, ""},
+    {15, 0, "\n"},
+    {37, 0, "//"},
+    {37, 2, ""},
+    {44, 0, "b"},
+    {50, 2, "x 'c'"},
+    {8, 0, "ing"},
+    {38, 0, "\n"},
+    {16, 0, "return\n    "},
+    {4, 1, " ret urn "},
+    {0, 0, "\n\n"}};
+
+/* Whether the tokens are the same, and are at the same offsets of their
+ * sources. */
+bool ct_test_tokens_equal(
+    CTPatlakTokens const* lhs,
+    CTString const*       lhs_source,
+    CTPatlakTokens const* rhs,
+    CTString const*       rhs_source)
+{
+    if (ct_patlak_tokens_size(lhs) != ct_patlak_tokens_size(rhs)) {
+        return false;
+    }
+    for (CTIndex i = 0; i < ct_patlak_tokens_size(lhs); i++) {
+        CTPatlakToken const* left  = lhs->first + i;
+        CTPatlakToken const* right = rhs->first + i;
+        if (left->type != right->type ||
+            left->value.first - lhs_source->first !=
+                right->value.first - rhs_source->first ||
+            !ct_string_equal(&left->value, &right->value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Words that are close to the keywords but are not any of them. */
+static char const* const ct_test_near_misses[] = {
+    "",
+    "retur",
+    "returns",
+    "Return",
+    "whilf",
+    "int",
+    "int9",
+    "uint64_t",
+    "strs",
+    "el se"};
+
+/* Build tables of the first Thrice keywords for each amount, and check that
+ * each keyword is found at a slot with its spelling and that the near misses
+ * and the keywords that are not in the table are not found. */
+void ct_test_keyword_table(void)
+{
+    CTString spellings[CT_THRICE_PARSER_KEYWORDS];
+    for (CTIndex i = 0; i < CT_THRICE_PARSER_KEYWORDS; i++) {
+        spellings[i] = ct_string_terminated(ct_thrice_parser_spellings[i]);
+    }
+
+    for (CTIndex size = 0; size <= CT_THRICE_PARSER_KEYWORDS; size++) {
+        CTPatlakKeywords keywords = ct_patlak_keywords(spellings, size);
+        bool             found    = true;
+        for (CTIndex i = 0; i < CT_THRICE_PARSER_KEYWORDS; i++) {
+            CTIndex slot = ct_patlak_keywords_find(&keywords, spellings + i);
+            if (i >= size) {
+                found = found && slot < 0;
+                continue;
+            }
+            found = found && slot >= 0 &&
+                    ct_string_equal(keywords.spellings + slot, spellings + i);
+        }
+        ct_test_check(
+            found,
+            "keywords",
+            size > 0 ? ct_thrice_parser_spellings[size - 1] : "none");
+
+        for (size_t i = 0;
+             i < sizeof(ct_test_near_misses) / sizeof(*ct_test_near_misses);
+             i++) {
+            CTString word = ct_string_terminated(ct_test_near_misses[i]);
+            ct_test_check(
+                ct_patlak_keywords_find(&keywords, &word) < 0,
+                "keywords",
+                ct_test_near_misses[i]);
+        }
+        ct_patlak_keywords_free(&keywords);
+    }
+}
+
+/* Whether the compact tokens are the same as the listed ones, and are at the
+ * same offsets of their sources. */
+bool ct_test_compact_equal(
+    CTPatlakCompactTokens const* lhs,
+    CTString const*              lhs_source,
+    CTPatlakTokens const*        rhs,
+    CTString const*              rhs_source)
+{
+    if (lhs->size != ct_patlak_tokens_size(rhs)) {
+        return false;
+    }
+    for (CTIndex i = 0; i < lhs->size; i++) {
+        CTPatlakToken        left  = ct_patlak_compact_get(lhs, i);
+        CTPatlakToken const* right = rhs->first + i;
+        if (left.type != right->type ||
+            left.value.first - lhs_source->first !=
+                right->value.first - rhs_source->first ||
+            !ct_string_equal(&left.value, &right->value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Lex the source to compact tokens, and check that they are the same as the
+ * listed ones and that the types are found. */
+void ct_test_lexer_compact(void)
+{
+    CTString         spellings[] = {
+        ct_string_terminated("return"),
+        ct_string_terminated("str")};
+    CTPatlakKeywords keywords    = ct_patlak_keywords(spellings, 2);
+    CTString         source      = ct_string_terminated(ct_test_source);
+
+    CTPatlakTokens        listed  = {0};
+    CTPatlakCompactTokens compact = {0};
+    ct_patlak_lexer_file_keywords(&listed, source, &keywords);
+    ct_patlak_lexer_file_compact(&compact, source, &keywords);
+    ct_test_check(
+        ct_test_compact_equal(&compact, &source, &listed, &source),
+        "compact",
+        "tokens");
+
+    CTIndex first =
+        ct_patlak_compact_find(&compact, 0, CT_PATLAK_TOKEN_KEYWORD);
+    CTIndex second =
+        ct_patlak_compact_find(&compact, first + 1, CT_PATLAK_TOKEN_KEYWORD);
+    CTIndex missing =
+        ct_patlak_compact_find(&compact, 0, CT_PATLAK_TOKEN_EQUAL);
+    ct_test_check(
+        first == 2 && second == 9 && missing == compact.size,
+        "compact",
+        "find");
+
+    ct_patlak_compact_free(&compact);
+    ct_patlak_tokens_free(&listed);
+    ct_patlak_keywords_free(&keywords);
+}
+
+/* Apply the edits one after the other to the tokens of the source, and check
+ * that they are the same as lexing the whole edited source. */
+void ct_test_lexer_edit(void)
+{
+    CTString         spellings[] = {
+        ct_string_terminated("return"),
+        ct_string_terminated("str")};
+    CTPatlakKeywords keywords    = ct_patlak_keywords(spellings, 2);
+    CTString         source      = ct_string_terminated(ct_test_source);
+    CTBuffer         buffer      = {0};
+    CTPatlakTokens   tokens      = {0};
+    ct_patlak_lexer_file_keywords(&tokens, source, &keywords);
+
+    for (size_t i = 0; i < sizeof(ct_test_edits) / sizeof(*ct_test_edits);
+         i++) {
+        CTPatlakEdit edit = {
+            .offset   = ct_test_edits[i].offset,
+            .removed  = ct_test_edits[i].removed,
+            .inserted = ct_string_terminated(ct_test_edits[i].inserted)};
+        CTBuffer next   = {0};
+        CTString edited = ct_patlak_lexer_edit(
+            &tokens,
+            &next,
+            &source,
+            &edit,
+            &keywords);
+        CTPatlakTokens whole = {0};
+        ct_patlak_lexer_file_keywords(&whole, edited, &keywords);
+        ct_test_check(
+            ct_test_tokens_equal(&tokens, &edited, &whole, &edited),
+            "edit",
+            ct_test_edits[i].inserted);
+
+        ct_patlak_tokens_free(&whole);
+        ct_buffer_free(&buffer);
+        buffer = next;
+        source = edited;
+    }
+
+    ct_patlak_tokens_free(&tokens);
+    ct_buffer_free(&buffer);
+    ct_patlak_keywords_free(&keywords);
+}
+
+/* Offsets of the keywords that are split by the borders of the chunks the
+ * pipeline loads. */
+static CTIndex const ct_test_borders[] = {
+    CT_PIPELINE_CHUNK - 4,
+    2 * CT_PIPELINE_CHUNK - 2,
+    3 * CT_PIPELINE_CHUNK - 1,
+    4 * CT_PIPELINE_CHUNK - 3};
+
+/* Lex a file whose keywords are split by the borders of the chunks with the
+ * pipeline, and check that it is the same as lexing the whole file. */
+void ct_test_pipeline(void)
+{
+    CTString         spelling = ct_string_terminated("int32");
+    CTPatlakKeywords keywords = ct_patlak_keywords(&spelling, 1);
+    CTIndex          size     = CT_PIPELINE_THRESHOLD + CT_PIPELINE_CHUNK;
+    char*            contents = malloc(size);
+    ct_expect(contents != NULL, "Could not allocate!");
+    for (CTIndex i = 0; i < size; i++) {
+        contents[i] = i % 64 == 63 ? '\n' : i % 8 == 7 ? ' ' : 'x';
+    }
+    for (size_t i = 0; i < sizeof(ct_test_borders) / sizeof(*ct_test_borders);
+         i++) {
+        memcpy(contents + ct_test_borders[i] - 1, " int32 ", 7);
+    }
+
+    FILE* file = tmpfile();
+    ct_expect(file != NULL, "Could not create the file!");
+    ct_expect(
+        fwrite(contents, 1, size, file) == (size_t)size && fflush(file) == 0,
+        "Could not write the file!");
+    rewind(file);
+    CTPipeline pipeline = {
+        .file     = file,
+        .contents = malloc(size),
+        .size     = size,
+        .keywords = &keywords};
+    ct_expect(pipeline.contents != NULL, "Could not allocate!");
+    CTPatlakCompactTokens concurrent = ct_patlak_compact(pipeline.contents);
+    ct_pipeline_concurrent(&pipeline, &concurrent, NULL);
+    fclose(file);
+
+    CTString       whole      = {.first = contents, .last = contents + size};
+    CTString       loaded     = {
+        .first = pipeline.contents,
+        .last  = pipeline.contents + size};
+    CTPatlakTokens sequential = {0};
+    ct_patlak_lexer_file_keywords(&sequential, whole, &keywords);
+    ct_test_check(
+        ct_test_compact_equal(&concurrent, &loaded, &sequential, &whole),
+        "pipeline",
+        "int32");
+
+    ct_patlak_tokens_free(&sequential);
+    ct_patlak_compact_free(&concurrent);
+    free(pipeline.contents);
+    free(contents);
+    ct_patlak_keywords_free(&keywords);
+}
+
+/* Thrice source and the C code it is transpiled to. */
+typedef struct {
+    /* Source. */
+    char const* source;
+    /* C code after the includes. */
+    char const* code;
+} CTTestTranspile;
+
+/* Includes that are at the start of all the C code. */
+static char const ct_test_includes[] =
+    "#include <stdbool.h>\n"
+    "#include <stddef.h>\n"
+    "#include <stdint.h>\n\n";
+
+/* Sources that cover each kind of node, and the entry point. */
+static CTTestTranspile const ct_test_transpiles[] = {
+    {"main(str[] args) int32 {\n"
+     "    return 0;\n"
+     "}\n",
+     "int main(int count, char const** args);\n"
+     "\n"
+     "int main(int count, char const** args)\n"
+     "{\n"
+     "    return 0;\n"
+     "}\n"},
+    {"add(int32 a, int32 b) int32 { return a + b * 2 - (a - b); }\n"
+     "main() uint8 { return add(1, 2); }\n",
+     "int32_t add(int32_t a, int32_t b);\n"
+     "int main(void);\n"
+     "\n"
+     "int32_t add(int32_t a, int32_t b)\n"
+     "{\n"
+     "    return ((a + (b * 2)) - (a - b));\n"
+     "}\n"
+     "\n"
+     "int main(void)\n"
+     "{\n"
+     "    return add(1, 2);\n"
+     "}\n"},
+    {"f(sz x2) sz {\n"
+     "    x2 = y = 3;\n"
+     "    if (x2 <= 2 & !ready) x2 = -x2; else { x2 = x2 % 3; }\n"
+     "    while (x2 != 0) x2 = x2 - 1;\n"
+     "    return items[x2].size;\n"
+     "}\n",
+     "size_t f(size_t x2);\n"
+     "\n"
+     "size_t f(size_t x2)\n"
+     "{\n"
+     "    (x2 = (y = 3));\n"
+     "    if (((x2 <= 2) & (!ready))) {\n"
+     "        (x2 = (-x2));\n"
+     "    } else {\n"
+     "        (x2 = (x2 % 3));\n"
+     "    }\n"
+     "    while ((x2 != 0)) {\n"
+     "        (x2 = (x2 - 1));\n"
+     "    }\n"
+     "    return items[x2].size;\n"
+     "}\n"},
+    {"g() Node[][] {\n"
+     "    str s = 'say \"hi\"';\n"
+     "    uint8 c = '\\n';\n"
+     "    { bool b; }\n"
+     "    return;\n"
+     "}\n",
+     "Node** g(void);\n"
+     "\n"
+     "Node** g(void)\n"
+     "{\n"
+     "    char const* s = \"say \\\"hi\\\"\";\n"
+     "    uint8_t c = '\\n';\n"
+     "    {\n"
+     "        bool b;\n"
+     "    }\n"
+     "    return;\n"
+     "}\n"}};
+
+/* Parse the Thrice source and emit it to the buffer. */
+void ct_test_transpile(CTBuffer* buffer, char const* source)
+{
+    CTPatlakKeywords      keywords = ct_thrice_parser_keywords();
+    CTString              file     = ct_string_terminated(source);
+    CTPatlakCompactTokens tokens   = {0};
+    ct_patlak_lexer_file_compact(&tokens, file, &keywords);
+    CTLines      lines = ct_lines(file);
+    CTThriceTree tree  = {0};
+    ct_thrice_parse(&tree, &tokens, &lines, "test.thr");
+    CTRope rope = {0};
+    ct_thrice_emit(&rope, &tree, &tokens);
+
+    for (struct iovec const* i = rope.first; i < rope.last; i++) {
+        ct_buffer_reserve(buffer, (CTIndex)i->iov_len);
+        memcpy(buffer->last, i->iov_base, i->iov_len);
+        buffer->last += i->iov_len;
+    }
+
+    ct_rope_free(&rope);
+    ct_thrice_tree_free(&tree);
+    ct_lines_free(&lines);
+    ct_patlak_compact_free(&tokens);
+    ct_patlak_keywords_free(&keywords);
+}
+
+/* Whether the source is transpiled to the includes and the C code. */
+bool ct_test_transpiles_to(CTTestTranspile const* transpile)
+{
+    CTBuffer buffer = {0};
+    ct_test_transpile(&buffer, transpile->source);
+    CTString code     = ct_buffer_view(&buffer);
+    CTString includes = ct_string_terminated(ct_test_includes);
+    CTString expected = ct_string_terminated(transpile->code);
+    bool     included = ct_string_size(&code) >= ct_string_size(&includes);
+    if (included) {
+        CTString start = {
+            .first = code.first,
+            .last  = code.first + ct_string_size(&includes)};
+        included   = ct_string_equal(&start, &includes);
+        code.first = start.last;
+    }
+    bool equal = included && ct_string_equal(&code, &expected);
+    ct_buffer_free(&buffer);
+    return equal;
+}
+
+/* Transpile each source and check the C code. */
+void ct_test_emit(void)
+{
+    for (size_t i = 0;
+         i < sizeof(ct_test_transpiles) / sizeof(*ct_test_transpiles);
+         i++) {
+        ct_test_check(
+            ct_test_transpiles_to(ct_test_transpiles + i),
+            "emit",
+            ct_test_transpiles[i].source);
+    }
+}
+
+/* Sources whose statements and expressions are nested in each other. */
+static CTTestTranspile const ct_test_nestings[] = {
+    {"f() sz { if (a) if (b) x = 1; else x = 2; }",
+     "size_t f(void);\n"
+     "\n"
+     "size_t f(void)\n"
+     "{\n"
+     "    if (a) {\n"
+     "        if (b) {\n"
+     "            (x = 1);\n"
+     "        } else {\n"
+     "            (x = 2);\n"
+     "        }\n"
+     "    }\n"
+     "}\n"},
+    {"f() sz { { { while (a) { if (b) { return; } } } } }",
+     "size_t f(void);\n"
+     "\n"
+     "size_t f(void)\n"
+     "{\n"
+     "    {\n"
+     "        {\n"
+     "            while (a) {\n"
+     "                if (b) {\n"
+     "                    return;\n"
+     "                }\n"
+     "            }\n"
+     "        }\n"
+     "    }\n"
+     "}\n"},
+    {"f() sz { return f(g(h(1)), ((2)))[i][j + 1].k; }",
+     "size_t f(void);\n"
+     "\n"
+     "size_t f(void)\n"
+     "{\n"
+     "    return f(g(h(1)), 2)[i][(j + 1)].k;\n"
+     "}\n"},
+    {"f() sz { a = b == c < d; return -!-a; }",
+     "size_t f(void);\n"
+     "\n"
+     "size_t f(void)\n"
+     "{\n"
+     "    (a = (b == (c < d)));\n"
+     "    return (-(!(-a)));\n"
+     "}\n"}};
+
+/* Source with a syntax error, and the error that is reported for it. */
+typedef struct {
+    /* Source. */
+    char const* source;
+    /* Line that is printed before aborting. */
+    char const* error;
+} CTTestSyntax;
+
+/* Sources that fail at each kind of expectation, at the token or at the end
+ * of the source. */
+static CTTestSyntax const ct_test_syntaxes[] = {
+    {"f() sz { return 1 }", "test.thr:1:19: error: Expected `;`!\n"},
+    {"f() sz { return 1;", "test.thr:1:19: error: Expected `}`!\n"},
+    {"f(sz) sz {}", "test.thr:1:5: error: Expected a name!\n"},
+    {"f sz {}", "test.thr:1:3: error: Expected `(`!\n"},
+    {"f() sz { g(1 2); }", "test.thr:1:14: error: Expected `,`!\n"},
+    {"f() sz { a[1; }", "test.thr:1:13: error: Expected `]`!\n"},
+    {"f() sz {\n    x = 1 +;\n}",
+     "test.thr:2:12: error: Expected an expression!\n"}};
+
+/* Whether transpiling the source aborts after printing the error. Transpiles
+ * in a child, which prints to a pipe. */
+bool ct_test_rejects(CTTestSyntax const* syntax)
+{
+    int ends[2];
+    ct_expect(pipe(ends) == 0, "Could not create the pipe!");
+    fflush(stderr);
+    pid_t child = fork();
+    ct_expect(child != -1, "Could not fork!");
+    if (child == 0) {
+        close(ends[0]);
+        dup2(ends[1], STDERR_FILENO);
+        CTBuffer buffer = {0};
+        ct_test_transpile(&buffer, syntax->source);
+        _exit(0);
+    }
+    close(ends[1]);
+
+    char    error[256];
+    CTIndex size = 0;
+    ssize_t read_amount;
+    while ((read_amount =
+                read(ends[0], error + size, sizeof(error) - 1 - size)) > 0) {
+        size += read_amount;
+    }
+    close(ends[0]);
+    error[size] = '\0';
+
+    int status = 0;
+    ct_expect(waitpid(child, &status, 0) == child, "Could not wait!");
+    return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT &&
+           strcmp(error, syntax->error) == 0;
+}
+
+/* Parse nested sources and check the C code, and parse the sources with
+ * syntax errors and check the errors. */
+void ct_test_parse(void)
+{
+    for (size_t i = 0;
+         i < sizeof(ct_test_nestings) / sizeof(*ct_test_nestings);
+         i++) {
+        ct_test_check(
+            ct_test_transpiles_to(ct_test_nestings + i),
+            "parse",
+            ct_test_nestings[i].source);
+    }
+    for (size_t i = 0;
+         i < sizeof(ct_test_syntaxes) / sizeof(*ct_test_syntaxes);
+         i++) {
+        ct_test_check(
+            ct_test_rejects(ct_test_syntaxes + i),
+            "syntax",
+            ct_test_syntaxes[i].source);
+    }
+}
+
+/* Store the text as the output with the key. */
+void ct_test_cache_store(CTCache* cache, uint64_t key, char const* text)
+{
+    CTWriter writer = ct_writer(open("/dev/null", O_WRONLY));
+    ct_expect(writer.descriptor >= 0, "Could not open the null device!");
+    ct_cache_begin(cache, key, &writer);
+    ct_writer_terminated(&writer, text);
+    ct_cache_end(cache, key, &writer);
+    ct_expect(close(writer.descriptor) == 0, "Could not close!");
+    ct_writer_free(&writer);
+}
+
+/* Whether the output with the key is loaded as the text. The text is null
+ * when the output should not be found. Loads to a pipe. */
+bool ct_test_cache_loads(CTCache const* cache, uint64_t key, char const* text)
+{
+    int ends[2];
+    ct_expect(pipe(ends) == 0, "Could not create the pipe!");
+    CTWriter writer = ct_writer(ends[1]);
+    bool     found  = ct_cache_load(cache, key, &writer);
+    ct_writer_flush(&writer);
+    ct_writer_free(&writer);
+    close(ends[1]);
+
+    char    output[256];
+    CTIndex size = 0;
+    ssize_t read_amount;
+    while ((read_amount =
+                read(ends[0], output + size, sizeof(output) - 1 - size)) > 0) {
+        size += read_amount;
+    }
+    close(ends[0]);
+    output[size] = '\0';
+    return text == NULL ? !found && size == 0
+                        : found && strcmp(output, text) == 0;
+}
+
+/* Store and load outputs in a temporary directory, and evict the least
+ * recently used one when the limit is exceeded. */
+void ct_test_cache(void)
+{
+    char     directory[] = "/tmp/cthrice-test-XXXXXX";
+    CTCache  cache       = ct_cache(mkdtemp(directory), 16);
+    CTString contents    = ct_string_terminated("f() sz { return 1; }");
+    uint64_t key         = ct_cache_key(&cache, &contents, true, NULL);
+    ct_test_check(ct_test_cache_loads(&cache, key, NULL), "cache", "miss");
+
+    ct_test_cache_store(&cache, key, "first!!!");
+    ct_test_check(
+        ct_test_cache_loads(&cache, key, "first!!!"),
+        "cache",
+        "hit");
+    ct_test_check(cache.size == 8, "cache", "size");
+
+    CTCache other = cache;
+    other.version = "other";
+    ct_test_check(
+        ct_cache_key(&other, &contents, true, NULL) != key,
+        "cache",
+        "version");
+    ct_test_check(
+        ct_cache_key(&cache, &contents, false, NULL) != key,
+        "cache",
+        "kind");
+
+    // Make the first output older, as stores in the same clock tick would
+    // have the same time.
+    CTBuffer path = {0};
+    ct_cache_path(&cache, key, "", &path);
+    struct timespec const old[2] = {{.tv_sec = 1}, {.tv_sec = 1}};
+    ct_expect(utimensat(AT_FDCWD, path.first, old, 0) == 0, "Could not age!");
+    ct_buffer_free(&path);
+
+    CTString second     = ct_string_terminated("g() sz { return 2; }");
+    uint64_t second_key = ct_cache_key(&cache, &second, true, NULL);
+    ct_test_cache_store(&cache, second_key, "second!!!");
+    ct_test_check(
+        ct_test_cache_loads(&cache, key, NULL) &&
+            ct_test_cache_loads(&cache, second_key, "second!!!") &&
+            cache.size == 9,
+        "cache",
+        "eviction");
+
+    // Scanning again finds the remaining output.
+    CTCache reopened = ct_cache(cache.directory, 16);
+    ct_test_check(reopened.size == 9, "cache", "scan");
+
+    cache.limit = 0;
+    ct_cache_evict(&cache);
+    ct_test_check(
+        cache.size == 0 && rmdir(directory) == 0,
+        "cache",
+        "clear");
+}
+
+/* Entry to the tests. Fails if any of the checks fail. */
+int main(void)
+{
+    ct_test_decode();
+    ct_test_decode_long();
+    ct_test_automaton();
+    ct_test_allocations();
+    ct_test_memory();
+    ct_test_jit();
+    ct_test_keyword_table();
+    ct_test_lexer_compact();
+    ct_test_lexer_edit();
+    ct_test_pipeline();
+    ct_test_options();
+    ct_test_cache();
+    ct_test_emit();
+    ct_test_parse();
+    if (ct_test_failures > 0) {
+        fprintf(stderr, "%d checks failed!\n", ct_test_failures);
+        return EXIT_FAILURE;
+    }
+    printf("All checks passed.\n");
+    return EXIT_SUCCESS;
+}
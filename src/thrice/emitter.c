@@ -0,0 +1,385 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "patlak/compact.c"
+#include "prelude/expect.c"
+#include "prelude/rope.c"
+#include "prelude/scalar.c"
+#include "prelude/string.c"
+#include "thrice/tree.c"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Spaces that indentation is sliced from. */
+#define CT_THRICE_EMITTER_SPACES "                                        "
+
+/* Information while emitting C for a source. */
+typedef struct {
+    /* Output that is emitted to. Names and literals are not copied, so the
+     * source must not change until the rope is written. */
+    CTRope* rope;
+    /* Nodes of the source. */
+    CTThriceTree const* tree;
+    /* Tokens of the source. */
+    CTPatlakCompactTokens const* tokens;
+    /* Amount of blocks the emitted statements are in. */
+    CTIndex depth;
+} CTThriceEmitter;
+
+/* Node at the index. */
+CTThriceNode const*
+ct_thrice_emitter_node(CTThriceEmitter const* emitter, uint32_t node)
+{
+    return ct_thrice_tree_get(emitter->tree, node);
+}
+
+/* Emit the tokens of the node as they are in the source. */
+void ct_thrice_emitter_value(CTThriceEmitter* emitter, uint32_t node)
+{
+    CTString value = ct_thrice_tree_value(emitter->tree, emitter->tokens, node);
+    ct_rope_slice(emitter->rope, &value);
+}
+
+/* Emit the indentation of the current depth. */
+void ct_thrice_emitter_indent(CTThriceEmitter* emitter)
+{
+    CTIndex     spaces = emitter->depth * 4;
+    char const* first  = CT_THRICE_EMITTER_SPACES;
+    while (spaces > 0) {
+        CTIndex amount = (CTIndex)sizeof(CT_THRICE_EMITTER_SPACES) - 1;
+        if (amount > spaces) {
+            amount = spaces;
+        }
+        ct_rope_piece(emitter->rope, first, first + amount);
+        spaces -= amount;
+    }
+}
+
+/* C type for the named type. Names that are not builtin are kept. */
+char const* ct_thrice_emitter_builtin(CTString const* name)
+{
+    static char const* const names[][2] = {
+        {"int8", "int8_t"},
+        {"int16", "int16_t"},
+        {"int32", "int32_t"},
+        {"int64", "int64_t"},
+        {"uint8", "uint8_t"},
+        {"uint16", "uint16_t"},
+        {"uint32", "uint32_t"},
+        {"uint64", "uint64_t"},
+        {"sz", "size_t"},
+        {"bool", "bool"},
+        {"str", "char const*"}};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        CTString builtin = ct_string_terminated(names[i][0]);
+        if (ct_string_equal(name, &builtin)) {
+            return names[i][1];
+        }
+    }
+    return NULL;
+}
+
+/* Emit the type. Arrays are pointers to their elements. */
+void ct_thrice_emitter_type(CTThriceEmitter* emitter, uint32_t type)
+{
+    CTThriceNode const* node = ct_thrice_emitter_node(emitter, type);
+    if (node->type == CT_THRICE_NODE_ARRAY) {
+        ct_thrice_emitter_type(emitter, node->child);
+        ct_rope_character(emitter->rope, '*');
+        return;
+    }
+    ct_expect(node->type == CT_THRICE_NODE_TYPE, "Expected a type!");
+    CTString name =
+        ct_thrice_tree_value(emitter->tree, emitter->tokens, type);
+    char const* builtin = ct_thrice_emitter_builtin(&name);
+    if (builtin != NULL) {
+        ct_rope_terminated(emitter->rope, builtin);
+    } else {
+        ct_rope_slice(emitter->rope, &name);
+    }
+}
+
+/* Emit the quote as a character if it has a single character, otherwise as
+ * a string. Double quotes in strings are escaped. */
+void ct_thrice_emitter_quote(CTThriceEmitter* emitter, uint32_t quote)
+{
+    CTString value =
+        ct_thrice_tree_value(emitter->tree, emitter->tokens, quote);
+    CTString inner = {.first = value.first + 1, .last = value.last - 1};
+    CTIndex  size  = ct_string_size(&inner);
+    if (size == 1 || (size == 2 && *inner.first == '\\')) {
+        ct_rope_slice(emitter->rope, &value);
+        return;
+    }
+
+    ct_rope_character(emitter->rope, '"');
+    char const* first = inner.first;
+    for (char const* i = inner.first; i < inner.last; i++) {
+        if (*i == '"') {
+            ct_rope_piece(emitter->rope, first, i);
+            ct_rope_terminated(emitter->rope, "\\\"");
+            first = i + 1;
+        }
+    }
+    ct_rope_piece(emitter->rope, first, inner.last);
+    ct_rope_character(emitter->rope, '"');
+}
+
+/* Emit the expression. Operations are put in parentheses, so the order of
+ * the operations does not depend on the precedence in C. */
+void ct_thrice_emitter_expression(
+    CTThriceEmitter* emitter,
+    uint32_t         expression)
+{
+    CTThriceNode const* node = ct_thrice_emitter_node(emitter, expression);
+    switch (node->type) {
+        case CT_THRICE_NODE_NAME:
+        case CT_THRICE_NODE_NUMBER:
+            ct_thrice_emitter_value(emitter, expression);
+            break;
+        case CT_THRICE_NODE_QUOTE:
+            ct_thrice_emitter_quote(emitter, expression);
+            break;
+        case CT_THRICE_NODE_UNARY:
+            ct_rope_character(emitter->rope, '(');
+            ct_thrice_emitter_value(emitter, expression);
+            ct_thrice_emitter_expression(emitter, node->child);
+            ct_rope_character(emitter->rope, ')');
+            break;
+        case CT_THRICE_NODE_BINARY: {
+            uint32_t right =
+                ct_thrice_emitter_node(emitter, node->child)->sibling;
+            CTString symbol = ct_thrice_tree_value(
+                emitter->tree,
+                emitter->tokens,
+                expression);
+            if (ct_string_starts(&symbol, '.')) {
+                ct_thrice_emitter_expression(emitter, node->child);
+                ct_rope_character(emitter->rope, '.');
+                ct_thrice_emitter_value(emitter, right);
+                break;
+            }
+            ct_rope_character(emitter->rope, '(');
+            ct_thrice_emitter_expression(emitter, node->child);
+            ct_rope_character(emitter->rope, ' ');
+            ct_rope_slice(emitter->rope, &symbol);
+            ct_rope_character(emitter->rope, ' ');
+            ct_thrice_emitter_expression(emitter, right);
+            ct_rope_character(emitter->rope, ')');
+            break;
+        }
+        case CT_THRICE_NODE_CALL:
+            ct_thrice_emitter_expression(emitter, node->child);
+            ct_rope_character(emitter->rope, '(');
+            for (uint32_t i =
+                     ct_thrice_emitter_node(emitter, node->child)->sibling;
+                 i != CT_THRICE_NODE_NONE;
+                 i = ct_thrice_emitter_node(emitter, i)->sibling) {
+                ct_thrice_emitter_expression(emitter, i);
+                if (ct_thrice_emitter_node(emitter, i)->sibling !=
+                    CT_THRICE_NODE_NONE) {
+                    ct_rope_terminated(emitter->rope, ", ");
+                }
+            }
+            ct_rope_character(emitter->rope, ')');
+            break;
+        case CT_THRICE_NODE_INDEX:
+            ct_thrice_emitter_expression(emitter, node->child);
+            ct_rope_character(emitter->rope, '[');
+            ct_thrice_emitter_expression(
+                emitter,
+                ct_thrice_emitter_node(emitter, node->child)->sibling);
+            ct_rope_character(emitter->rope, ']');
+            break;
+        default:
+            ct_expect(false, "Expected an expression!");
+    }
+}
+
+void ct_thrice_emitter_statement(CTThriceEmitter* emitter, uint32_t statement);
+
+/* Emit the statements in curly brackets. Does not indent the opening
+ * bracket. */
+void ct_thrice_emitter_block(CTThriceEmitter* emitter, uint32_t block)
+{
+    ct_rope_terminated(emitter->rope, "{\n");
+    emitter->depth++;
+    for (uint32_t i = ct_thrice_emitter_node(emitter, block)->child;
+         i != CT_THRICE_NODE_NONE;
+         i = ct_thrice_emitter_node(emitter, i)->sibling) {
+        ct_thrice_emitter_statement(emitter, i);
+    }
+    emitter->depth--;
+    ct_thrice_emitter_indent(emitter);
+    ct_rope_character(emitter->rope, '}');
+}
+
+/* Emit the statement of a conditional in a block, so it is never
+ * ambiguous. */
+void ct_thrice_emitter_body(CTThriceEmitter* emitter, uint32_t body)
+{
+    if (ct_thrice_emitter_node(emitter, body)->type == CT_THRICE_NODE_BLOCK) {
+        ct_thrice_emitter_block(emitter, body);
+        return;
+    }
+    ct_rope_terminated(emitter->rope, "{\n");
+    emitter->depth++;
+    ct_thrice_emitter_statement(emitter, body);
+    emitter->depth--;
+    ct_thrice_emitter_indent(emitter);
+    ct_rope_character(emitter->rope, '}');
+}
+
+/* Emit the statement on its own lines. */
+void ct_thrice_emitter_statement(CTThriceEmitter* emitter, uint32_t statement)
+{
+    CTThriceNode const* node = ct_thrice_emitter_node(emitter, statement);
+    ct_thrice_emitter_indent(emitter);
+    switch (node->type) {
+        case CT_THRICE_NODE_BLOCK:
+            ct_thrice_emitter_block(emitter, statement);
+            ct_rope_character(emitter->rope, '\n');
+            break;
+        case CT_THRICE_NODE_RETURN:
+            ct_rope_terminated(emitter->rope, "return");
+            if (node->child != CT_THRICE_NODE_NONE) {
+                ct_rope_character(emitter->rope, ' ');
+                ct_thrice_emitter_expression(emitter, node->child);
+            }
+            ct_rope_terminated(emitter->rope, ";\n");
+            break;
+        case CT_THRICE_NODE_IF:
+        case CT_THRICE_NODE_WHILE: {
+            ct_rope_terminated(
+                emitter->rope,
+                node->type == CT_THRICE_NODE_IF ? "if (" : "while (");
+            ct_thrice_emitter_expression(emitter, node->child);
+            ct_rope_terminated(emitter->rope, ") ");
+            uint32_t body =
+                ct_thrice_emitter_node(emitter, node->child)->sibling;
+            ct_thrice_emitter_body(emitter, body);
+            uint32_t alternative =
+                ct_thrice_emitter_node(emitter, body)->sibling;
+            if (alternative != CT_THRICE_NODE_NONE) {
+                ct_rope_terminated(emitter->rope, " else ");
+                ct_thrice_emitter_body(emitter, alternative);
+            }
+            ct_rope_character(emitter->rope, '\n');
+            break;
+        }
+        case CT_THRICE_NODE_VARIABLE: {
+            ct_thrice_emitter_type(emitter, node->child);
+            ct_rope_character(emitter->rope, ' ');
+            ct_thrice_emitter_value(emitter, statement);
+            uint32_t value =
+                ct_thrice_emitter_node(emitter, node->child)->sibling;
+            if (value != CT_THRICE_NODE_NONE) {
+                ct_rope_terminated(emitter->rope, " = ");
+                ct_thrice_emitter_expression(emitter, value);
+            }
+            ct_rope_terminated(emitter->rope, ";\n");
+            break;
+        }
+        case CT_THRICE_NODE_EXPRESSION:
+            ct_thrice_emitter_expression(emitter, node->child);
+            ct_rope_terminated(emitter->rope, ";\n");
+            break;
+        default:
+            ct_expect(false, "Expected a statement!");
+    }
+}
+
+/* Whether the function is the entry point, which has a fixed signature in
+ * C. */
+bool ct_thrice_emitter_main(CTThriceEmitter const* emitter, uint32_t function)
+{
+    CTString name =
+        ct_thrice_tree_value(emitter->tree, emitter->tokens, function);
+    CTString main = ct_string_terminated("main");
+    return ct_string_equal(&name, &main);
+}
+
+/* Emit the signature of the function. Entry point gets the argument count
+ * before its only parameter, and returns an int. Returns the body. */
+uint32_t
+ct_thrice_emitter_signature(CTThriceEmitter* emitter, uint32_t function)
+{
+    bool main = ct_thrice_emitter_main(emitter, function);
+
+    // Return type comes after the parameters.
+    uint32_t i = ct_thrice_emitter_node(emitter, function)->child;
+    while (ct_thrice_emitter_node(emitter, i)->type ==
+           CT_THRICE_NODE_PARAMETER) {
+        i = ct_thrice_emitter_node(emitter, i)->sibling;
+    }
+
+    // C only accepts "int main(void)" and "int main(int, char**)", while a
+    // Thrice entry point can return any type and takes the arguments as a
+    // single array, which carries no length. So, its return type is replaced
+    // with int, and the count C passes is added before the array.
+    if (main) {
+        ct_rope_terminated(emitter->rope, "int");
+    } else {
+        ct_thrice_emitter_type(emitter, i);
+    }
+    ct_rope_character(emitter->rope, ' ');
+    ct_thrice_emitter_value(emitter, function);
+    ct_rope_character(emitter->rope, '(');
+
+    uint32_t parameter = ct_thrice_emitter_node(emitter, function)->child;
+    if (parameter == i) {
+        ct_rope_terminated(emitter->rope, "void");
+    } else if (main) {
+        ct_rope_terminated(emitter->rope, "int count, ");
+    }
+    for (; parameter != i;
+         parameter = ct_thrice_emitter_node(emitter, parameter)->sibling) {
+        ct_thrice_emitter_type(
+            emitter,
+            ct_thrice_emitter_node(emitter, parameter)->child);
+        ct_rope_character(emitter->rope, ' ');
+        ct_thrice_emitter_value(emitter, parameter);
+        if (ct_thrice_emitter_node(emitter, parameter)->sibling != i) {
+            ct_rope_terminated(emitter->rope, ", ");
+        }
+    }
+    ct_rope_character(emitter->rope, ')');
+    return ct_thrice_emitter_node(emitter, i)->sibling;
+}
+
+/* Emit C for the parsed source to the rope. Declares all the functions
+ * first, so they can be called before they are defined. */
+void ct_thrice_emit(
+    CTRope*                      rope,
+    CTThriceTree const*          tree,
+    CTPatlakCompactTokens const* tokens)
+{
+    CTThriceEmitter emitter = {.rope = rope, .tree = tree, .tokens = tokens};
+    ct_rope_terminated(
+        rope,
+        "#include <stdbool.h>\n"
+        "#include <stddef.h>\n"
+        "#include <stdint.h>\n\n");
+
+    uint32_t module = 0;
+    for (uint32_t i = ct_thrice_emitter_node(&emitter, module)->child;
+         i != CT_THRICE_NODE_NONE;
+         i = ct_thrice_emitter_node(&emitter, i)->sibling) {
+        ct_thrice_emitter_signature(&emitter, i);
+        ct_rope_terminated(rope, ";\n");
+    }
+
+    for (uint32_t i = ct_thrice_emitter_node(&emitter, module)->child;
+         i != CT_THRICE_NODE_NONE;
+         i = ct_thrice_emitter_node(&emitter, i)->sibling) {
+        ct_rope_character(rope, '\n');
+        uint32_t body = ct_thrice_emitter_signature(&emitter, i);
+        ct_rope_character(rope, '\n');
+        ct_thrice_emitter_block(&emitter, body);
+        ct_rope_character(rope, '\n');
+    }
+}
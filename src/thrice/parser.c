@@ -0,0 +1,633 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "patlak/compact.c"
+#include "patlak/keywords.c"
+#include "patlak/token.c"
+#include "prelude/expect.c"
+#include "prelude/lines.c"
+#include "prelude/scalar.c"
+#include "prelude/string.c"
+#include "thrice/tree.c"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Words of Thrice that are lexed as keywords, which are the statements and
+ * the builtin types. */
+static char const* const ct_thrice_parser_spellings[] = {
+    "return",
+    "if",
+    "else",
+    "while",
+    "int8",
+    "int16",
+    "int32",
+    "int64",
+    "uint8",
+    "uint16",
+    "uint32",
+    "uint64",
+    "sz",
+    "bool",
+    "str"};
+
+/* Amount of keywords of Thrice. */
+#define CT_THRICE_PARSER_KEYWORDS                 \
+    (CTIndex)(sizeof(ct_thrice_parser_spellings) / \
+              sizeof(ct_thrice_parser_spellings[0]))
+
+/* Keyword table of Thrice, which should be given to the lexer. */
+CTPatlakKeywords ct_thrice_parser_keywords(void)
+{
+    CTString spellings[CT_THRICE_PARSER_KEYWORDS];
+    for (CTIndex i = 0; i < CT_THRICE_PARSER_KEYWORDS; i++) {
+        spellings[i] = ct_string_terminated(ct_thrice_parser_spellings[i]);
+    }
+    return ct_patlak_keywords(spellings, CT_THRICE_PARSER_KEYWORDS);
+}
+
+/* Information while parsing a source. */
+typedef struct {
+    /* Tokens of the source. */
+    CTPatlakCompactTokens const* tokens;
+    /* Index of the next token that is not a line feed or a comment. */
+    CTIndex current;
+    /* Nodes that are parsed to. */
+    CTThriceTree* tree;
+    /* Lines of the source, which are used for reporting errors. */
+    CTLines* lines;
+    /* Path to the source, which is used for reporting errors. */
+    char const* path;
+} CTThriceParser;
+
+/* If the condition does not hold, print the error message with the line and
+ * column of the next token and abort. */
+void ct_thrice_parser_expect(
+    CTThriceParser* parser,
+    bool            condition,
+    char const*     message)
+{
+    if (condition) {
+        return;
+    }
+    CTIndex offset = ct_string_size(&parser->lines->source);
+    if (parser->current < parser->tokens->size) {
+        offset = parser->tokens->offsets[parser->current];
+    }
+    CTLocation location = ct_lines_locate(parser->lines, offset);
+    fprintf(
+        stderr,
+        "%s:%td:%td: error: %s\n",
+        parser->path,
+        location.line,
+        location.column,
+        message);
+    abort();
+}
+
+/* Index of the first token at or after the index that is not a line feed or
+ * a comment. */
+CTIndex ct_thrice_parser_skip(CTThriceParser const* parser, CTIndex index)
+{
+    CTIndex size = parser->tokens->size;
+    while (index < size &&
+           (parser->tokens->types[index] == CT_PATLAK_TOKEN_NEWLINE ||
+            parser->tokens->types[index] == CT_PATLAK_TOKEN_COMMENT)) {
+        index++;
+    }
+    return index;
+}
+
+/* Whether there is a token at the index. Sets the token if there is. */
+bool ct_thrice_parser_at(
+    CTThriceParser const* parser,
+    CTIndex               index,
+    CTPatlakToken*        token)
+{
+    if (index >= parser->tokens->size) {
+        return false;
+    }
+    *token = ct_patlak_compact_get(parser->tokens, index);
+    return true;
+}
+
+/* Whether there are tokens left. */
+bool ct_thrice_parser_finite(CTThriceParser const* parser)
+{
+    return parser->current < parser->tokens->size;
+}
+
+/* Whether the token is the mark. Marks that are not in patterns are lexed as
+ * unknown tokens, so all the single characters are checked the same way. */
+bool ct_thrice_parser_mark_at(
+    CTThriceParser const* parser,
+    CTIndex               index,
+    char                  mark)
+{
+    CTPatlakToken token = {0};
+    return ct_thrice_parser_at(parser, index, &token) &&
+           token.type != CT_PATLAK_TOKEN_QUOTE &&
+           ct_string_size(&token.value) == 1 && *token.value.first == mark;
+}
+
+/* Whether the next token is the mark. */
+bool ct_thrice_parser_mark(CTThriceParser const* parser, char mark)
+{
+    return ct_thrice_parser_mark_at(parser, parser->current, mark);
+}
+
+/* Whether the next token is of the type. */
+bool ct_thrice_parser_peek(
+    CTThriceParser const* parser,
+    CTPatlakTokenType     type)
+{
+    return ct_thrice_parser_finite(parser) &&
+           ct_patlak_compact_type(parser->tokens, parser->current) == type;
+}
+
+/* Whether the next token is the keyword. Identifiers are never keywords, so
+ * they are rejected without comparing. */
+bool ct_thrice_parser_word(CTThriceParser const* parser, char const* word)
+{
+    CTString expected = ct_string_terminated(word);
+    if (!ct_thrice_parser_peek(parser, CT_PATLAK_TOKEN_KEYWORD)) {
+        return false;
+    }
+    CTString value = ct_patlak_compact_value(parser->tokens, parser->current);
+    return ct_string_equal(&value, &expected);
+}
+
+/* Consume the amount of tokens. Returns the index of the first one. */
+CTIndex ct_thrice_parser_advance(CTThriceParser* parser, CTIndex amount)
+{
+    CTIndex index   = parser->current;
+    parser->current = ct_thrice_parser_skip(parser, index + amount);
+    return index;
+}
+
+/* Consume the next token, which must be the mark. Returns its index. */
+CTIndex ct_thrice_parser_take(CTThriceParser* parser, char mark)
+{
+    char message[] = "Expected `?`!";
+    message[10]    = mark;
+    ct_thrice_parser_expect(
+        parser,
+        ct_thrice_parser_mark(parser, mark),
+        message);
+    return ct_thrice_parser_advance(parser, 1);
+}
+
+/* Whether the token at the index directly follows the previous one without
+ * any whitespace. */
+bool ct_thrice_parser_adjacent(CTThriceParser const* parser, CTIndex index)
+{
+    CTPatlakCompactTokens const* tokens = parser->tokens;
+    return index > 0 && index < tokens->size &&
+           tokens->offsets[index] ==
+               tokens->offsets[index - 1] + tokens->sizes[index - 1];
+}
+
+/* Whether the token at the index is an identifier or a keyword. */
+bool ct_thrice_parser_named(CTThriceParser const* parser, CTIndex index)
+{
+    if (index >= parser->tokens->size) {
+        return false;
+    }
+    CTPatlakTokenType type = ct_patlak_compact_type(parser->tokens, index);
+    return type == CT_PATLAK_TOKEN_IDENTIFIER ||
+           type == CT_PATLAK_TOKEN_KEYWORD;
+}
+
+/* Amount of tokens the name at the index is made of. Identifiers and numbers
+ * that are not separated by whitespace are a single name, like "x2". Builtin
+ * types are keywords, which are a single token with their digits. */
+CTIndex
+ct_thrice_parser_name_width(CTThriceParser const* parser, CTIndex index)
+{
+    if (!ct_thrice_parser_named(parser, index)) {
+        return 0;
+    }
+    CTIndex width = 1;
+    while (ct_thrice_parser_adjacent(parser, index + width) &&
+           (ct_thrice_parser_named(parser, index + width) ||
+            ct_patlak_compact_type(parser->tokens, index + width) ==
+                CT_PATLAK_TOKEN_NUMBER)) {
+        width++;
+    }
+    return width;
+}
+
+/* Parse a name and add a node of the type for it. */
+uint32_t ct_thrice_parser_name(CTThriceParser* parser, CTThriceNodeType type)
+{
+    CTIndex width = ct_thrice_parser_name_width(parser, parser->current);
+    ct_thrice_parser_expect(parser, width > 0, "Expected a name!");
+    CTIndex token = ct_thrice_parser_advance(parser, width);
+    return ct_thrice_tree_add(parser->tree, type, token, width);
+}
+
+/* Parse a type. */
+uint32_t ct_thrice_parser_type(CTThriceParser* parser)
+{
+    uint32_t type = ct_thrice_parser_name(parser, CT_THRICE_NODE_TYPE);
+    while (
+        ct_thrice_parser_peek(parser, CT_PATLAK_TOKEN_OPENING_SQUARE_BRACKET)) {
+        CTIndex  token = ct_thrice_parser_take(parser, '[');
+        uint32_t array =
+            ct_thrice_tree_add(parser->tree, CT_THRICE_NODE_ARRAY, token, 1);
+        ct_thrice_tree_get(parser->tree, array)->child = type;
+        ct_thrice_parser_take(parser, ']');
+        type = array;
+    }
+    return type;
+}
+
+/* Whether a type and a name start at the index, which is a variable. */
+bool ct_thrice_parser_variable_at(CTThriceParser const* parser, CTIndex index)
+{
+    CTIndex width = ct_thrice_parser_name_width(parser, index);
+    if (width == 0) {
+        return false;
+    }
+    CTIndex after = ct_thrice_parser_skip(parser, index + width);
+    if (ct_thrice_parser_mark_at(parser, after, '[')) {
+        return ct_thrice_parser_mark_at(
+            parser,
+            ct_thrice_parser_skip(parser, after + 1),
+            ']');
+    }
+    return ct_thrice_parser_name_width(parser, after) > 0;
+}
+
+/* Binding power of the infix operator at the index. Zero if there is not an
+ * operator. Sets the amount of tokens of the operator. */
+int ct_thrice_parser_power(
+    CTThriceParser const* parser,
+    CTIndex               index,
+    CTIndex*              width)
+{
+    CTPatlakToken token = {0};
+    if (!ct_thrice_parser_at(parser, index, &token) ||
+        token.type == CT_PATLAK_TOKEN_QUOTE ||
+        ct_string_size(&token.value) != 1) {
+        return 0;
+    }
+
+    // Operators that end with an equal sign are two tokens.
+    *width = 1;
+    if (ct_thrice_parser_adjacent(parser, index + 1) &&
+        ct_thrice_parser_mark_at(parser, index + 1, '=')) {
+        switch (*token.value.first) {
+            case '=':
+            case '!':
+                *width = 2;
+                return 4;
+            case '<':
+            case '>':
+                *width = 2;
+                return 5;
+            default:
+                break;
+        }
+    }
+
+    switch (*token.value.first) {
+        case '=':
+            return 1;
+        case '|':
+            return 2;
+        case '&':
+            return 3;
+        case '<':
+        case '>':
+            return 5;
+        case '+':
+        case '-':
+            return 6;
+        case '*':
+        case '/':
+        case '%':
+            return 7;
+        default:
+            return 0;
+    }
+}
+
+/* Binding power of the prefix operators. */
+#define CT_THRICE_PARSER_PREFIX 8
+
+/* Binding power of the postfix operators. */
+#define CT_THRICE_PARSER_POSTFIX 9
+
+uint32_t ct_thrice_parser_expression(CTThriceParser* parser, int power);
+
+/* Parse an expression that does not start with an infix operator. */
+uint32_t ct_thrice_parser_prefix(CTThriceParser* parser)
+{
+    if (ct_thrice_parser_peek(parser, CT_PATLAK_TOKEN_NUMBER)) {
+        CTIndex token = ct_thrice_parser_advance(parser, 1);
+        return ct_thrice_tree_add(
+            parser->tree,
+            CT_THRICE_NODE_NUMBER,
+            token,
+            1);
+    }
+    if (ct_thrice_parser_peek(parser, CT_PATLAK_TOKEN_QUOTE)) {
+        CTIndex token = ct_thrice_parser_advance(parser, 1);
+        return ct_thrice_tree_add(parser->tree, CT_THRICE_NODE_QUOTE, token, 1);
+    }
+    if (ct_thrice_parser_name_width(parser, parser->current) > 0) {
+        return ct_thrice_parser_name(parser, CT_THRICE_NODE_NAME);
+    }
+    if (ct_thrice_parser_mark(parser, '(')) {
+        ct_thrice_parser_take(parser, '(');
+        uint32_t inner = ct_thrice_parser_expression(parser, 0);
+        ct_thrice_parser_take(parser, ')');
+        return inner;
+    }
+    ct_thrice_parser_expect(
+        parser,
+        ct_thrice_parser_mark(parser, '-') ||
+            ct_thrice_parser_mark(parser, '!'),
+        "Expected an expression!");
+    CTIndex  token = ct_thrice_parser_advance(parser, 1);
+    uint32_t unary =
+        ct_thrice_tree_add(parser->tree, CT_THRICE_NODE_UNARY, token, 1);
+    uint32_t operand =
+        ct_thrice_parser_expression(parser, CT_THRICE_PARSER_PREFIX);
+    ct_thrice_tree_get(parser->tree, unary)->child = operand;
+    return unary;
+}
+
+/* Parse a call after the called expression. */
+uint32_t ct_thrice_parser_call(CTThriceParser* parser, uint32_t called)
+{
+    CTIndex  token = ct_thrice_parser_take(parser, '(');
+    uint32_t call =
+        ct_thrice_tree_add(parser->tree, CT_THRICE_NODE_CALL, token, 1);
+    uint32_t previous = CT_THRICE_NODE_NONE;
+    ct_thrice_tree_link(parser->tree, call, &previous, called);
+    while (!ct_thrice_parser_mark(parser, ')')) {
+        if (previous != called) {
+            ct_thrice_parser_take(parser, ',');
+        }
+        ct_thrice_tree_link(
+            parser->tree,
+            call,
+            &previous,
+            ct_thrice_parser_expression(parser, 0));
+    }
+    ct_thrice_parser_take(parser, ')');
+    return call;
+}
+
+/* Parse an array access after the accessed expression. */
+uint32_t ct_thrice_parser_index(CTThriceParser* parser, uint32_t accessed)
+{
+    CTIndex  token = ct_thrice_parser_take(parser, '[');
+    uint32_t index =
+        ct_thrice_tree_add(parser->tree, CT_THRICE_NODE_INDEX, token, 1);
+    uint32_t previous = CT_THRICE_NODE_NONE;
+    ct_thrice_tree_link(parser->tree, index, &previous, accessed);
+    ct_thrice_tree_link(
+        parser->tree,
+        index,
+        &previous,
+        ct_thrice_parser_expression(parser, 0));
+    ct_thrice_parser_take(parser, ']');
+    return index;
+}
+
+/* Parse an expression whose infix operators bind tighter than the power. */
+uint32_t ct_thrice_parser_expression(CTThriceParser* parser, int power)
+{
+    uint32_t left = ct_thrice_parser_prefix(parser);
+    while (true) {
+        if (ct_thrice_parser_mark(parser, '(')) {
+            left = ct_thrice_parser_call(parser, left);
+            continue;
+        }
+        if (ct_thrice_parser_mark(parser, '[')) {
+            left = ct_thrice_parser_index(parser, left);
+            continue;
+        }
+        if (ct_thrice_parser_mark(parser, '.')) {
+            CTIndex  token  = ct_thrice_parser_advance(parser, 1);
+            uint32_t member = ct_thrice_tree_add(
+                parser->tree,
+                CT_THRICE_NODE_BINARY,
+                token,
+                1);
+            uint32_t previous = CT_THRICE_NODE_NONE;
+            ct_thrice_tree_link(parser->tree, member, &previous, left);
+            ct_thrice_tree_link(
+                parser->tree,
+                member,
+                &previous,
+                ct_thrice_parser_name(parser, CT_THRICE_NODE_NAME));
+            left = member;
+            continue;
+        }
+
+        CTIndex width = 0;
+        int     infix = ct_thrice_parser_power(parser, parser->current, &width);
+        if (infix <= power) {
+            return left;
+        }
+        CTIndex  token = ct_thrice_parser_advance(parser, width);
+        uint32_t binary = ct_thrice_tree_add(
+            parser->tree,
+            CT_THRICE_NODE_BINARY,
+            token,
+            width);
+
+        // Assignment groups from the right, others from the left.
+        uint32_t right = ct_thrice_parser_expression(
+            parser,
+            infix == 1 && width == 1 ? infix - 1 : infix);
+        uint32_t previous = CT_THRICE_NODE_NONE;
+        ct_thrice_tree_link(parser->tree, binary, &previous, left);
+        ct_thrice_tree_link(parser->tree, binary, &previous, right);
+        left = binary;
+    }
+}
+
+uint32_t ct_thrice_parser_statement(CTThriceParser* parser);
+
+/* Parse statements in curly brackets. */
+uint32_t ct_thrice_parser_block(CTThriceParser* parser)
+{
+    CTIndex  token = ct_thrice_parser_take(parser, '{');
+    uint32_t block =
+        ct_thrice_tree_add(parser->tree, CT_THRICE_NODE_BLOCK, token, 1);
+    uint32_t previous = CT_THRICE_NODE_NONE;
+    while (!ct_thrice_parser_mark(parser, '}')) {
+        ct_thrice_parser_expect(
+            parser,
+            ct_thrice_parser_finite(parser),
+            "Expected `}`!");
+        ct_thrice_tree_link(
+            parser->tree,
+            block,
+            &previous,
+            ct_thrice_parser_statement(parser));
+    }
+    ct_thrice_parser_take(parser, '}');
+    return block;
+}
+
+/* Parse a condition in parentheses and the statement after it as the
+ * children of the node. Returns the last child. */
+uint32_t ct_thrice_parser_conditional(CTThriceParser* parser, uint32_t node)
+{
+    uint32_t previous = CT_THRICE_NODE_NONE;
+    ct_thrice_parser_take(parser, '(');
+    ct_thrice_tree_link(
+        parser->tree,
+        node,
+        &previous,
+        ct_thrice_parser_expression(parser, 0));
+    ct_thrice_parser_take(parser, ')');
+    ct_thrice_tree_link(
+        parser->tree,
+        node,
+        &previous,
+        ct_thrice_parser_statement(parser));
+    return previous;
+}
+
+/* Parse a statement. */
+uint32_t ct_thrice_parser_statement(CTThriceParser* parser)
+{
+    if (ct_thrice_parser_mark(parser, '{')) {
+        return ct_thrice_parser_block(parser);
+    }
+
+    if (ct_thrice_parser_word(parser, "return")) {
+        CTIndex  token = ct_thrice_parser_advance(parser, 1);
+        uint32_t node =
+            ct_thrice_tree_add(parser->tree, CT_THRICE_NODE_RETURN, token, 1);
+        if (!ct_thrice_parser_mark(parser, ';')) {
+            uint32_t value = ct_thrice_parser_expression(parser, 0);
+            ct_thrice_tree_get(parser->tree, node)->child = value;
+        }
+        ct_thrice_parser_take(parser, ';');
+        return node;
+    }
+
+    if (ct_thrice_parser_word(parser, "if")) {
+        CTIndex  token = ct_thrice_parser_advance(parser, 1);
+        uint32_t node =
+            ct_thrice_tree_add(parser->tree, CT_THRICE_NODE_IF, token, 1);
+        uint32_t previous = ct_thrice_parser_conditional(parser, node);
+        if (ct_thrice_parser_word(parser, "else")) {
+            ct_thrice_parser_advance(parser, 1);
+            ct_thrice_tree_link(
+                parser->tree,
+                node,
+                &previous,
+                ct_thrice_parser_statement(parser));
+        }
+        return node;
+    }
+
+    if (ct_thrice_parser_word(parser, "while")) {
+        CTIndex  token = ct_thrice_parser_advance(parser, 1);
+        uint32_t node =
+            ct_thrice_tree_add(parser->tree, CT_THRICE_NODE_WHILE, token, 1);
+        ct_thrice_parser_conditional(parser, node);
+        return node;
+    }
+
+    if (ct_thrice_parser_variable_at(parser, parser->current)) {
+        uint32_t type = ct_thrice_parser_type(parser);
+        uint32_t node = ct_thrice_parser_name(parser, CT_THRICE_NODE_VARIABLE);
+        uint32_t previous = CT_THRICE_NODE_NONE;
+        ct_thrice_tree_link(parser->tree, node, &previous, type);
+        if (ct_thrice_parser_mark(parser, '=')) {
+            ct_thrice_parser_advance(parser, 1);
+            ct_thrice_tree_link(
+                parser->tree,
+                node,
+                &previous,
+                ct_thrice_parser_expression(parser, 0));
+        }
+        ct_thrice_parser_take(parser, ';');
+        return node;
+    }
+
+    CTIndex  token = parser->current;
+    uint32_t node =
+        ct_thrice_tree_add(parser->tree, CT_THRICE_NODE_EXPRESSION, token, 1);
+    uint32_t value = ct_thrice_parser_expression(parser, 0);
+    ct_thrice_tree_get(parser->tree, node)->child = value;
+    ct_thrice_parser_take(parser, ';');
+    return node;
+}
+
+/* Parse a function definition. */
+uint32_t ct_thrice_parser_function(CTThriceParser* parser)
+{
+    uint32_t function = ct_thrice_parser_name(parser, CT_THRICE_NODE_FUNCTION);
+    uint32_t previous = CT_THRICE_NODE_NONE;
+
+    ct_thrice_parser_take(parser, '(');
+    while (!ct_thrice_parser_mark(parser, ')')) {
+        if (previous != CT_THRICE_NODE_NONE) {
+            ct_thrice_parser_take(parser, ',');
+        }
+        uint32_t type = ct_thrice_parser_type(parser);
+        uint32_t parameter =
+            ct_thrice_parser_name(parser, CT_THRICE_NODE_PARAMETER);
+        ct_thrice_tree_get(parser->tree, parameter)->child = type;
+        ct_thrice_tree_link(parser->tree, function, &previous, parameter);
+    }
+    ct_thrice_parser_take(parser, ')');
+
+    ct_thrice_tree_link(
+        parser->tree,
+        function,
+        &previous,
+        ct_thrice_parser_type(parser));
+    ct_thrice_tree_link(
+        parser->tree,
+        function,
+        &previous,
+        ct_thrice_parser_block(parser));
+    return function;
+}
+
+/* Parse the tokens of the source at the path to the tree. The tree must be
+ * empty; the module is the first node. Aborts with the line and column of the
+ * token at the first syntax error. */
+void ct_thrice_parse(
+    CTThriceTree*                tree,
+    CTPatlakCompactTokens const* tokens,
+    CTLines*                     lines,
+    char const*                  path)
+{
+    ct_expect(ct_thrice_tree_size(tree) == 0, "Tree is not empty!");
+    CTThriceParser parser = {
+        .tokens = tokens,
+        .tree   = tree,
+        .lines  = lines,
+        .path   = path};
+    parser.current = ct_thrice_parser_skip(&parser, 0);
+
+    // Presize for the common case of about a node per token.
+    ct_thrice_tree_reserve(tree, tokens->size + 1);
+    uint32_t module = ct_thrice_tree_add(tree, CT_THRICE_NODE_MODULE, 0, 0);
+    uint32_t previous = CT_THRICE_NODE_NONE;
+    while (ct_thrice_parser_finite(&parser)) {
+        ct_thrice_tree_link(
+            tree,
+            module,
+            &previous,
+            ct_thrice_parser_function(&parser));
+    }
+}
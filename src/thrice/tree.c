@@ -0,0 +1,223 @@
+// SPDX-FileCopyrightText: 2022 Cem Geçgel <gecgelcem@outlook.com>
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "patlak/compact.c"
+#include "prelude/expect.c"
+#include "prelude/memory.c"
+#include "prelude/scalar.c"
+#include "prelude/string.c"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Index that does not refer to a node. The first node is always the module,
+ * which is never a child or a sibling. */
+#define CT_THRICE_NODE_NONE 0
+
+/* Type of a node in a source. */
+typedef enum {
+    /* Whole source. Children are the functions. */
+    CT_THRICE_NODE_MODULE,
+    /* Function definition. Token is the name. Children are the parameters,
+     * the return type and the body. */
+    CT_THRICE_NODE_FUNCTION,
+    /* Parameter of a function. Token is the name. Child is the type. */
+    CT_THRICE_NODE_PARAMETER,
+    /* Named type. Token is the name. */
+    CT_THRICE_NODE_TYPE,
+    /* Array type. Child is the type of the elements. */
+    CT_THRICE_NODE_ARRAY,
+    /* Statements in curly brackets. Children are the statements. */
+    CT_THRICE_NODE_BLOCK,
+    /* Return from the function. Child is the returned value if there is
+     * one. */
+    CT_THRICE_NODE_RETURN,
+    /* Conditional statement. Children are the condition, the statement and
+     * the alternative statement if there is one. */
+    CT_THRICE_NODE_IF,
+    /* Loop statement. Children are the condition and the statement. */
+    CT_THRICE_NODE_WHILE,
+    /* Variable definition. Token is the name. Children are the type and the
+     * initial value if there is one. */
+    CT_THRICE_NODE_VARIABLE,
+    /* Expression that is evaluated as a statement. Child is the
+     * expression. */
+    CT_THRICE_NODE_EXPRESSION,
+    /* Reference to a name. Token is the name. */
+    CT_THRICE_NODE_NAME,
+    /* Number literal. Token is the number. */
+    CT_THRICE_NODE_NUMBER,
+    /* Quote literal. Token is the quote. */
+    CT_THRICE_NODE_QUOTE,
+    /* Prefix operation. Token is the operator. Child is the operand. */
+    CT_THRICE_NODE_UNARY,
+    /* Infix operation. Token is the operator. Children are the operands. */
+    CT_THRICE_NODE_BINARY,
+    /* Function call. Children are the called function and the
+     * arguments. */
+    CT_THRICE_NODE_CALL,
+    /* Array access. Children are the array and the index. */
+    CT_THRICE_NODE_INDEX
+} CTThriceNodeType;
+
+/* Part of a source. Refers to other nodes and tokens with their indices,
+ * instead of pointers. */
+typedef struct {
+    /* Node type. */
+    CTThriceNodeType type;
+    /* Index of the first token of the node. */
+    uint32_t token;
+    /* Amount of consecutive tokens that make up the token of the node. */
+    uint32_t width;
+    /* Index of the first child. */
+    uint32_t child;
+    /* Index of the next child of the parent. */
+    uint32_t sibling;
+} CTThriceNode;
+
+/* Nodes of a source, which are kept in one allocation, so they are freed
+ * together. */
+typedef struct {
+    /* Border before the first node. */
+    CTThriceNode* first;
+    /* Border after the last node. */
+    CTThriceNode* last;
+    /* Border after the last allocated node. */
+    CTThriceNode* allocated;
+} CTThriceTree;
+
+/* Amount of nodes. */
+CTIndex ct_thrice_tree_size(CTThriceTree const* tree)
+{
+    return tree->last - tree->first;
+}
+
+/* Amount of allocated nodes. */
+CTIndex ct_thrice_tree_capacity(CTThriceTree const* tree)
+{
+    return tree->allocated - tree->first;
+}
+
+/* Amount of allocated but unused nodes. */
+CTIndex ct_thrice_tree_space(CTThriceTree const* tree)
+{
+    return tree->allocated - tree->last;
+}
+
+/* Pointer to the node at the index. */
+CTThriceNode* ct_thrice_tree_get(CTThriceTree const* tree, CTIndex index)
+{
+    ct_expect(
+        index >= 0 && index < ct_thrice_tree_size(tree),
+        "Index out of bounds!");
+    return tree->first + index;
+}
+
+/* Make sure the amount of nodes will fit. Grows by at least the half of the
+ * current capacity if necessary. */
+void ct_thrice_tree_reserve(CTThriceTree* tree, CTIndex amount)
+{
+    ct_expect(amount >= 0, "Reserving negative amount!");
+    CTIndex growth = amount - ct_thrice_tree_space(tree);
+    if (growth <= 0) {
+        return;
+    }
+
+    CTIndex capacity      = ct_thrice_tree_capacity(tree);
+    CTIndex half_capacity = capacity >> 1;
+    if (growth < half_capacity) {
+        growth = half_capacity;
+    }
+
+    CTIndex       new_capacity = capacity + growth;
+    CTThriceNode* memory =
+        reallocarray(tree->first, new_capacity, sizeof(CTThriceNode));
+    ct_expect(memory != NULL, "Could not allocate!");
+    ct_memory_account(
+        CT_MEMORY_NODES,
+        capacity * (CTIndex)sizeof(CTThriceNode),
+        new_capacity * (CTIndex)sizeof(CTThriceNode));
+
+    tree->last      = memory + ct_thrice_tree_size(tree);
+    tree->first     = memory;
+    tree->allocated = memory + new_capacity;
+}
+
+/* Add a node without children to the end. Returns its index. */
+uint32_t ct_thrice_tree_add(
+    CTThriceTree*    tree,
+    CTThriceNodeType type,
+    CTIndex          token,
+    CTIndex          width)
+{
+    CTIndex index = ct_thrice_tree_size(tree);
+    ct_expect(index < UINT32_MAX, "Too many nodes!");
+    ct_thrice_tree_reserve(tree, 1);
+    *tree->last++ = (CTThriceNode){
+        .type  = type,
+        .token = (uint32_t)token,
+        .width = (uint32_t)width};
+    return (uint32_t)index;
+}
+
+/* Add the child after the previous child of the parent. Previous child is
+ * none for the first child, and it is updated to the added child. */
+void ct_thrice_tree_link(
+    CTThriceTree* tree,
+    uint32_t      parent,
+    uint32_t*     previous,
+    uint32_t      child)
+{
+    if (*previous == CT_THRICE_NODE_NONE) {
+        ct_thrice_tree_get(tree, parent)->child = child;
+    } else {
+        ct_thrice_tree_get(tree, *previous)->sibling = child;
+    }
+    *previous = child;
+}
+
+/* Amount of children of the node. */
+CTIndex ct_thrice_tree_children(CTThriceTree const* tree, uint32_t node)
+{
+    CTIndex amount = 0;
+    for (uint32_t i = ct_thrice_tree_get(tree, node)->child;
+         i != CT_THRICE_NODE_NONE;
+         i = tree->first[i].sibling) {
+        amount++;
+    }
+    return amount;
+}
+
+/* String of the tokens of the node. */
+CTString ct_thrice_tree_value(
+    CTThriceTree const*          tree,
+    CTPatlakCompactTokens const* tokens,
+    uint32_t                     node)
+{
+    CTThriceNode const* got   = ct_thrice_tree_get(tree, node);
+    CTString            first = ct_patlak_compact_value(tokens, got->token);
+    CTString            last =
+        ct_patlak_compact_value(tokens, got->token + got->width - 1);
+    return (CTString){.first = first.first, .last = last.last};
+}
+
+/* Remove the nodes. Keeps the memory. */
+void ct_thrice_tree_clear(CTThriceTree* tree)
+{
+    tree->last = tree->first;
+}
+
+/* Deallocate memory. */
+void ct_thrice_tree_free(CTThriceTree* tree)
+{
+    ct_memory_account(
+        CT_MEMORY_NODES,
+        ct_thrice_tree_capacity(tree) * (CTIndex)sizeof(CTThriceNode),
+        0);
+    free(tree->first);
+    tree->first     = NULL;
+    tree->last      = NULL;
+    tree->allocated = NULL;
+}